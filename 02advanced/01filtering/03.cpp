@@ -4,9 +4,11 @@
 #include <iostream>
 #include <pcl/io/pcd_io.h>
 #include <pcl/point_types.h>
-#include <pcl/filters/statistical_outlier_removal.h>
+#include <pcl/filters/extract_indices.h>
 #include <pcl/filters/voxel_grid.h>
 
+#include "../../common/neighborhood_graph.h"
+
 int main(int argc, char** argv)
 {
     pcl::PointCloud<pcl::PointXYZ>::Ptr cloud (new pcl::PointCloud<pcl::PointXYZ>);
@@ -30,11 +32,19 @@ int main(int argc, char** argv)
     vox.filter(*cloud_filtered);
 
 
-    pcl::StatisticalOutlierRemoval<pcl::PointXYZ> sor;
-    sor.setInputCloud(cloud_filtered);
-    sor.setMeanK(50);    //设置平均距离估计的最近距离数量K
-    sor.setStddevMulThresh(1.0);    //设置标准差异阀值系数
-    sor.filter(*cloud_filtered);    //执行过滤
+    //K 近邻图只建一次(含点本身，所以是 50+1)，统计滤波直接读图，结果与 pcl::StatisticalOutlierRemoval 相同；
+    //同一张图还可以通过 NeighborhoodGraphSearch 交给法线、特征估计使用
+    pcl::PointCloud<pcl::PointXYZ>::Ptr voxel_cloud = cloud_filtered;
+    NeighborhoodGraph<pcl::PointXYZ> graph;
+    graph.buildKNN(voxel_cloud, 50 + 1);
+    pcl::PointIndices::Ptr inliers(new pcl::PointIndices);
+    statisticalOutlierRemoval(graph, 50, 1.0, inliers->indices);    //K=50，标准差阀值系数为1
+
+    pcl::ExtractIndices<pcl::PointXYZ> extract;
+    extract.setInputCloud(voxel_cloud);
+    extract.setIndices(inliers);
+    cloud_filtered.reset(new pcl::PointCloud<pcl::PointXYZ>);
+    extract.filter(*cloud_filtered);    //执行过滤
 
     std::cerr<<"Cloud after filtering: "<<std::endl;
     std::cerr<<*cloud_filtered<<std::endl;
@@ -42,9 +52,9 @@ int main(int argc, char** argv)
     pcl::PCDWriter writer;
     writer.write<pcl::PointXYZ>("../pcd/capture0002_inliers.pcd", *cloud_filtered, false);
 
-    //使用相同的过滤器，但对输出结果取反，将被过滤的点另外储存。
-    sor.setNegative(true);
-    sor.filter(*cloud_filtered);
+    //对同一组内点取反，将被过滤的点另外储存，不需要再做一次近邻查询。
+    extract.setNegative(true);
+    extract.filter(*cloud_filtered);
     writer.write<pcl::PointXYZ>("../pcd/capture0002_outliers.pcd", *cloud_filtered, false);
 
     return 0;
@@ -3,8 +3,10 @@
 #include<pcl/visualization/pcl_visualizer.h>
 #include <pcl/visualization/range_image_visualizer.h>
 
-#include "pcl/io/png_io.h"
-#include "pcl/visualization/common/float_image_utils.h"
+#include <pcl/console/parse.h>
+
+#include "../../common/range_image_parallel.h"
+#include "../../common/range_image_io.h"
 
 int main(int argc, char **argv) {
     pcl::PointCloud<pcl::PointXYZ>::Ptr pointCloudPtr(new pcl::PointCloud<pcl::PointXYZ>);
@@ -36,24 +38,50 @@ int main(int argc, char **argv) {
     float minRange = 0.0f;
     int borderSize = 1;
 
-    boost::shared_ptr<pcl::RangeImage> range_image_ptr(new pcl::RangeImage);
+    //person.pcd 是 640x480 的有序点云，-o 时直接按像素生成平面深度图，跳过球面投影
+    boost::shared_ptr<pcl::RangeImage> range_image_ptr;
+    bool use_organized = pcl::console::find_argument(argc, argv, "-o") >= 0;
+    if (use_organized && pointCloud.isOrganized()) {
+        boost::shared_ptr<pcl::RangeImagePlanar> planar_ptr(new pcl::RangeImagePlanar);
+        if (createPlanarFromOrganizedCloud(pointCloud, *planar_ptr))
+            range_image_ptr = planar_ptr;
+        else
+            std::cout << "could not recover camera intrinsics, using spherical projection\n";
+    }
+    if (!range_image_ptr) {
+        //多线程投影，结果与 createFromPointCloud 相同
+        RangeImageParallel::Ptr parallel_ptr(new RangeImageParallel);
+        parallel_ptr->createFromPointCloudParallel(pointCloud,
+                                                   angularResolution,
+                                                   maxAngleWidth,
+                                                   maxAngleHeight,
+                                                   sensorPose,
+                                                   coordinate_frame,
+                                                   noiseLevel,
+                                                   minRange,
+                                                   borderSize);
+        range_image_ptr = parallel_ptr;
+    }
     pcl::RangeImage &rangeImage = *range_image_ptr;
 
-    rangeImage.createFromPointCloud(pointCloud,
-                                    angularResolution,
-                                    maxAngleWidth,
-                                    maxAngleHeight,
-                                    sensorPose,
-                                    coordinate_frame,
-                                    noiseLevel,
-                                    minRange,
-                                    borderSize);
-
     std::cout << rangeImage << "\n";
 /**************************保存点云图像********************************/
-    float* ranges = rangeImage.getRangesArray();
-    unsigned char* rgb_image = pcl::visualization::FloatImageUtils::getVisualImage(ranges, rangeImage.width, rangeImage.height);
-    pcl::io::saveRgbPNGFile("../saveRangeImageRGB.png", rgb_image, rangeImage.width, rangeImage.height);
+    //16 位 PNG 把距离量化到 1mm，超过 65.534m 的截断；raw float 无损。两者都比转换成 8 位 RGB 可视化图再保存快得多
+    //平面深度图的内参不会被保存，只导出球面投影的结果
+    if (!boost::dynamic_pointer_cast<pcl::RangeImagePlanar>(range_image_ptr)) {
+        //PNG 交给后台线程编码写盘，逐帧归档时每帧 push 一次即可
+        RangeImageArchiver archiver(RANGE_IMAGE_PNG16);
+        archiver.push(rangeImage, "../saveRangeImage16.png");
+        if (!saveRangeImage(rangeImage, "../saveRangeImage.rim", RANGE_IMAGE_RAW))
+            std::cout << "failed to save range image\n";
+
+        //从 raw 文件(mmap)重建深度图
+        pcl::RangeImage loaded;
+        if (loadRangeImage("../saveRangeImage.rim", loaded))
+            std::cout << "reloaded " << loaded.width << "x" << loaded.height << " range image\n";
+        if (!archiver.flush())
+            std::cout << "failed to save range image\n";
+    }
 /**********************************************************/
 
 
@@ -4,9 +4,11 @@
 #include<pcl/io/pcd_io.h>
 #include<pcl/visualization/range_image_visualizer.h>
 #include<pcl/visualization/pcl_visualizer.h>
-#include<pcl/features/range_image_border_extractor.h>
 #include<pcl/console/parse.h>
 
+#include "../../common/range_image_parallel.h"
+#include "../../common/range_image_border_parallel.h"
+
 typedef pcl::PointXYZ PointType;
 using namespace std;
 
@@ -100,10 +102,10 @@ int main(int argc, char** argv)
     float noise_level = 0.0;
     float min_range = 0.0f;
     int border_size = 1;
-    boost::shared_ptr<pcl::RangeImage> range_image_ptr(new pcl::RangeImage);
+    RangeImageParallel::Ptr range_image_ptr(new RangeImageParallel);
     pcl::RangeImage& range_image = *range_image_ptr;
-    range_image.createFromPointCloud(point_cloud, angular_resolution, pcl::deg2rad(360.0f), pcl::deg2rad(180.0f),
-                                     scene_sensor_pose, coordinate_frame, noise_level, min_range, border_size);
+    range_image_ptr->createFromPointCloudParallel(point_cloud, angular_resolution, pcl::deg2rad(360.0f), pcl::deg2rad(180.0f),
+                                                  scene_sensor_pose, coordinate_frame, noise_level, min_range, border_size);
     range_image.integrateFarRanges(far_ranges);
     if(setUnseenToMaxRange)
         range_image.setUnseenToMaxRange();
@@ -115,10 +117,10 @@ int main(int argc, char** argv)
     pcl::visualization::PointCloudColorHandlerCustom<PointType> point_cloud_color_handler(point_cloud_ptr,0,0,0);
     viewer.addPointCloud(point_cloud_ptr, point_cloud_color_handler, "original point cloud");
 
-    //extract borders 提取边界
-    pcl::RangeImageBorderExtractor border_extractor(&range_image);
-    pcl::PointCloud<pcl::BorderDescription> border_descriptions;//边界描述
-    border_extractor.compute(border_descriptions);//计算
+    //extract borders 提取边界（分块多线程，结果为每类一张位平面）
+    RangeImageBorderExtractorParallel border_extractor(&range_image);
+    RangeImageBorders borders;
+    border_extractor.compute(borders);//计算
 
     //sho points in 3D viewer
     pcl::PointCloud<pcl::PointWithRange>::Ptr border_points_ptr(new pcl::PointCloud<pcl::PointWithRange>),
@@ -128,18 +130,15 @@ int main(int argc, char** argv)
                 &veil_points = *veil_points_ptr,
                 &shadow_points=*shadow_points_ptr;
 
-    for(int y = 0;y<(int)range_image.height;++y)
-    {
-        for(int x=0;x<(int)range_image.width;++x)
-        {       
-            if(border_descriptions.points[y*range_image.width +x].traits[pcl::BORDER_TRAIT__OBSTACLE_BORDER])//边界性状障碍边界-绿色
-                border_points.points.push_back (range_image.points[y*range_image.width + x]);
-            if (border_descriptions.points[y*range_image.width + x].traits[pcl::BORDER_TRAIT__VEIL_POINT])//边界特征面纱点-红色
-                veil_points.points.push_back (range_image.points[y*range_image.width + x]);
-            if(border_descriptions.points[y*range_image.width +x].traits[pcl::BORDER_TRAIT__SHADOW_BORDER])//边界特征阴影边界-蓝色
-                shadow_points.points.push_back (range_image.points[y*range_image.width + x]);
-        }
-    }
+    std::vector<int> border_indices = borders.obstacle.toIndices(),//障碍边界-绿色
+            veil_indices = borders.veil.toIndices(),//面纱点-红色
+            shadow_indices = borders.shadow.toIndices();//阴影边界-蓝色
+    for(int index : border_indices)
+        border_points.points.push_back(range_image.points[index]);
+    for(int index : veil_indices)
+        veil_points.points.push_back(range_image.points[index]);
+    for(int index : shadow_indices)
+        shadow_points.points.push_back(range_image.points[index]);
 
     pcl::visualization::PointCloudColorHandlerCustom<pcl::PointWithRange> border_points_color_handler(border_points_ptr, 0,255,0);//green
         viewer.addPointCloud<pcl::PointWithRange>(border_points_ptr,border_points_color_handler,"border points");
@@ -155,17 +154,18 @@ int main(int argc, char** argv)
 
     //show points on range image
 
-    pcl::visualization::RangeImageVisualizer* range_image_borders_widget = NULL;//范围图像边框小部件
-    //获取范围图像边界小工具
-    range_image_borders_widget = pcl::visualization::RangeImageVisualizer::getRangeImageBordersWidget(range_image,
-                                                                                                        -std::numeric_limits<float>::infinity(),
-                                                                                                        std::numeric_limits<float>::infinity(),
-                                                                                                        false,
-                                                                                                        border_descriptions,"range image with borders");
+    pcl::visualization::RangeImageVisualizer range_image_borders_widget("range image with borders");//范围图像边框小部件
+    range_image_borders_widget.showRangeImage(range_image);
+    for(int index : border_indices)
+        range_image_borders_widget.markPoint(index % range_image.width, index / range_image.width, pcl::visualization::Vector3ub(0,255,0));
+    for(int index : veil_indices)
+        range_image_borders_widget.markPoint(index % range_image.width, index / range_image.width, pcl::visualization::Vector3ub(255,0,0));
+    for(int index : shadow_indices)
+        range_image_borders_widget.markPoint(index % range_image.width, index / range_image.width, pcl::visualization::Vector3ub(0,0,255));
     //main loop
     while(!viewer.wasStopped())
     {
-        range_image_borders_widget->spinOnce();
+        range_image_borders_widget.spinOnce();
         viewer.spinOnce();
         pcl_sleep(0.01);
     }
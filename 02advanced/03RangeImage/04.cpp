@@ -0,0 +1,145 @@
+/*
+ * 增量深度图：模拟旋转激光雷达按方位角切片输出，每个切片只更新覆盖到的列
+ */
+#include <iostream>
+#include <cmath>
+#include <limits>
+#include <pcl/io/pcd_io.h>
+#include <pcl/console/parse.h>
+#include <pcl/console/time.h>
+#include <pcl/visualization/range_image_visualizer.h>
+
+#include "../../common/range_image_incremental.h"
+
+typedef pcl::PointXYZ PointType;
+
+//parameters
+float angular_resolution = 0.5f;
+int nr_slices = 36;
+pcl::RangeImage::CoordinateFrame coordinate_frame = pcl::RangeImage::LASER_FRAME;
+bool setUnseenToMaxRange = false;
+
+void printUsage(const char *progName) {
+    std::cout << "\n\nUsage:" << progName << "[options]<scene.pcd>\n\n"
+              << "Options:\n"
+              << "--------------------------------------\n"
+              << "-r <float>   angular resolution in degrees (default " << angular_resolution << ")\n"
+              << "-n <int>     number of azimuth slices per sweep (default " << nr_slices << ")\n"
+              << "-c <int>     coordinate frame (default " << (int) coordinate_frame << ")\n"
+              << "-m           Treat all unseen points to max range\n"
+              << "-h           this help\n"
+              << "\n\n";
+}
+
+int main(int argc, char **argv) {
+    if (pcl::console::find_argument(argc, argv, "-h") >= 0) {
+        printUsage(argv[0]);
+        return 0;
+    }
+    if (pcl::console::find_argument(argc, argv, "-m") >= 0)
+        setUnseenToMaxRange = true;
+    int tmp_coordinate_frame;
+    if (pcl::console::parse(argc, argv, "-c", tmp_coordinate_frame) >= 0)
+        coordinate_frame = pcl::RangeImage::CoordinateFrame(tmp_coordinate_frame);
+    pcl::console::parse(argc, argv, "-n", nr_slices);
+    pcl::console::parse(argc, argv, "-r", angular_resolution);
+    angular_resolution = pcl::deg2rad(angular_resolution);
+    nr_slices = std::max(nr_slices, 1);
+
+    //读取点云，没有给出文件时生成一个示例点云
+    pcl::PointCloud<PointType> point_cloud;
+    Eigen::Affine3f scene_sensor_pose(Eigen::Affine3f::Identity());
+    std::vector<int> pcd_filename_indices = pcl::console::parse_file_extension_argument(argc, argv, "pcd");
+    if (!pcd_filename_indices.empty()) {
+        std::string filename = argv[pcd_filename_indices[0]];
+        if (pcl::io::loadPCDFile(filename, point_cloud) == -1) {
+            std::cout << "was not able to open file\"" << filename << "\".\n";
+            printUsage(argv[0]);
+            return 0;
+        }
+        scene_sensor_pose = Eigen::Affine3f(Eigen::Translation3f(point_cloud.sensor_origin_[0],
+                                                                 point_cloud.sensor_origin_[1],
+                                                                 point_cloud.sensor_origin_[2])) *
+                            Eigen::Affine3f(point_cloud.sensor_orientation_);
+    } else {
+        std::cout << "\nNo *.pcd file given =>Generationg example point cloud.\n\n";
+        for (float x = -0.5f; x <= 0.5f; x += 0.01f) {
+            for (float y = -0.5f; y <= 0.5f; y += 0.01f) {
+                PointType point;
+                point.x = 2.0f - y;
+                point.y = x;
+                point.z = y;
+                point_cloud.points.push_back(point);
+            }
+        }
+        point_cloud.width = (int) point_cloud.points.size();
+        point_cloud.height = 1;
+    }
+
+    //按传感器坐标系下的方位角把点云切成 nr_slices 个数据包
+    std::vector<pcl::PointCloud<PointType> > packets(nr_slices);
+    Eigen::Affine3f to_sensor = scene_sensor_pose.inverse();
+    for (const PointType &point: point_cloud.points) {
+        if (!pcl::isFinite(point))
+            continue;
+        Eigen::Vector3f p = to_sensor * point.getVector3fMap();
+        float azimuth = std::atan2(p.y(), p.x()) + static_cast<float>(M_PI);
+        int slice = std::min(nr_slices - 1, static_cast<int>(azimuth / (2.0f * M_PI) * nr_slices));
+        packets[slice].points.push_back(point);
+    }
+
+    IncrementalRangeImage::Ptr range_image_ptr(new IncrementalRangeImage);
+    IncrementalRangeImage &range_image = *range_image_ptr;
+    range_image.reset(angular_resolution, scene_sensor_pose, coordinate_frame, 0.0f, setUnseenToMaxRange);
+
+    //逐个数据包更新，统计每个数据包的延迟
+    pcl::console::TicToc tt;
+    double total_ms = 0.0, worst_ms = 0.0;
+    range_image.beginSweep();
+    for (int i = 0; i < nr_slices; ++i) {
+        range_image.clearDirtyRegions();
+        tt.tic();
+        range_image.updateSlice(packets[i]);
+        double ms = tt.toc();
+        total_ms += ms;
+        worst_ms = std::max(worst_ms, ms);
+
+        std::vector<IncrementalRangeImage::DirtyRegion> dirty = range_image.getDirtyRegions();
+        std::cout << "packet " << i << ": " << packets[i].points.size() << " points, " << ms << " ms, dirty:";
+        for (const IncrementalRangeImage::DirtyRegion &region: dirty)
+            std::cout << " [" << region.x_begin << "," << region.x_end << ")x[" << region.y_begin << ","
+                      << region.y_end << ")";
+        std::cout << "\n";
+    }
+    range_image.endSweep();
+    std::cout << "whole sweep " << total_ms << " ms, worst packet " << worst_ms << " ms\n";
+
+    //与整圈点云一次建图比较，应逐像素一致。createFromPointCloud 会裁剪到有数据的范围，按图像偏移对齐，
+    //裁剪掉的部分在增量图像中应为未观测(或 -m 时的最大距离)
+    pcl::RangeImage full_image;
+    full_image.createFromPointCloud(point_cloud, angular_resolution, pcl::deg2rad(360.0f), pcl::deg2rad(180.0f),
+                                    scene_sensor_pose, coordinate_frame, 0.0f, 0.0f, 0);
+    if (setUnseenToMaxRange)
+        full_image.setUnseenToMaxRange();
+    int mismatches = 0;
+    for (int y = 0; y < static_cast<int>(range_image.height); ++y) {
+        for (int x = 0; x < static_cast<int>(range_image.width); ++x) {
+            const int full_x = x - full_image.getImageOffsetX(), full_y = y - full_image.getImageOffsetY();
+            float expected = setUnseenToMaxRange ? std::numeric_limits<float>::infinity()
+                                                 : -std::numeric_limits<float>::infinity();
+            if (full_image.isInImage(full_x, full_y))
+                expected = full_image.getPoint(full_x, full_y).range;
+            if (!(range_image.getPoint(x, y).range == expected))
+                ++mismatches;
+        }
+    }
+    std::cout << "pixels differing from createFromPointCloud: " << mismatches << "\n";
+
+    pcl::visualization::RangeImageVisualizer range_image_widget("Incremental range image");
+    range_image_widget.showRangeImage(range_image);
+    while (!range_image_widget.wasStopped()) {
+        range_image_widget.spinOnce();
+        pcl_sleep(0.01);
+    }
+    return 0;
+}
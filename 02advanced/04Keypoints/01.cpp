@@ -4,16 +4,18 @@
 #include<pcl/io/pcd_io.h>
 #include<pcl/visualization/range_image_visualizer.h>
 #include<pcl/visualization/pcl_visualizer.h>
-#include<pcl/features/range_image_border_extractor.h>
-#include<pcl/keypoints/narf_keypoint.h>
 #include<pcl/console/parse.h>
 
+#include "../../common/range_image_parallel.h"
+#include "../../common/narf_keypoint_parallel.h"
+
 typedef pcl::PointXYZ PointType;
 using namespace std;
 
 //parameters
 float angular_resolution = 0.5f;
 float support_size = 0.2f;
+std::vector<float> support_sizes;//多尺度检测的 support size 列表
 pcl::RangeImage::CoordinateFrame coordinate_frame = pcl::RangeImage::CAMERA_FRAME;
 bool setUnseenToMaxRange = false;
 
@@ -26,6 +28,7 @@ void printUsage(const char *progName) {
               << "-m           Treat all unseen points to max range\n"
               << "-s <float>   support size for the interest points (diameter of the used sphere - "
               << "default " << support_size << ")\n"
+              << "-S <float,float,...> detect keypoints at several support sizes in one pass\n"
               << "-h           this help\n"
               << "\n\n";
 }
@@ -54,6 +57,8 @@ int main(int argc, char **argv) {
     }
     if (pcl::console::parse(argc, argv, "-s", support_size) >= 0)
         cout << "Setting suport size to" << support_size << ".\n";
+    if (pcl::console::parse_x_arguments(argc, argv, "-S", support_sizes) >= 0)
+        cout << "Using " << support_sizes.size() << " support sizes.\n";
     if (pcl::console::parse(argc, argv, "-r", angular_resolution) >= 0)
         cout << "setting angular resolution to" << angular_resolution << "deg.\n";
     angular_resolution = pcl::deg2rad(angular_resolution);
@@ -106,18 +111,18 @@ int main(int argc, char **argv) {
     float noise_level = 0.0;
     float min_range = 0.0f;
     int border_size = 1;
-    boost::shared_ptr<pcl::RangeImage> range_image_ptr(new pcl::RangeImage);
+    RangeImageParallel::Ptr range_image_ptr(new RangeImageParallel);
     pcl::RangeImage &range_image = *range_image_ptr;
-    //从点云创建深度图
-    range_image.createFromPointCloud(point_cloud,
-                                     angular_resolution,
-                                     pcl::deg2rad(120.0f),
-                                     pcl::deg2rad(90.0f),
-                                     scene_sensor_pose,
-                                     coordinate_frame,
-                                     noise_level,
-                                     min_range,
-                                     border_size);
+    //从点云创建深度图（多线程投影）
+    range_image_ptr->createFromPointCloudParallel(point_cloud,
+                                                  angular_resolution,
+                                                  pcl::deg2rad(120.0f),
+                                                  pcl::deg2rad(90.0f),
+                                                  scene_sensor_pose,
+                                                  coordinate_frame,
+                                                  noise_level,
+                                                  min_range,
+                                                  border_size);
     range_image.integrateFarRanges(far_ranges);
     if (setUnseenToMaxRange)
         range_image.setUnseenToMaxRange();
@@ -138,13 +143,34 @@ int main(int argc, char **argv) {
 
 
     //extract NARF borders 提取边界
-    pcl::RangeImageBorderExtractor range_image_border_extractor;
-    pcl::NarfKeypoint narf_keypoint_detector(&range_image_border_extractor);
+    //边界与表面变化只算一次，同时用于深度图上的边界显示和 NARF 关键点
+    RangeImageBorderExtractorParallel border_extractor(&range_image);
+    RangeImageBorders borders;
+    RangeImageSurfaceChanges surface_changes;
+    border_extractor.compute(borders, surface_changes);
+    std::vector<int> border_indices = borders.obstacle.toIndices();
+    for (int index: border_indices)
+        range_image_widget.markPoint(index % range_image.width, index / range_image.width,
+                                     pcl::visualization::Vector3ub(0, 255, 0));
+
+    NarfKeypointParallel narf_keypoint_detector;
     narf_keypoint_detector.setRangeImage(&range_image);
+    narf_keypoint_detector.setBorders(&borders, &surface_changes);
     narf_keypoint_detector.getParameters().support_size = support_size;
 
     pcl::PointCloud<int> keypoint_indices;//指数
-    narf_keypoint_detector.compute(keypoint_indices);//wrong in here
+    if (support_sizes.empty()) {
+        narf_keypoint_detector.compute(keypoint_indices);
+    } else {
+        //所有尺度共用一次邻域遍历，每个关键点带有检测到它的尺度
+        std::vector<NarfKeypointParallel::ScaledKeypoint> scaled_keypoints;
+        narf_keypoint_detector.computeMultiScale(support_sizes, scaled_keypoints);
+        for (const NarfKeypointParallel::ScaledKeypoint &keypoint: scaled_keypoints) {
+            keypoint_indices.push_back(keypoint.index);
+            std::cout << "  support size " << keypoint.support_size << ": point " << keypoint.index
+                      << ", interest " << keypoint.interest << "\n";
+        }
+    }
     std::cout << "Found  " << keypoint_indices.points.size() << "  key points.\n";
 
     //sho points in 3D viewer
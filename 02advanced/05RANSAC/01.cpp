@@ -5,11 +5,11 @@
 #include <pcl/filters/extract_indices.h>
 #include <pcl/io/pcd_io.h>
 #include <pcl/point_types.h>
-#include <pcl/sample_consensus/ransac.h>
-#include <pcl/sample_consensus/sac_model_plane.h>
-#include <pcl/sample_consensus/sac_model_sphere.h>
+#include <pcl/sample_consensus/model_types.h>
 #include <pcl/visualization/pcl_visualizer.h>
 
+#include "../../common/sac_parallel.h"
+
 using namespace std::chrono_literals;
 
 pcl::visualization::PCLVisualizer::Ptr
@@ -37,6 +37,10 @@ simpleVis(pcl::PointCloud<pcl::PointXYZ>::ConstPtr cloud, pcl::PointCloud<pcl::P
  *
  * random_sample_consensus -s  创建包含外部点的球体
  * random_sample_consensus -sf 创建包含外部点的球体，并计算球体内部点
+ *
+ * -seed <int>      随机种子，相同种子在任意线程数下结果相同
+ * -trace <file>    把每个假设的内点数与迭代上限写成 CSV
+ * -prior a,b,c,d   先验模型(如上一帧的结果)，内点比例达到一半时直接采用，不做 RANSAC
  */
 int main(int argc, char **argv) {
     //initialize pointclouds
@@ -72,26 +76,42 @@ int main(int argc, char **argv) {
         }
     }
     std::vector<int> inliers;//点云索引
-    //created RandomSampleConsensus object and compute the appropriated model
-    //圆形
-    pcl::SampleConsensusModelSphere<pcl::PointXYZ>::Ptr model_s(
-            new pcl::SampleConsensusModelSphere<pcl::PointXYZ>(cloud));
-    //平面
-    pcl::SampleConsensusModelPlane<pcl::PointXYZ>::Ptr model_p(
-            new pcl::SampleConsensusModelPlane<pcl::PointXYZ>(cloud));
+    //批量生成假设，在所有核上用 SoA + SSE 计数，迭代上限仍按内点比例自适应
+    SACSegmentationParallel<pcl::PointXYZ> ransac;
+    ransac.setInputCloud(cloud);
+    ransac.setDistanceThreshold(0.01);
+    ransac.setMaxIterations(1000);//与 RandomSampleConsensus 的默认值相同
+    ransac.setOptimizeCoefficients(false);
+    int seed = 12345;
+    std::string trace_file;
+    pcl::console::parse_argument(argc, argv, "-seed", seed);
+    pcl::console::parse_argument(argc, argv, "-trace", trace_file);
+    ransac.setSeed(static_cast<unsigned int>(seed));
+    ransac.setTraceEnabled(!trace_file.empty());
+    std::vector<double> prior_values;
+    pcl::console::parse_x_arguments(argc, argv, "-prior", prior_values);
 
     //检测平面点云
     if (pcl::console::find_argument(argc, argv, "-f") >= 0) {
-        pcl::RandomSampleConsensus<pcl::PointXYZ> ransac(model_p);
-        ransac.setDistanceThreshold(0.01);
-        ransac.computeModel();
-        ransac.getInliers(inliers);
+        ransac.setModelType(pcl::SACMODEL_PLANE);
     //检测球形点云
     } else if (pcl::console::find_argument(argc, argv, "-sf") >= 0) {
-        pcl::RandomSampleConsensus<pcl::PointXYZ> ransac(model_s);
-        ransac.setDistanceThreshold(0.01);
-        ransac.computeModel();
-        ransac.getInliers(inliers);
+        ransac.setModelType(pcl::SACMODEL_SPHERE);
+    }
+    if (pcl::console::find_argument(argc, argv, "-f") >= 0 || pcl::console::find_argument(argc, argv, "-sf") >= 0) {
+        pcl::PointIndices model_inliers;
+        pcl::ModelCoefficients coefficients;
+        if (prior_values.size() == 4) {
+            pcl::ModelCoefficients prior;
+            prior.values.assign(prior_values.begin(), prior_values.end());
+            ransac.setPrior(prior, 0.5);
+        }
+        ransac.segment(model_inliers, coefficients);
+        inliers = model_inliers.indices;
+        std::cout << "iterations: " << ransac.getIterations() << ", inliers: " << inliers.size()
+                  << (ransac.isWarmStarted() ? " (from prior)" : "") << std::endl;
+        if (!trace_file.empty() && ransac.saveTrace(trace_file))
+            std::cout << "trace saved to " << trace_file << std::endl;
     }
 
     //copies all inliers of the model computed to another pointcloud
@@ -7,25 +7,44 @@
 #include<pcl/io/pcd_io.h>
 #include<pcl/features/normal_3d.h>
 
-int main()
+#include "../../common/neighborhood_graph.h"
+#include "../../common/normal_estimation_batch.h"
+#include "../../common/normal_orientation.h"
+
+int main(int argc, char **argv)
 {
     //load point cloud
+    //可以传入多个视角的点云(如 room_scan1.pcd room_scan2.pcd)，拼接后一起估计
     pcl::PointCloud<pcl::PointXYZ>::Ptr cloud(new pcl::PointCloud<pcl::PointXYZ>);
-    pcl::io::loadPCDFile("../../../data/c1.pcd",*cloud);
+    if (argc < 2)
+        pcl::io::loadPCDFile("../../../data/c1.pcd",*cloud);
+    for (int i = 1; i < argc; ++i) {
+        pcl::PointCloud<pcl::PointXYZ> view;
+        pcl::io::loadPCDFile(argv[i], view);
+        *cloud += view;
+    }
     //estimate normal
     pcl::PointCloud<pcl::Normal>::Ptr normals(new pcl::PointCloud<pcl::Normal>);
 
     //object for normal estimation
-    pcl::NormalEstimation<pcl::PointXYZ, pcl::Normal> ne;
+    //与 pcl::NormalEstimation 用法相同，邻域查询多线程，协方差与特征值按 8 个邻域一批计算
+    NormalEstimationBatch<pcl::PointXYZ, pcl::Normal> ne;
 
     ne.setInputCloud(cloud);
     ne.setRadiusSearch(0.05);
-    //创建一个空的kdtree，讲只传递给法向量估计对象
-    //这个tree对象将会在ne内部根据输入数据进行填充
-    pcl::search::KdTree<pcl::PointXYZ>::Ptr kdtree(new pcl::search::KdTree<pcl::PointXYZ>);
-    ne.setSearchMethod(kdtree);
+    //邻域图只建一次，法线估计与方向传播共用
+    NeighborhoodGraph<pcl::PointXYZ>::Ptr graph(new NeighborhoodGraph<pcl::PointXYZ>);
+    graph->buildRadius(cloud, 0.05);
+    NeighborhoodGraphSearch<pcl::PointXYZ>::Ptr search(new NeighborhoodGraphSearch<pcl::PointXYZ>(graph));
+    ne.setSearchMethod(search);
     ne.compute(*normals);
 
+    //固定视点只对单个视角有效，拼接的点云在邻域图上沿最小生成树传播方向
+    NormalOrientation<pcl::PointXYZ, pcl::Normal> orientation;
+    orientation.setNeighborhoodGraph(graph);
+    int components = orientation.orient(*normals);
+    std::cout << "components: " << components << ", flipped: " << orientation.getNumberOfFlipped() << std::endl;
+
     //visualize normals
     pcl::visualization::PCLVisualizer viewer("pcl viewer");
     viewer.setBackgroundColor(0.0, 0.0, 0.5);
@@ -10,6 +10,8 @@
 #include<pcl/visualization/cloud_viewer.h>
 #include <pcl/filters/extract_indices.h>
 
+#include "../../common/lazy_normal_field.h"
+
 int main(int argc, char **argv) {
 
     pcl::PointCloud<pcl::PointXYZ>::Ptr cloud(new pcl::PointCloud<pcl::PointXYZ>);
@@ -22,19 +24,18 @@ int main(int argc, char **argv) {
     for (std::size_t i = 0; i < indices.size(); ++i)
         indices[i] = i;
 
-// 创建法向量估算类，设置输入点云
-    pcl::NormalEstimation<pcl::PointXYZ, pcl::Normal> ne;
+// 按需计算的法线场：只有被访问(或预取)的点才查询邻域、求法线，其余 90% 的点不计算
+    LazyNormalField<pcl::PointXYZ> ne;
     ne.setInputCloud(cloud);
 
-// 设置indices索引
     boost::shared_ptr<std::vector<int> > indicesptr(new std::vector<int>(indices));
-    ne.setIndices(indicesptr);
-// 创建一个空的kdtree，将值传递给法向量估算对象
-// 这个tree对象将会在ne内部根据输入的数据集进行填充（这里设置没有其他的search surface）
+// 创建一个空的kdtree，将值传递给法向量估算对象，第一次访问时根据输入点云建立
     pcl::search::KdTree<pcl::PointXYZ>::Ptr tree(new pcl::search::KdTree<pcl::PointXYZ>());
     ne.setSearchMethod(tree);
     ne.setRadiusSearch(0.03);// 使用一个半径为3cm的球体中的所有邻居点
-    ne.compute(*cloud_normals);// 计算特征
+// 批量预取 indices 上的法线(多线程)，按 indices 的顺序输出；之后也可以用 ne.getNormal(i) 逐点读取
+    ne.getNormals(indices, *cloud_normals);
+    std::cout << "computed normals: " << ne.getNumberOfComputed() << " / " << cloud->points.size() << std::endl;
 
 //根据索引过滤点云
     pcl::PointCloud<pcl::PointXYZ>::Ptr cloud_filed(new pcl::PointCloud<pcl::PointXYZ>);
@@ -6,6 +6,8 @@
 #include <pcl/features/normal_3d.h>
 #include<pcl/visualization/cloud_viewer.h>
 
+#include "../../common/normal_estimation_batch.h"
+
 int main()
 {
     //load point cloud
@@ -15,8 +17,8 @@ int main()
 
     pcl::io::loadPCDFile("../../../data/person/person.pcd", *cloud);
 
-    //创建一个法线估计的对象并计算法线
-    pcl::NormalEstimation<pcl::PointXYZ,pcl::Normal> ne;
+    //创建一个法线估计的对象并计算法线(批量计算协方差与特征值，用法与 pcl::NormalEstimation 相同)
+    NormalEstimationBatch<pcl::PointXYZ,pcl::Normal> ne;
     ne.setInputCloud(cloud);
     ne.setRadiusSearch(0.03);
     pcl::search::KdTree<pcl::PointXYZ>::Ptr kdtree(new pcl::search::KdTree<pcl::PointXYZ>);
@@ -6,6 +6,8 @@
 #include <pcl/features/integral_image_normal.h>
 #include <pcl/visualization/cloud_viewer.h>
 
+#include "../../common/integral_image_normal_parallel.h"
+
 int
 main() {
     // load point cloud
@@ -16,7 +18,8 @@ main() {
     pcl::PointCloud<pcl::Normal>::Ptr normals(new pcl::PointCloud<pcl::Normal>);
 
     // 创建一个用于法线估计的对象并计算法线
-    pcl::IntegralImageNormalEstimation<pcl::PointXYZ, pcl::Normal> ne;
+    // AVERAGE_3D_GRADIENT 按行条带多线程计算，块内现建 float 积分图；其它方式交给 PCL
+    IntegralImageNormalEstimationParallel<pcl::PointXYZ, pcl::Normal> ne;
     // 有以下可选的估算方式：
     /**
     enum NormalEstimationMethod
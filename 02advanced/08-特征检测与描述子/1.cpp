@@ -5,12 +5,22 @@
 #include<pcl/visualization/cloud_viewer.h>
 #include<pcl/features/normal_3d.h>
 
+#include "../../common/compact_features.h"
+#include "../../common/neighborhood_graph.h"
+#include "../../common/pfh_estimation_batch.h"
+
 int main()
 {
     //load point cloud
     pcl::PointCloud<pcl::PointXYZ>::Ptr cloud(new pcl::PointCloud<pcl::PointXYZ>);
     pcl::io::loadPCDFile("../../../data/c1.pcd", *cloud);
 
+    //按最大的半径(PFH 的 0.08)只查询一次 kd-tree，得到 CSR 邻域图
+    //法线(0.03)与 PFH(0.08)都从图中截取邻居，不再各自建树查询
+    NeighborhoodGraph<pcl::PointXYZ>::Ptr graph(new NeighborhoodGraph<pcl::PointXYZ>);
+    graph->buildRadius(cloud, 0.08);
+    NeighborhoodGraphSearch<pcl::PointXYZ>::Ptr search(new NeighborhoodGraphSearch<pcl::PointXYZ>(graph));
+
     //estimate normal
     pcl::PointCloud<pcl::Normal>::Ptr normals(new pcl::PointCloud<pcl::Normal>);
     //object for normal estimation
@@ -18,30 +28,29 @@ int main()
     normalEstimation.setInputCloud(cloud);
     normalEstimation.setRadiusSearch(0.03);
 
-    //A kd-tree is a data structure that makes searches efficient 
     //the normal estimation object will use it to find nearest neighbors
-    pcl::search::KdTree<pcl::PointXYZ>::Ptr kdtree(new pcl::search::KdTree<pcl::PointXYZ>);
-    normalEstimation.setSearchMethod(kdtree);
+    normalEstimation.setSearchMethod(search);
     //calculate the normals
     normalEstimation.compute(*normals);
 
     //create the pfh estimation class and pass the input dataset+normals to if计算PFH直方图
-    pcl::PFHEstimation<pcl::PointXYZ, pcl::Normal, pcl::PFHSignature125> pfh;
+    //与 pcl::PFHEstimation 用法相同，多线程，每个邻域的点对按 4 个一组用 SSE2 计算
+    PFHEstimationBatch<pcl::PointXYZ, pcl::Normal, pcl::PFHSignature125> pfh;
     pfh.setInputCloud(cloud);
     pfh.setInputNormals(normals);
 
-    pcl::search::KdTree<pcl::PointXYZ>::Ptr tree(new pcl::search::KdTree<pcl::PointXYZ>());
-    pfh.setSearchMethod(tree);
-    pcl::PointCloud<pcl::PFHSignature125>::Ptr pfhs(new pcl::PointCloud<pcl::PFHSignature125>());
-
+    pfh.setSearchMethod(search);
     pfh.setRadiusSearch(0.08);
-    pfh.compute(*pfhs);
-    unsigned long size = pfhs->points.size();
+    //按块计算，每块算完立即量化为 uint16(每个点 250 字节，浮点的 PFHSignature125 为 500 字节)
+    //PFH 的分量普遍小于 1，uint8 精度不够
+    std::vector<PFHSignature125U16> pfhs;
+    computeQuantizedFeatures(pfh, pfhs);
+    unsigned long size = pfhs.size();
     for(int j = 0;j<size;++j)
     {
-        pcl::PFHSignature125 &signature125 = pfhs->points[j];
-        float *h = signature125.histogram;
-        printf("%d: %f,%f,%f\n",j,h[1],h[2],h[3]);
+        const PFHSignature125U16 &signature125 = pfhs[j];
+        printf("%d: %f,%f,%f\n",j,dequantizeBin(signature125, 1),dequantizeBin(signature125, 2),
+               dequantizeBin(signature125, 3));
     }
     pcl::visualization::PCLVisualizer viewer("pcl viewer");
     viewer.setBackgroundColor(0,0,0.5);
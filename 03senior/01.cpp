@@ -10,6 +10,9 @@
 #include<pcl/filters/approximate_voxel_grid.h>//滤波头文件
 #include<pcl/filters/statistical_outlier_removal.h>
 #include<pcl/visualization/pcl_visualizer.h>
+#include<pcl/console/parse.h>
+
+#include "../common/registration_anytime.h"
 
 using namespace std::chrono_literals;
 
@@ -65,8 +68,18 @@ int main(int argc, char **argv) {
     Eigen::Matrix4f init_guess = (init_translation * init_rotation).matrix();
 
     //计算所需的刚体变换，保证输入云与目标云对齐
+    //-budget <ms> 时逐步迭代，到时返回目前的变换
     pcl::PointCloud<pcl::PointXYZ>::Ptr output_cloud(new pcl::PointCloud<pcl::PointXYZ>);
-    ndt.align(*output_cloud, init_guess);
+    double budget_ms = -1.0;
+    pcl::console::parse_argument(argc, argv, "-budget", budget_ms);
+    if (budget_ms > 0.0) {
+        int steps = 0;
+        AnytimeStatus status = alignWithBudget(ndt, *output_cloud, init_guess, 50,
+                                               AnytimeBudget::fromNow(budget_ms), &steps);
+        std::cout << "NDT steps: " << steps << ", status: " << anytimeStatusName(status) << std::endl;
+    } else {
+        ndt.align(*output_cloud, init_guess);
+    }
 
 //    std::cout << "normal distributions transform has converged" << ndt.hasConverged()
 //              << " score: " << ndt.getFitnessScore() << std::endl;
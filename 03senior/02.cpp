@@ -6,6 +6,7 @@
 #include <pcl/point_cloud.h>
 #include <pcl/common/time.h>
 #include <pcl/console/print.h>
+#include <pcl/console/parse.h>
 #include <pcl/features/normal_3d_omp.h>
 #include <pcl/features/fpfh_omp.h>
 #include <pcl/filters/filter.h>
@@ -16,12 +17,17 @@
 #include <pcl/segmentation/sac_segmentation.h>
 #include <pcl/visualization/pcl_visualizer.h>
 
+#include "../common/compact_features.h"
+#include "../common/descriptor_index.h"
+#include "../common/registration_anytime.h"
+
 //定义数据类型
 typedef pcl::PointNormal PointNT;
 typedef pcl::PointCloud<PointNT> PointCloudT;
 typedef pcl::FPFHSignature33 FeatureT;
 typedef pcl::FPFHEstimationOMP<PointNT,PointNT,FeatureT> FeatureEstimationT;
-typedef pcl::PointCloud<FeatureT> FeatureCloudT;
+typedef FPFHSignature33U8 QuantizedFeatureT;//量化为 uint8 的 FPFH，33 字节
+typedef std::vector<QuantizedFeatureT> FeatureCloudT;
 typedef pcl::visualization::PointCloudColorHandlerCustom<PointNT> ColorHandlerT;
 
 int main(int argc, char **argv)
@@ -30,15 +36,18 @@ int main(int argc, char **argv)
     PointCloudT::Ptr object(new PointCloudT);
     PointCloudT::Ptr object_aligned(new PointCloudT);
     PointCloudT::Ptr scene(new PointCloudT);
-    FeatureCloudT::Ptr object_features(new FeatureCloudT);
-    FeatureCloudT::Ptr scene_features(new FeatureCloudT);
+    boost::shared_ptr<FeatureCloudT> object_features(new FeatureCloudT);
+    boost::shared_ptr<FeatureCloudT> scene_features(new FeatureCloudT);
 
     //get input object and scene
-    if(argc!=3)
+    if(argc<3)
     {
-        pcl::console::print_error("Syntax is: %s object.pcd scene.pcd\n", argv[0]);
+        pcl::console::print_error("Syntax is: %s object.pcd scene.pcd [-budget ms]\n", argv[0]);
         return 1;
     }
+    //-budget <ms>：配准的时间预算，到时返回目前最好的位姿
+    double budget_ms = -1.0;
+    pcl::console::parse_argument(argc, argv, "-budget", budget_ms);
     
     //load object and scene
     pcl::console::print_highlight("Loading point clouds.....\n");
@@ -74,19 +83,29 @@ int main(int argc, char **argv)
     fest.setRadiusSearch(0.025);
     fest.setInputCloud(object);
     fest.setInputNormals(object);
-    fest.compute(*object_features);
+    //分块计算并立即量化，不保存浮点描述子
+    computeQuantizedFeatures(fest, *object_features);
     fest.setInputCloud(scene);
     fest.setInputNormals(scene);
-    fest.compute(*scene_features);
+    computeQuantizedFeatures(fest, *scene_features);
+
+    //在场景描述子上建 HNSW 索引，预先为物体的每个描述子查好最近的 5 个，配准迭代中只查表
+    CorrespondenceTable::Ptr correspondences(new CorrespondenceTable);
+    {
+        pcl::ScopeTime t("Descriptor index");
+        HNSWDescriptorIndex<QuantizedFeatureT> descriptor_index;
+        descriptor_index.setInputTarget(scene_features);
+        buildCorrespondenceTable(descriptor_index, *object_features, 5, *correspondences);
+    }
 
     // Perform alignment
     // SampleConsensusPrerejective 实现了有效的RANSAC姿势估计循环
     pcl::console::print_highlight("Starting alignment.....\n");
-    pcl::SampleConsensusPrerejective<PointNT, PointNT, FeatureT> align;
+    SampleConsensusPrerejectiveAnytime<PointNT, PointNT, FeatureT> align;
     align.setInputCloud(object);
-    align.setSourceFeatures(object_features);
     align.setInputTarget(scene);
-    align.setTargetFeatures(scene_features);
+    //对应点取表中按 L1 距离最近的 5 个之一
+    align.setCorrespondenceTable(correspondences);
     align.setMaximumIterations(50000);
     align.setNumberOfSamples(3);
     align.setCorrespondenceRandomness(5);
@@ -96,8 +115,12 @@ int main(int argc, char **argv)
     {
 
         pcl::ScopeTime t("Alignment");//执行对齐配准过程
+        if (budget_ms > 0.0)
+            align.setBudget(AnytimeBudget::fromNow(budget_ms));
         align.align(*object_aligned);//对齐的对象储存在点云中，
     }
+    pcl::console::print_info("Pose hypotheses: %i, status: %s\n", align.getIterations(),
+                             anytimeStatusName(align.getStatus()));
 
 
     if(align.hasConverged())
@@ -10,6 +10,12 @@
 #include <pcl/sample_consensus/method_types.h>
 #include <pcl/sample_consensus/model_types.h>
 #include <pcl/segmentation/sac_segmentation.h>
+#include <pcl/console/parse.h>
+#include <pcl/console/time.h>
+
+#include "../common/normal_estimation_batch.h"
+#include "../common/organized_plane_segmentation.h"
+#include "../common/sac_parallel.h"
 
 typedef pcl::PointXYZ PointT;
 
@@ -18,19 +24,16 @@ main(int argc, char **argv) {
     // All the objects needed
     pcl::PCDReader reader;                          // PCD文件读取对象
     pcl::PassThrough<PointT> pass;                  // 直通滤波器
-    pcl::NormalEstimation<PointT, pcl::Normal> ne;  // 法线估算对象
-    pcl::SACSegmentationFromNormals<PointT, pcl::Normal> seg;   // 分割器
+    NormalEstimationBatch<PointT, pcl::Normal> ne;  // 法线估算对象，批量计算协方差与特征值
+    SACSegmentationParallel<PointT, pcl::Normal> seg;           // 分割器，批量假设 + 多线程计数
     pcl::PCDWriter writer;                                      // PCD文件写出对象
     pcl::ExtractIndices<PointT> extract;                        // 点提取对象
-    pcl::ExtractIndices<pcl::Normal> extract_normals;           // 法线提取对象
     pcl::search::KdTree<PointT>::Ptr tree(new pcl::search::KdTree<PointT>());
 
     // Datasets
     pcl::PointCloud<PointT>::Ptr cloud(new pcl::PointCloud<PointT>);
     pcl::PointCloud<PointT>::Ptr cloud_filtered(new pcl::PointCloud<PointT>);
     pcl::PointCloud<pcl::Normal>::Ptr cloud_normals(new pcl::PointCloud<pcl::Normal>);
-    pcl::PointCloud<PointT>::Ptr cloud_filtered2(new pcl::PointCloud<PointT>);
-    pcl::PointCloud<pcl::Normal>::Ptr cloud_normals2(new pcl::PointCloud<pcl::Normal>);
     pcl::ModelCoefficients::Ptr coefficients_plane(new pcl::ModelCoefficients), coefficients_cylinder(
             new pcl::ModelCoefficients);
     pcl::PointIndices::Ptr inliers_plane(new pcl::PointIndices), inliers_cylinder(new pcl::PointIndices);
@@ -40,30 +43,54 @@ main(int argc, char **argv) {
     std::cerr << "PointCloud has: " << cloud->points.size() << " data points." << std::endl;
 
     // Build a passthrough filter to remove spurious NaNs
+    // 有序点云保持 640x480 的结构，滤掉的点置为 NaN
+    const bool organized = cloud->isOrganized();
+    pcl::console::TicToc tt;
+    tt.tic();
     pass.setInputCloud(cloud);
     pass.setFilterFieldName("z");
     pass.setFilterLimits(0, 1.5);
+    pass.setKeepOrganized(organized);
     pass.filter(*cloud_filtered);
     std::cerr << "PointCloud after filtering has: " << cloud_filtered->points.size() << " data points." << std::endl;
 
-    // Estimate point normals
-    ne.setSearchMethod(tree);
-    ne.setInputCloud(cloud_filtered);
-    ne.setKSearch(50);
-    ne.compute(*cloud_normals);
+    if (organized) {
+        // 有序点云：积分图法线 + 图像连通域平面分割，一次得到所有平面，取最大的平面为桌面
+        OrganizedPlaneExtractor<PointT> planes;
+        planes.setInputCloud(cloud_filtered);
+        std::vector<pcl::ModelCoefficients> plane_coefficients;
+        std::vector<pcl::PointIndices> plane_inliers;
+        planes.compute(plane_coefficients, plane_inliers);
+        cloud_normals = planes.getNormals();
+        std::cerr << "Organized planes: " << plane_inliers.size() << std::endl;
+        if (!plane_inliers.empty()) {
+            *coefficients_plane = plane_coefficients[0];
+            *inliers_plane = plane_inliers[0];
+        }
+    } else {
+        // Estimate point normals
+        ne.setSearchMethod(tree);
+        ne.setInputCloud(cloud_filtered);
+        ne.setKSearch(50);
+        ne.compute(*cloud_normals);
 
-    // Create the segmentation object for the planar model and set all the parameters
-    seg.setOptimizeCoefficients(true);
-    seg.setModelType(pcl::SACMODEL_NORMAL_PLANE);//平面模型
-    seg.setNormalDistanceWeight(0.1);
-    seg.setMethodType(pcl::SAC_RANSAC);
-    seg.setMaxIterations(100);
-    seg.setDistanceThreshold(0.03);
-    seg.setInputCloud(cloud_filtered);
-    seg.setInputNormals(cloud_normals);
-    // Obtain the plane inliers and coefficients
-    seg.segment(*inliers_plane, *coefficients_plane);
+        // Create the segmentation object for the planar model and set all the parameters
+        seg.setOptimizeCoefficients(true);
+        seg.setModelType(pcl::SACMODEL_NORMAL_PLANE);//平面模型
+        seg.setNormalDistanceWeight(0.1);
+        seg.setMethodType(pcl::SAC_RANSAC);
+        seg.setMaxIterations(100);
+        seg.setDistanceThreshold(0.03);
+        seg.setInputCloud(cloud_filtered);
+        seg.setInputNormals(cloud_normals);
+        // Obtain the plane inliers and coefficients
+        seg.segment(*inliers_plane, *coefficients_plane);
+        //SPRT 提前淘汰：落后的假设只检查了一小部分点
+        std::cerr << "Plane hypotheses: " << seg.getIterations() << ", evaluated points per hypothesis: "
+                  << seg.getEvaluatedFraction() * 100.0 << "%" << std::endl;
+    }
     std::cerr << "Plane coefficients: " << *coefficients_plane << std::endl;
+    std::cerr << "Plane segmentation took " << tt.toc() << " ms" << std::endl;
 
     // Extract the planar inliers from the input cloud
     extract.setInputCloud(cloud_filtered);
@@ -77,13 +104,15 @@ main(int argc, char **argv) {
               << std::endl;
     writer.write("table_scene_mug_stereo_textured_plane.pcd", *cloud_plane, false);
 
-    // Remove the planar inliers, extract the rest
-    extract.setNegative(true);
-    extract.filter(*cloud_filtered2);
-    extract_normals.setNegative(true);
-    extract_normals.setInputCloud(cloud_normals);
-    extract_normals.setIndices(inliers_plane);
-    extract_normals.filter(*cloud_normals2);
+    // Remove the planar inliers, keep the rest as indices
+    // 平面以外的有效点只记录索引，不复制点云与法线
+    pcl::PointIndices::Ptr remaining(new pcl::PointIndices);
+    std::vector<char> in_plane(cloud_filtered->points.size(), 0);
+    for (int index: inliers_plane->indices)
+        in_plane[index] = 1;
+    for (std::size_t i = 0; i < cloud_filtered->points.size(); ++i)
+        if (!in_plane[i] && pcl::isFinite(cloud_filtered->points[i]) && pcl::isFinite(cloud_normals->points[i]))
+            remaining->indices.push_back(static_cast<int>(i));
 
     // Create the segmentation object for cylinder segmentation and set all the parameters
     // 设置圆柱体分割对象参数
@@ -94,15 +123,32 @@ main(int argc, char **argv) {
     seg.setMaxIterations(10000);                // 设置最大迭代次数10000
     seg.setDistanceThreshold(0.05);             // 设置内点到模型的最大距离 0.05m
     seg.setRadiusLimits(0, 0.1);                // 设置圆柱体的半径范围0 -> 0.1m
-    seg.setInputCloud(cloud_filtered2);
-    seg.setInputNormals(cloud_normals2);
+    seg.setInputCloud(cloud_filtered);
+    seg.setInputNormals(cloud_normals);
+    seg.setIndices(remaining);
+    // 跟踪时传入上一帧的圆柱 -prior px,py,pz,ax,ay,az,r：先检验先验及其小扰动，内点比例够高就不做 RANSAC
+    std::vector<double> prior_values;
+    if (pcl::console::parse_x_arguments(argc, argv, "-prior", prior_values) > 0 && prior_values.size() == 7) {
+        pcl::ModelCoefficients prior;
+        prior.values.assign(prior_values.begin(), prior_values.end());
+        seg.setPrior(prior, 0.1);
+    }
 
     // Obtain the cylinder inliers and coefficients
+    tt.tic();
     seg.segment(*inliers_cylinder, *coefficients_cylinder);
     std::cerr << "Cylinder coefficients: " << *coefficients_cylinder << std::endl;
+    std::cerr << "Cylinder segmentation took " << tt.toc() << " ms, hypotheses: " << seg.getIterations()
+              << (seg.isWarmStarted() ? " (from prior)" : "") << std::endl;
+    //有序点云的积分图法线不带曲率，圆柱分割仍应找到杯子
+    if (coefficients_cylinder->values.empty()) {
+        std::cerr << "Cylinder segmentation failed (" << (organized ? "organized" : "unorganized") << " input)."
+                  << std::endl;
+        return (-1);
+    }
 
     // Write the cylinder inliers to disk
-    extract.setInputCloud(cloud_filtered2);
+    extract.setInputCloud(cloud_filtered);
     extract.setIndices(inliers_cylinder);
     extract.setNegative(false);
     pcl::PointCloud<PointT>::Ptr cloud_cylinder(new pcl::PointCloud<PointT>());
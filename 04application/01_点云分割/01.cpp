@@ -9,6 +9,8 @@
 #include<pcl/sample_consensus/model_types.h>
 #include<pcl/segmentation/sac_segmentation.h>
 
+#include "../../common/sac_parallel.h"
+
 int main(int argc, char **argv)
 {
     pcl::PointCloud<pcl::PointXYZ>::Ptr cloud(new pcl::PointCloud<pcl::PointXYZ>);
@@ -48,7 +50,8 @@ int main(int argc, char **argv)
     pcl::ModelCoefficients::Ptr coefficients(new pcl::ModelCoefficients);
     pcl::PointIndices::Ptr inliers(new pcl::PointIndices);
     //create the segmentation object
-    pcl::SACSegmentation<pcl::PointXYZ> seg;
+    //用法与 pcl::SACSegmentation 相同，假设按批生成并在所有核上计数
+    SACSegmentationParallel<pcl::PointXYZ> seg;
     //可选配置：是否油画模型系数-------------------------------------------
     seg.setOptimizeCoefficients(true);
     //必选配置：设置分割的模型类型，分割算法，距离阀值，输入点云--------------------------
@@ -10,6 +10,9 @@
 #include <pcl/sample_consensus/method_types.h>
 #include <pcl/sample_consensus/model_types.h>
 #include <pcl/segmentation/sac_segmentation.h>
+#include <pcl/console/time.h>
+
+#include "../../common/organized_plane_segmentation.h"
 
 typedef pcl::PointXYZ PointT;
 
@@ -22,15 +25,12 @@ main(int argc, char **argv) {
     pcl::SACSegmentationFromNormals<PointT, pcl::Normal> seg;   // 分割器
     pcl::PCDWriter writer;                                      // PCD文件写出对象
     pcl::ExtractIndices<PointT> extract;                        // 点提取对象
-    pcl::ExtractIndices<pcl::Normal> extract_normals;           // 法线提取对象
     pcl::search::KdTree<PointT>::Ptr tree(new pcl::search::KdTree<PointT>());
 
     // Datasets
     pcl::PointCloud<PointT>::Ptr cloud(new pcl::PointCloud<PointT>);
     pcl::PointCloud<PointT>::Ptr cloud_filtered(new pcl::PointCloud<PointT>);
     pcl::PointCloud<pcl::Normal>::Ptr cloud_normals(new pcl::PointCloud<pcl::Normal>);
-    pcl::PointCloud<PointT>::Ptr cloud_filtered2(new pcl::PointCloud<PointT>);
-    pcl::PointCloud<pcl::Normal>::Ptr cloud_normals2(new pcl::PointCloud<pcl::Normal>);
     pcl::ModelCoefficients::Ptr coefficients_plane(new pcl::ModelCoefficients), coefficients_cylinder(
             new pcl::ModelCoefficients);
     pcl::PointIndices::Ptr inliers_plane(new pcl::PointIndices), inliers_cylinder(new pcl::PointIndices);
@@ -40,34 +40,54 @@ main(int argc, char **argv) {
     std::cerr << "PointCloud has: " << cloud->points.size() << " data points." << std::endl;
 
     // Build a passthrough filter to remove spurious NaNs
-    //构建一个直通过滤器来删除虚假的point--------------------------------------------------------
+    //构建一个直通过滤器来删除虚假的point，有序点云保持图像结构，滤掉的点置为 NaN--------------------------
+    const bool organized = cloud->isOrganized();
+    pcl::console::TicToc tt;
+    tt.tic();
     pass.setInputCloud(cloud);
     pass.setFilterFieldName("z");
     pass.setFilterLimits(0, 1.5);
+    pass.setKeepOrganized(organized);
     pass.filter(*cloud_filtered);
     std::cerr << "PointCloud after filtering has: " << cloud_filtered->points.size() << " data points." << std::endl;
 
-    // Estimate point normals
-    //估计点法线---------------------------------------------------------------------
-    ne.setSearchMethod(tree);
-    ne.setInputCloud(cloud_filtered);
-    ne.setKSearch(50);
-    ne.compute(*cloud_normals);
+    if (organized) {
+        //有序点云：积分图法线 + 图像连通域平面分割，一次得到所有平面，最大的平面即桌面-----------------------
+        OrganizedPlaneExtractor<PointT> planes;
+        planes.setInputCloud(cloud_filtered);
+        std::vector<pcl::ModelCoefficients> plane_coefficients;
+        std::vector<pcl::PointIndices> plane_inliers;
+        planes.compute(plane_coefficients, plane_inliers);
+        cloud_normals = planes.getNormals();
+        std::cerr << "Organized planes: " << plane_inliers.size() << std::endl;
+        if (!plane_inliers.empty()) {
+            *coefficients_plane = plane_coefficients[0];
+            *inliers_plane = plane_inliers[0];
+        }
+    } else {
+        // Estimate point normals
+        //估计点法线---------------------------------------------------------------------
+        ne.setSearchMethod(tree);
+        ne.setInputCloud(cloud_filtered);
+        ne.setKSearch(50);
+        ne.compute(*cloud_normals);
 
-    // Create the segmentation object for the planar model and set all the parameters
-    //创建平面模型的分割对象，并设置所有参数------------------------------------
-    seg.setOptimizeCoefficients(true);
-    seg.setModelType(pcl::SACMODEL_NORMAL_PLANE);
-    seg.setNormalDistanceWeight(0.1);
-    seg.setMethodType(pcl::SAC_RANSAC);
-    seg.setMaxIterations(100);
-    seg.setDistanceThreshold(0.03);
-    seg.setInputCloud(cloud_filtered);
-    seg.setInputNormals(cloud_normals);
-    // Obtain the plane inliers and coefficients
-    //得到平面内层及系数-------------------------------------------
-    seg.segment(*inliers_plane, *coefficients_plane);
+        // Create the segmentation object for the planar model and set all the parameters
+        //创建平面模型的分割对象，并设置所有参数------------------------------------
+        seg.setOptimizeCoefficients(true);
+        seg.setModelType(pcl::SACMODEL_NORMAL_PLANE);
+        seg.setNormalDistanceWeight(0.1);
+        seg.setMethodType(pcl::SAC_RANSAC);
+        seg.setMaxIterations(100);
+        seg.setDistanceThreshold(0.03);
+        seg.setInputCloud(cloud_filtered);
+        seg.setInputNormals(cloud_normals);
+        // Obtain the plane inliers and coefficients
+        //得到平面内层及系数-------------------------------------------
+        seg.segment(*inliers_plane, *coefficients_plane);
+    }
     std::cerr << "Plane coefficients: " << *coefficients_plane << std::endl;
+    std::cerr << "Plane segmentation took " << tt.toc() << " ms" << std::endl;
 
     // Extract the planar inliers from the input cloud
     //从输入云中提取平面内层---------------------------------------------
@@ -83,14 +103,15 @@ main(int argc, char **argv) {
               << std::endl;
     writer.write("table_scene_mug_stereo_textured_plane.pcd", *cloud_plane, false);
 
-    // Remove the planar inliers, extract the rest
-    //去掉平面内层，取出其余部分------------------------------------------------------------------
-    extract.setNegative(true);
-    extract.filter(*cloud_filtered2);
-    extract_normals.setNegative(true);
-    extract_normals.setInputCloud(cloud_normals);
-    extract_normals.setIndices(inliers_plane);
-    extract_normals.filter(*cloud_normals2);
+    // Remove the planar inliers, keep the rest as indices
+    //去掉平面内层，其余的有效点只记录索引，不复制点云与法线---------------------------------------
+    pcl::PointIndices::Ptr remaining(new pcl::PointIndices);
+    std::vector<char> in_plane(cloud_filtered->points.size(), 0);
+    for (int index: inliers_plane->indices)
+        in_plane[index] = 1;
+    for (std::size_t i = 0; i < cloud_filtered->points.size(); ++i)
+        if (!in_plane[i] && pcl::isFinite(cloud_filtered->points[i]) && pcl::isFinite(cloud_normals->points[i]))
+            remaining->indices.push_back(static_cast<int>(i));
 
     // Create the segmentation object for cylinder segmentation and set all the parameters
     // 设置圆柱体分割对象参数---------------------------------------------------
@@ -101,8 +122,9 @@ main(int argc, char **argv) {
     seg.setMaxIterations(10000);                // 设置最大迭代次数10000
     seg.setDistanceThreshold(0.05);             // 设置内点到模型的最大距离 0.05m
     seg.setRadiusLimits(0, 0.1);                // 设置圆柱体的半径范围0 -> 0.1m
-    seg.setInputCloud(cloud_filtered2);
-    seg.setInputNormals(cloud_normals2);
+    seg.setInputCloud(cloud_filtered);
+    seg.setInputNormals(cloud_normals);
+    seg.setIndices(remaining);
 
     // Obtain the cylinder inliers and coefficients
     //求气缸内胆及系数-----------------------------------------------------------------------
@@ -111,7 +133,7 @@ main(int argc, char **argv) {
 
     // Write the cylinder inliers to disk
     //将柱面内层写入磁盘--------------------------------------------------------------------
-    extract.setInputCloud(cloud_filtered2);
+    extract.setInputCloud(cloud_filtered);
     extract.setIndices(inliers_cylinder);
     extract.setNegative(false);
     pcl::PointCloud<PointT>::Ptr cloud_cylinder(new pcl::PointCloud<PointT>());
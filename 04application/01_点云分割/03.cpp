@@ -1,10 +1,10 @@
 /*
  * 欧式聚类提取
  */
+#include <limits>
 #include <pcl/ModelCoefficients.h>
 #include <pcl/point_types.h>
 #include <pcl/io/pcd_io.h>
-#include <pcl/filters/extract_indices.h>
 #include <pcl/filters/voxel_grid.h>
 #include <pcl/features/normal_3d.h>
 #include <pcl/kdtree/kdtree.h>
@@ -13,13 +13,15 @@
 #include <pcl/segmentation/sac_segmentation.h>
 #include <pcl/segmentation/extract_clusters.h>
 #include <pcl/visualization/pcl_visualizer.h>
+#include <pcl/console/parse.h>
+
+#include "../../common/sac_parallel.h"
 
 int
 main(int argc, char **argv) {
     // Read in the cloud data
     pcl::PCDReader reader;
-    pcl::PointCloud<pcl::PointXYZ>::Ptr cloud(new pcl::PointCloud<pcl::PointXYZ>), cloud_f(
-            new pcl::PointCloud<pcl::PointXYZ>);
+    pcl::PointCloud<pcl::PointXYZ>::Ptr cloud(new pcl::PointCloud<pcl::PointXYZ>);
     reader.read("../pcd/room_scan1.pcd", *cloud);
     std::cout << "PointCloud before filtering has: " << cloud->points.size() << " data points." << std::endl; //*
 
@@ -34,54 +36,45 @@ main(int argc, char **argv) {
               << std::endl; //*
 
     // Create the segmentation object for the planar model and set all the parameters
-    // 创建平面模型分割器并初始化参数
-    pcl::SACSegmentation<pcl::PointXYZ> seg;
-    pcl::PointIndices::Ptr inliers(new pcl::PointIndices);
-    pcl::ModelCoefficients::Ptr coefficients(new pcl::ModelCoefficients);
-    pcl::PointCloud<pcl::PointXYZ>::Ptr cloud_plane(new pcl::PointCloud<pcl::PointXYZ>());
+    // 创建平面模型分割器并初始化参数，批量假设 + 多线程计数
+    SACSegmentationParallel<pcl::PointXYZ> seg;
     pcl::PCDWriter writer;
     seg.setOptimizeCoefficients(true);
     seg.setModelType(pcl::SACMODEL_PLANE);
     seg.setMethodType(pcl::SAC_RANSAC);
     seg.setMaxIterations(100);
     seg.setDistanceThreshold(0.02);
-
-    int i = 0, nr_points = (int) cloud_filtered->points.size();
-    while (cloud_filtered->points.size() > 0.3 * nr_points) {
-        // Segment the largest planar component from the remaining cloud
-        // 移除剩余点云中最大的平面
-        seg.setInputCloud(cloud_filtered);
-        // 执行分割，将分割出来的平面点云索引保存到inliers中
-        seg.segment(*inliers, *coefficients);
-        if (inliers->indices.size() == 0) {
-            std::cout << "Could not estimate a planar model for the given dataset." << std::endl;
-            break;
-        }
-
-        // Extract the planar inliers from the input cloud
-        // 从输入点云中取出平面内点
-        pcl::ExtractIndices<pcl::PointXYZ> extract;
-        extract.setInputCloud(cloud_filtered);
-        extract.setIndices(inliers);
-        extract.setNegative(false);
-
-        // Get the points associated with the planar surface
-        // 得到与平面相关的点cloud_plane
-        extract.filter(*cloud_plane);
-        std::cout << "PointCloud representing the planar component: " << cloud_plane->points.size() << " data points."
-                  << std::endl;
-
-        // Remove the planar inliers, extract the rest
-        // 从点云中剔除这些平面内点，提取出剩下的点保存到cloud_f中，并重新赋值给cloud_filtered。
-        extract.setNegative(true);
-        extract.filter(*cloud_f);
-        *cloud_filtered = *cloud_f;
-    }
+    seg.setInputCloud(cloud_filtered);
+    // -seed <int> 固定随机种子，-trace <file> 导出每个假设的记录(CSV)
+    int seed = 12345;
+    std::string trace_file;
+    pcl::console::parse_argument(argc, argv, "-seed", seed);
+    pcl::console::parse_argument(argc, argv, "-trace", trace_file);
+    seg.setSeed(static_cast<unsigned int>(seed));
+    seg.setTraceEnabled(!trace_file.empty());
+
+    // 依次移除剩余点云中最大的平面，直到剩余点不超过 30%
+    // 点云不再被 ExtractIndices 反复复制，只在内部把已分割的点从剩余点中去掉
+    std::vector<pcl::PointIndices> plane_inliers;
+    std::vector<pcl::ModelCoefficients> plane_coefficients;
+    seg.segmentMultiple(std::numeric_limits<int>::max(), plane_inliers, plane_coefficients, 1, 0.3);
+    if (plane_inliers.empty())
+        std::cout << "Could not estimate a planar model for the given dataset." << std::endl;
+    for (std::size_t i = 0; i < plane_inliers.size(); ++i)
+        std::cout << "PointCloud representing the planar component: " << plane_inliers[i].indices.size()
+                  << " data points." << std::endl;
+    if (!trace_file.empty())
+        seg.saveTrace(trace_file);
+
+    // 剩余的点（非平面点）的索引
+    pcl::PointIndices::Ptr remaining(new pcl::PointIndices);
+    seg.getRemainingIndices(*remaining);
+    pcl::IndicesPtr remaining_indices(new std::vector<int>(remaining->indices));
 
     // Creating the KdTree object for the search method of the extraction
-    // 为提取算法的搜索方法创建一个KdTree对象
+    // 为提取算法的搜索方法创建一个KdTree对象，只包含剩余的点
     pcl::search::KdTree<pcl::PointXYZ>::Ptr tree(new pcl::search::KdTree<pcl::PointXYZ>);
-    tree->setInputCloud(cloud_filtered);
+    tree->setInputCloud(cloud_filtered, remaining_indices);
 
     /**
      * 在这里，我们创建一个PointIndices的vector，该vector在vector <int>中包含实际的索引信息。
@@ -97,6 +90,7 @@ main(int argc, char **argv) {
     ec.setMaxClusterSize(25000);  // 每个簇（集群）的最大大小
     ec.setSearchMethod(tree);     // 设置点云搜索算法
     ec.setInputCloud(cloud_filtered);   // 设置输入点云
+    ec.setIndices(remaining_indices);   // 只在剩余的点中聚类
     ec.extract(cluster_indices);        // 设置提取到的簇，将每个簇以索引的形式保存到cluster_indices;
 
     pcl::visualization::PCLVisualizer::Ptr viewer(new pcl::visualization::PCLVisualizer("3D Viewer"));
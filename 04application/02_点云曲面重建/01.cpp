@@ -7,6 +7,9 @@
 #include <pcl/surface/mls.h>
 #include <pcl/visualization/cloud_viewer.h>
 
+#include "../../common/neighborhood_graph.h"
+#include "../../common/normal_orientation.h"
+
 int
 main(int argc, char **argv) {
     // Load input file into a PointCloud<T> with an appropriate type
@@ -36,6 +39,14 @@ main(int argc, char **argv) {
     // Reconstruct
     mls.process(mls_points);
 
+    //MLS 的法线方向是任意的，后续的曲面重建(泊松、贪婪三角化)需要一致的方向
+    pcl::PointCloud<pcl::PointNormal>::Ptr mls_cloud(new pcl::PointCloud<pcl::PointNormal>(mls_points));
+    NeighborhoodGraph<pcl::PointNormal>::Ptr graph(new NeighborhoodGraph<pcl::PointNormal>);
+    graph->buildKNN(mls_cloud, 9);
+    NormalOrientation<pcl::PointNormal, pcl::PointNormal> orientation;
+    orientation.setNeighborhoodGraph(graph);
+    orientation.orient(mls_points);
+
     pcl::visualization::CloudViewer viewer("Cloud Viewer");;
     viewer.showCloud(cloud);
     while (!viewer.wasStopped()) {
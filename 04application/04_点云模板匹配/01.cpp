@@ -1,12 +1,16 @@
 /* 20-点云模板匹配 */
+#include <algorithm>
 #include <limits>
 #include <fstream>
+#include <memory>
+#include <mutex>
 #include <vector>
 #include <Eigen/Core>
 #include <pcl/point_types.h>
 #include <pcl/point_cloud.h>
 #include <pcl/io/pcd_io.h>
 #include <pcl/kdtree/kdtree_flann.h>
+#include <pcl/search/kdtree.h>
 #include <pcl/filters/passthrough.h>
 #include <pcl/filters/voxel_grid.h>
 #include <pcl/features/normal_3d.h>
@@ -15,106 +19,259 @@
 #include <pcl/visualization/cloud_viewer.h>
 #include <pcl/search/impl/search.hpp>
 
+#include "../../common/compact_features.h"
+#include "../../common/descriptor_index.h"
+#include "../../common/feature_cloud_io.h"
+#include "../../common/neighborhood_graph.h"
+#include "../../common/parallel.h"
+#include "../../common/sac_ia_quantized.h"
+
 typedef pcl::visualization::PointCloudColorHandlerCustom<pcl::PointXYZ> PCLHandler;
 //--------------------
 //定义此类目的是提供一种方便的方法来计算和储存具有每个点的局部特征描绘的点云
+//对象不可复制，通过 FeatureCloud::ConstPtr 共享：设置好输入之后只读，场景与模板在内存中各只有一份。
+//法线与特征分阶段按需计算(std::call_once)：第一次访问时计算，多个线程同时访问时只算一次
 class FeatureCloud
 {
     public:
         //A bit of shorthand
         typedef pcl::PointCloud<pcl::PointXYZ> PointCloud;
         typedef pcl::PointCloud<pcl::Normal> SurfaceNormals;
-        typedef pcl::PointCloud<pcl::FPFHSignature33> LocalFeatures;//部分特色
-        typedef pcl::search::KdTree<pcl::PointXYZ> SearchMethod;
-        //構造函數創建一個新的:pcl:`KdTreeFLANN <pcl::KdTreeFLANN>`對象並初始化將在計算表面法線和局部特徵時使用的半徑參數。
+        //局部特征：量化为 uint8 的 FPFH(每点 33 字节)，法线用 32 位八面体编码保存
+        typedef FPFHSignature33U8 LocalFeature;
+        typedef std::vector<LocalFeature> LocalFeatures;
+        typedef boost::shared_ptr<const LocalFeatures> LocalFeaturesPtr;
+        typedef NeighborhoodGraph<pcl::PointXYZ> Neighborhoods;
+        typedef NeighborhoodGraphSearch<pcl::PointXYZ> SearchMethod;
+        typedef boost::shared_ptr<FeatureCloud> Ptr;
+        typedef boost::shared_ptr<const FeatureCloud> ConstPtr;
+        //构造函数只初始化计算表面法线和局部特征时使用的半径参数，邻域图在计算法线时按较大的半径建立
         FeatureCloud():
-                search_method_xyz_(new SearchMethod),
                 normal_radius_(0.02f),
-                feature_radius_(0.02f){}
+                feature_radius_(0.02f),
+                leaf_size_(0.0f),
+                use_cache_(true),
+                nr_threads_(0){
+            resetStages();
+        }
         
         ~FeatureCloud(){}
+
+        FeatureCloud(const FeatureCloud &) = delete;
+
+        FeatureCloud &operator=(const FeatureCloud &) = delete;
 /*       然後我們定義用於設置輸入雲的方法，通過將共享指針傳遞給 PointCloud 或提供要加載的 PCD 文件的名稱。
-        在任何一種情況下，在設置輸入之後，都會調用processInput，它將計算局部特徵描述符，如下所述。 */
+        设置输入只保存点云，法线与特征在第一次访问时计算。设置输入与参数不是线程安全的，应在共享之前完成。 */
         //Process the given cloud处理给定的点云
         void
-        setInputCloud(PointCloud::Ptr xyz)
+        setInputCloud(const PointCloud::ConstPtr &xyz)
         {
             xyz_ = xyz;
-            processInput();
+            resetStages();
         }
 
         //Load and process the cloud in the given PCD file
+        //结果缓存在 pcd_file + ".fcl" 中(feature_cloud_io.h)：参数、描述子类型与 PCD 的大小和修改时间都一致时
+        //直接映射读取，法线与特征两个阶段都视为已完成；否则特征计算完成时写入缓存
         void
         loadInputCloud(const std::string &pcd_file)
         {
-            xyz_ = PointCloud::Ptr(new PointCloud);
-            pcl::io::loadPCDFile(pcd_file, *xyz_);
-            processInput();
+            resetStages();
+            const std::string cache_file = pcd_file + ".fcl";
+            FeatureCloudSourceStamp source;
+            const bool has_source = getFeatureCloudSourceStamp(pcd_file, source);
+            if (use_cache_ && has_source && loadCache(cache_file, source))
+                return;
+
+            PointCloud::Ptr xyz(new PointCloud);
+            pcl::io::loadPCDFile(pcd_file, *xyz);
+            if (leaf_size_ > 0.0f) {
+                pcl::VoxelGrid<pcl::PointXYZ> vox_grid;
+                vox_grid.setInputCloud(xyz);
+                vox_grid.setLeafSize(leaf_size_, leaf_size_, leaf_size_);
+                PointCloud::Ptr filtered(new PointCloud);
+                vox_grid.filter(*filtered);
+                xyz = filtered;
+            }
+            xyz_ = xyz;
+            if (use_cache_ && has_source) {
+                cache_file_ = cache_file;
+                cache_source_ = source;
+            }
+        }
+
+        //loadInputCloud 读入点云后先按此体素大小降采样，0 表示不降采样
+        void
+        setLeafSize(float leaf_size){
+            leaf_size_ = leaf_size;
+        }
+
+        //是否读写 .fcl 缓存
+        void
+        setUseCache(bool use_cache){
+            use_cache_ = use_cache;
+        }
+
+        //计算阶段(建邻域图)使用的线程数，0 表示使用全部硬件线程。
+        //阶段在 TemplateAlignment 的工作线程中按需计算时应设为 1，否则每个工作线程再开满全部硬件线程
+        void
+        setNumberOfThreads(int nr_threads){
+            nr_threads_ = nr_threads;
+        }
+
+        FeatureCloudParameters
+        getParameters() const{
+            FeatureCloudParameters parameters;
+            parameters.normal_radius = normal_radius_;
+            parameters.feature_radius = feature_radius_;
+            parameters.leaf_size = leaf_size_;
+            return(parameters);
+        }
+
+        //立即完成全部计算阶段，之后的访问都不再计算
+        void
+        compute() const{
+            computeFeatureStage();
         }
 /* 我們還定義了一些公共訪問器方法，可用於獲取指向點、表面法線和局部特徵描述符的共享指針。
  */ 
         //Get a pointer to the cloud 3D points
-        PointCloud::Ptr
+        PointCloud::ConstPtr
         getPointCloud() const{
             return (xyz_);
         }
+
+        //32 位编码的法线，第一次访问时计算
+        const std::vector<PackedNormal> &
+        getPackedNormals() const{
+            computeNormalStage();
+            return(normals_);
+        }
+
        //Get a pointer to the cloud of 3D surface normals
+        //法线按 32 位编码保存，这里解码(曲率为 0)
         SurfaceNormals::Ptr
         getSurfaceNormals() const{
-            return(normals_);
+            SurfaceNormals::Ptr normals(new SurfaceNormals);
+            unpackNormals(getPackedNormals(), *normals);
+            return(normals);
         }
 
         //Get a pointer to cloud of feature descriptors
-        LocalFeatures::Ptr
+        //第一次访问时计算(需要时先计算法线)
+        LocalFeaturesPtr
         getLocalFeatures() const{
+            computeFeatureStage();
             return(features_);
         }
     protected:
-        //Compute the surface normals and local features
         void
-        processInput(){
-            computeSurfaceNormals();
-            computeLocalFeatures();
+        resetStages(){
+            normal_stage_.reset(new std::once_flag);
+            feature_stage_.reset(new std::once_flag);
+            normals_.clear();
+            features_.reset();
+            float_normals_.reset();
+            search_method_xyz_.reset();
+            cache_file_.clear();
         }
 
-        //Compute the surface normals
+        //从映射的缓存文件复制点、编码的法线与量化描述子，文件无效或过期时返回 false
+        bool
+        loadCache(const std::string &cache_file, const FeatureCloudSourceStamp &source){
+            FeatureCloudFileView view;
+            if (!view.open(cache_file) || !view.matches<LocalFeature>(getParameters(), source))
+                return(false);
+            const std::size_t n = view.size();
+            PointCloud::Ptr xyz(new PointCloud);
+            view.copyPoints(*xyz);
+            xyz_ = xyz;
+            normals_.assign(view.normals(), view.normals() + n);
+            features_ = LocalFeaturesPtr(new LocalFeatures(view.features<LocalFeature>(), view.features<LocalFeature>() + n));
+            //两个阶段都已完成
+            std::call_once(*normal_stage_, [](){});
+            std::call_once(*feature_stage_, [](){});
+            return(true);
+        }
+
+        //法线阶段：只查询一次 kd-tree，按法线与特征中较大的半径建邻域图，法线与特征都从图中截取邻居。
+        //浮点法线保留到特征阶段使用，之后只保留编码后的法线
         void
-        computeSurfaceNormals(){
+        computeNormalStage() const{
+            std::call_once(*normal_stage_, [this](){
+                Neighborhoods::Ptr neighborhoods(new Neighborhoods);
+                neighborhoods->setNumberOfThreads(nr_threads_);
+                neighborhoods->buildRadius(xyz_, std::max(normal_radius_, feature_radius_));
+                search_method_xyz_ = SearchMethod::Ptr(new SearchMethod(neighborhoods));
+                float_normals_ = computeSurfaceNormals();
+                packNormals(*float_normals_, normals_);
+            });
+        }
+
+        //特征阶段：计算量化 FPFH，释放邻域图与浮点法线，需要时写缓存
+        void
+        computeFeatureStage() const{
+            std::call_once(*feature_stage_, [this](){
+                computeNormalStage();
+                features_ = computeLocalFeatures(float_normals_);
+                float_normals_.reset();
+                search_method_xyz_.reset();
+                if (!cache_file_.empty() &&
+                    !saveFeatureCloud(cache_file_, getParameters(), cache_source_, *xyz_, normals_, *features_))
+                    PCL_WARN("[FeatureCloud::compute] cannot write cache %s\n", cache_file_.c_str());
+            });
+        }
+
+        //Compute the surface normals
+        SurfaceNormals::Ptr
+        computeSurfaceNormals() const{
 
             //创建表面法向量
-            normals_ = SurfaceNormals::Ptr(new SurfaceNormals);
+            SurfaceNormals::Ptr normals(new SurfaceNormals);
 
             //计算表面法向量
             pcl::NormalEstimation<pcl::PointXYZ, pcl::Normal> norm_est;
             norm_est.setInputCloud(xyz_);
             norm_est.setSearchMethod(search_method_xyz_);
             norm_est.setRadiusSearch(normal_radius_);
-            norm_est.compute(*normals_);
-
+            norm_est.compute(*normals);
+            return(normals);
         }
         //Compute the local feature descriptors
-        //根据表面法向量，计算本地特征描述
-        void
-        computeLocalFeatures(){
-            features_ = LocalFeatures::Ptr(new LocalFeatures);
+        //根据表面法向量，计算本地特征描述，分块计算并立即量化
+        LocalFeaturesPtr
+        computeLocalFeatures(const SurfaceNormals::ConstPtr &normals) const{
+            boost::shared_ptr<LocalFeatures> features(new LocalFeatures);
 
             pcl::FPFHEstimation<pcl::PointXYZ, pcl::Normal, pcl::FPFHSignature33> fpfh_est;
             fpfh_est.setInputCloud(xyz_);
-            fpfh_est.setInputNormals(normals_);
+            fpfh_est.setInputNormals(normals);
             fpfh_est.setSearchMethod(search_method_xyz_);
             fpfh_est.setRadiusSearch(feature_radius_);
-            fpfh_est.compute(*features_);
+            computeQuantizedFeatures(fpfh_est, *features);
+            return(features);
         }
     private:
         //Point cloud data
-        PointCloud::Ptr xyz_;
-        SurfaceNormals::Ptr normals_;
-        LocalFeatures::Ptr features_;//快速点特征直方图
-        SearchMethod::Ptr search_method_xyz_;//KDTree方法查找领域
+        PointCloud::ConstPtr xyz_;
+        //按需计算的阶段，由 call_once 保护
+        mutable std::vector<PackedNormal> normals_;//32 位编码的法线
+        mutable LocalFeaturesPtr features_;//量化的快速点特征直方图
+        mutable SurfaceNormals::Ptr float_normals_;//特征阶段之前的浮点法线
+        mutable SearchMethod::Ptr search_method_xyz_;//邻域图(CSR)查找领域
+        std::unique_ptr<std::once_flag> normal_stage_;
+        std::unique_ptr<std::once_flag> feature_stage_;
+
+        //特征计算完成后写入的缓存文件，空表示不写
+        std::string cache_file_;
+        FeatureCloudSourceStamp cache_source_;
 
         //Parameters
         float normal_radius_;
         float feature_radius_;
+        float leaf_size_;
+        bool use_cache_;
+        int nr_threads_;
 };
 
 //模板对齐
@@ -131,71 +288,116 @@ class TemplateAlignment{
             EIGEN_MAKE_ALIGNED_OPERATOR_NEW
         };
 
+        typedef HNSWDescriptorIndex<FeatureCloud::LocalFeature> DescriptorIndex;
+        typedef SampleConsensusInitialAlignmentQuantized<pcl::PointXYZ, pcl::PointXYZ, pcl::FPFHSignature33,
+                FeatureCloud::LocalFeature> Registration;
+        typedef pcl::search::KdTree<pcl::PointXYZ> TargetSearch;
+        typedef std::vector<Result, Eigen::aligned_allocator<Result>> Results;
+
         TemplateAlignment():
             min_sample_distance_(0.05f),
             max_correspondence_distance_(0.01f * 0.01f),
-            nr_iterations_(500){
+            nr_iterations_(500),
+            nr_correspondences_(10),
+            nr_threads_(0),
+            nr_coarse_iterations_(50),
+            top_k_(0){
 
                 //初始化SAC-IA算法的参数
-                sac_ia_.setMinSampleDistance(min_sample_distance_);
-                sac_ia_.setMaxCorrespondenceDistance(max_correspondence_distance_);
-                sac_ia_.setMaximumIterations(nr_iterations_);
+                configure(sac_ia_);
             }
 
         ~TemplateAlignment(){}
 
+        //alignALL 与 findBestAlignment 的线程数，0 表示使用全部硬件线程
+        void
+        setNumberOfThreads(int nr_threads){
+            nr_threads_ = nr_threads;
+        }
+
+        /**
+         * 近似的由粗到精选择(默认关闭)：findBestAlignment 先对每个模板只跑前 nr_coarse_iterations 次 SAC-IA 迭代，
+         * 按匹配分数排序，再只对前 top_k 个跑完整的迭代。匹配分数没有可靠的下界，粗选落在 top_k 之外的模板
+         * 完整对齐后仍可能是最好的，这时结果与穷举不同。top_k <= 0(默认)或不少于模板数时对全部模板完整对齐(穷举)
+         */
+        void
+        setCoarseToFine(int nr_coarse_iterations, int top_k){
+            nr_coarse_iterations_ = nr_coarse_iterations;
+            top_k_ = top_k;
+        }
+
         //将给定的云设置为模板要对齐的目标
         void 
-        setTargetCloud(FeatureCloud &target_cloud){
+        setTargetCloud(const FeatureCloud::ConstPtr &target_cloud){
             target_ = target_cloud;
-            //设置输入target点云
-            sac_ia_.setInputTarget(target_cloud.getPointCloud());
-            //设置特征target
-            sac_ia_.setTargetFeatures(target_cloud.getLocalFeatures());
+            //目标点云的 kd-tree 与描述子的 HNSW 索引只建一次，所有模板、所有线程共用(查询只读)
+            target_search_ = TargetSearch::Ptr(new TargetSearch);
+            target_search_->setInputCloud(target_cloud->getPointCloud());
+            target_index_ = DescriptorIndex::Ptr(new DescriptorIndex);
+            target_index_->setInputTarget(target_cloud->getLocalFeatures());
+            setTarget(sac_ia_);
         }
 
         //将给定的云添加到模板云列表中
         void
-        addTemplateCloud(FeatureCloud &template_cloud){
+        addTemplateCloud(const FeatureCloud::ConstPtr &template_cloud){
             templates_.push_back(template_cloud);
         }
 
         //将给定的模板云与setTargetCloud指定的目标对齐
         //对齐的核心代码
         void
-        align(FeatureCloud &template_cloud, TemplateAlignment::Result &result){
-            //设置输入原
-            sac_ia_.setInputSource(template_cloud.getPointCloud());
-            //设置特征元
-            sac_ia_.setSourceFeatures(template_cloud.getLocalFeatures());
-
-            pcl::PointCloud<pcl::PointXYZ> registration_output;
-            sac_ia_.align(registration_output);
-            //根据最远距离计算匹配分数
-            result.fitness_score = (float)sac_ia_.getFitnessScore(max_correspondence_distance_);
-            //获取最终转换矩阵
-            result.final_transformation = sac_ia_.getFinalTransformation();
+        align(const FeatureCloud &template_cloud, TemplateAlignment::Result &result){
+            align(sac_ia_, template_cloud, buildTable(template_cloud, 0), nr_iterations_, result);
         }
 
         //将addTemplateCloud设置的所有模板云与setTargetCloud()指定的目标对齐
         void
-        alignALL(std::vector<TemplateAlignment::Result, Eigen::aligned_allocator<Result>> &results){
-            results.resize(templates_.size());
+        alignALL(Results &results){
+            std::vector<int> all(templates_.size());
             for(size_t i = 0;i< templates_.size();++i){
-                align(templates_[i], results[i]);
+                all[i] = (int) i;
             }
+            std::vector<CorrespondenceTable::ConstPtr> tables(templates_.size());
+            results.resize(templates_.size());
+            alignTemplates(all, nr_iterations_, tables, results);
         }
 
         //将所有模板云对齐到目标云，以找到对齐得分最好的一个
+        //默认穷举。setCoarseToFine 打开由粗到精时：随机数每次都从同一个种子开始，粗选的迭代就是完整对齐的前几次，
+        //入选的模板重新完整对齐，结果与穷举时该模板的结果相同，但最佳模板不在粗选的前 top_k_ 个时答案会不同
         int
         findBestAlignment(TemplateAlignment::Result &result){
-            //Align all of the templates to the target cloud
-            //将所有模板对齐到目标云
-            std::vector<Result, Eigen::aligned_allocator<Result>> results;
-            alignALL(results);
+            const int nr_templates = (int) templates_.size();
+            Results results;
+            if(top_k_ <= 0 || top_k_ >= nr_templates || nr_coarse_iterations_ <= 0 ||
+               nr_coarse_iterations_ >= nr_iterations_){
+                //Align all of the templates to the target cloud
+                //将所有模板对齐到目标云
+                alignALL(results);
+            }else{
+                //粗选：所有模板只跑前几次迭代，对应点表留给精选复用
+                std::vector<int> order(nr_templates);
+                for(int i = 0;i< nr_templates;++i){
+                    order[i] = i;
+                }
+                std::vector<CorrespondenceTable::ConstPtr> tables(nr_templates);
+                Results coarse(nr_templates);
+                alignTemplates(order, nr_coarse_iterations_, tables, coarse);
+                std::stable_sort(order.begin(), order.end(), [&coarse](int a, int b){
+                    return coarse[a].fitness_score < coarse[b].fitness_score;
+                });
+                //精选：只完整对齐分数最好的 top_k_ 个，其余的分数记为无穷大
+                order.resize(top_k_);
+                Result unmatched;
+                unmatched.fitness_score = std::numeric_limits<float>::infinity();
+                unmatched.final_transformation = Eigen::Matrix4f::Identity();
+                results.assign(nr_templates, unmatched);
+                alignTemplates(order, nr_iterations_, tables, results);
+            }
 
             //Find the template with the best fitness score
-            //找到具有最佳健身分数的模板
+            //找到具有最佳健身分数的模板，分数相同时取下标小的，与穷举时一致
             float lowest_score = std::numeric_limits<float>::infinity();
             int best_template  = 0;
             for(size_t i = 0; i<results.size();++i){
@@ -213,15 +415,96 @@ class TemplateAlignment{
         }
 
     private:
+        void
+        configure(Registration &sac_ia) const{
+            sac_ia.setMinSampleDistance(min_sample_distance_);
+            sac_ia.setMaxCorrespondenceDistance(max_correspondence_distance_);
+            sac_ia.setMaximumIterations(nr_iterations_);
+            sac_ia.setCorrespondenceRandomness(nr_correspondences_);
+        }
+
+        //设置目标点云与量化描述子，使用共享的 kd-tree，不重新建树
+        void
+        setTarget(Registration &sac_ia) const{
+            sac_ia.setSearchMethodTarget(target_search_, true);
+            sac_ia.setInputTarget(target_->getPointCloud());
+            sac_ia.setTargetQuantizedFeatures(target_->getLocalFeatures());
+        }
+
+        //预先为模板的每个描述子查好目标中最近的 nr_correspondences_ 个，SAC-IA 迭代中只查表
+        CorrespondenceTable::ConstPtr
+        buildTable(const FeatureCloud &template_cloud, int nr_threads) const{
+            CorrespondenceTable::Ptr correspondences(new CorrespondenceTable);
+            buildCorrespondenceTable(*target_index_, *template_cloud.getLocalFeatures(), nr_correspondences_,
+                                     *correspondences, nr_threads);
+            return(correspondences);
+        }
+
+        /**
+         * 对齐 indices 中的模板，每个只跑 max_iterations 次迭代，结果写到 results[下标]；
+         * tables[下标] 为空时先建对应点表。每个线程一个 SAC-IA 对象，按模板动态分配，
+         * 随机数每个模板都从同一个种子开始，结果与串行时相同
+         */
+        void
+        alignTemplates(const std::vector<int> &indices, int max_iterations,
+                       std::vector<CorrespondenceTable::ConstPtr> &tables, Results &results){
+            const int threads = static_cast<int>(std::min<std::size_t>(getNumberOfThreads(nr_threads_), indices.size()));
+            if (threads <= 1) {
+                for (int i: indices) {
+                    if (!tables[i])
+                        tables[i] = buildTable(*templates_[i], 0);
+                    align(sac_ia_, *templates_[i], tables[i], max_iterations, results[i]);
+                }
+                return;
+            }
+            std::vector<Registration> workers(threads);
+            for (Registration &worker: workers) {
+                configure(worker);
+                setTarget(worker);
+            }
+            //模板之间已经并行，对应点表在各自的线程中单线程建立
+            parallelForDynamic(0, static_cast<int>(indices.size()), [&](int thread_id, int k) {
+                const int i = indices[k];
+                if (!tables[i])
+                    tables[i] = buildTable(*templates_[i], 1);
+                align(workers[thread_id], *templates_[i], tables[i], max_iterations, results[i]);
+            }, threads);
+        }
+
+        void
+        align(Registration &sac_ia, const FeatureCloud &template_cloud, const CorrespondenceTable::ConstPtr &table,
+              int max_iterations, TemplateAlignment::Result &result) const{
+            //设置输入原
+            sac_ia.setInputSource(template_cloud.getPointCloud());
+            //设置特征元
+            sac_ia.setSourceQuantizedFeatures(template_cloud.getLocalFeatures());
+            sac_ia.setCorrespondenceTable(table);
+            sac_ia.setMaximumIterations(max_iterations);
+
+            pcl::PointCloud<pcl::PointXYZ> registration_output;
+            sac_ia.align(registration_output);
+            //根据最远距离计算匹配分数
+            result.fitness_score = (float)sac_ia.getFitnessScore(max_correspondence_distance_);
+            //获取最终转换矩阵
+            result.final_transformation = sac_ia.getFinalTransformation();
+        }
+
         //A list of template clouds and the target to wich they will be aligned
-        std::vector<FeatureCloud> templates_;
-        FeatureCloud target_;
+        //模板与目标只保存句柄，不复制点云与特征
+        std::vector<FeatureCloud::ConstPtr> templates_;
+        FeatureCloud::ConstPtr target_;
+        DescriptorIndex::Ptr target_index_;//目标描述子的近似最近邻索引
+        TargetSearch::Ptr target_search_;//目标点云的 kd-tree
 
         //样本一致性初始对准(SAC-IA)配准程序及其参数
-        pcl::SampleConsensusInitialAlignment<pcl::PointXYZ, pcl::PointXYZ, pcl::FPFHSignature33> sac_ia_;
+        Registration sac_ia_;
         float min_sample_distance_;
         float max_correspondence_distance_;
         int nr_iterations_;
+        int nr_correspondences_;//每个模板点的候选对应点数
+        int nr_threads_;
+        int nr_coarse_iterations_;//粗选时每个模板的迭代次数
+        int top_k_;//完整对齐的模板数
 };
 
 /**
@@ -244,7 +527,7 @@ int main(int argc, char** argv){
     }
 
     //Load the object templates specified in the object_templates.txt file
-    std::vector<FeatureCloud> object_templates;
+    std::vector<FeatureCloud::ConstPtr> object_templates;
     std::ifstream input_stream(argv[1]);//object_templates.txt
     object_templates.reserve(0);
     std::string pcd_filename;
@@ -255,9 +538,12 @@ int main(int argc, char** argv){
             continue;
 
         //注意，该对象为自定义的点云配对操作对象。
-        FeatureCloud template_cloud;
-        template_cloud.loadInputCloud(pcd_filename);//加载object_templates中的点云数据
-        object_templates.push_back(template_cloud);//依次讲加载的点云存放到vector变量中
+        //只读入点云(或特征缓存)，法线与特征在对齐时按需计算，多个模板在不同线程中同时计算，
+        //模板之间已经并行，每个模板的计算阶段只用一个线程
+        FeatureCloud::Ptr template_cloud(new FeatureCloud);
+        template_cloud->setNumberOfThreads(1);
+        template_cloud->loadInputCloud(pcd_filename);//加载object_templates中的点云数据
+        object_templates.push_back(template_cloud);//依次讲加载的点云存放到vector变量中(只复制句柄)
     }
     input_stream.close();//pcd文件加载完成，进入下一步操作
 
@@ -287,13 +573,13 @@ int main(int argc, char** argv){
     std::cout<<"pass_through_voxel.pcd saved"<<std::endl;
 
     //Assign to the target FeatureCloud 对齐到目标特征点云
-    FeatureCloud target_cloud;
-    target_cloud.setInputCloud(cloud);
+    FeatureCloud::Ptr target_cloud(new FeatureCloud);
+    target_cloud->setInputCloud(cloud);
 
     //Set the TemplateAlignment inputs 设置对齐输入
     TemplateAlignment template_align;
     for(size_t i=0;i < object_templates.size();i++){
-        FeatureCloud &object_template = object_templates[i];
+        const FeatureCloud::ConstPtr &object_template = object_templates[i];
         //添加模板点云
         template_align.addTemplateCloud(object_template);
     }
@@ -305,7 +591,7 @@ int main(int argc, char** argv){
     //核心代码
     TemplateAlignment::Result best_alignment;
     int best_index = template_align.findBestAlignment(best_alignment);
-    const FeatureCloud &best_template = object_templates[best_index];
+    const FeatureCloud &best_template = *object_templates[best_index];
 
     //Print the alignment fitness score(values less than 0.00002 are good)
     printf("Best fitness score: %f\n", best_alignment.fitness_score);
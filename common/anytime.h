@@ -0,0 +1,91 @@
+/*
+ * 时间预算与取消：给 RANSAC / 配准设定截止时间或取消标志，到时返回目前最好的结果并给出状态
+ */
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <limits>
+
+enum AnytimeStatus {
+    ANYTIME_CONVERGED,          //正常结束(达到自适应迭代上限、收敛或搜索完成)
+    ANYTIME_MAX_ITERATIONS,     //达到迭代次数上限
+    ANYTIME_DEADLINE,           //到达截止时间，结果为目前最好的
+    ANYTIME_CANCELLED,          //被取消，结果为目前最好的
+    ANYTIME_FAILED              //没有得到任何结果
+};
+
+inline const char *
+anytimeStatusName(AnytimeStatus status) {
+    switch (status) {
+        case ANYTIME_CONVERGED:
+            return "converged";
+        case ANYTIME_MAX_ITERATIONS:
+            return "max iterations";
+        case ANYTIME_DEADLINE:
+            return "deadline";
+        case ANYTIME_CANCELLED:
+            return "cancelled";
+        default:
+            return "failed";
+    }
+}
+
+class AnytimeBudget {
+public:
+    typedef std::chrono::steady_clock Clock;
+
+    //默认没有限制
+    AnytimeBudget() : deadline_(Clock::time_point::max()), cancel_(nullptr) {}
+
+    //从现在起 milliseconds 毫秒后截止
+    static AnytimeBudget
+    fromNow(double milliseconds) {
+        AnytimeBudget budget;
+        budget.setTimeLimit(milliseconds);
+        return budget;
+    }
+
+    void
+    setTimeLimit(double milliseconds) {
+        deadline_ = Clock::now() + std::chrono::duration_cast<Clock::duration>(
+                std::chrono::duration<double, std::milli>(milliseconds));
+    }
+
+    void setDeadline(Clock::time_point deadline) { deadline_ = deadline; }
+
+    //由其它线程置为 true 时尽快停止
+    void setCancelFlag(const std::atomic<bool> *cancel) { cancel_ = cancel; }
+
+    bool
+    unlimited() const {
+        return deadline_ == Clock::time_point::max() && cancel_ == nullptr;
+    }
+
+    //是否应该停止，reason 返回 ANYTIME_CANCELLED 或 ANYTIME_DEADLINE
+    bool
+    stopRequested(AnytimeStatus *reason = nullptr) const {
+        if (cancel_ && cancel_->load(std::memory_order_relaxed)) {
+            if (reason)
+                *reason = ANYTIME_CANCELLED;
+            return true;
+        }
+        if (deadline_ != Clock::time_point::max() && Clock::now() >= deadline_) {
+            if (reason)
+                *reason = ANYTIME_DEADLINE;
+            return true;
+        }
+        return false;
+    }
+
+    double
+    remainingMilliseconds() const {
+        if (deadline_ == Clock::time_point::max())
+            return std::numeric_limits<double>::infinity();
+        return std::chrono::duration<double, std::milli>(deadline_ - Clock::now()).count();
+    }
+
+protected:
+    Clock::time_point deadline_;
+    const std::atomic<bool> *cancel_;
+};
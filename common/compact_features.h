@@ -0,0 +1,259 @@
+/*
+ * 紧凑的法线与特征描述子存储
+ *   - PackedNormal：八面体编码的单位法线，两个 16 位定点数共 32 位(pcl::Normal 为 32 字节)，误差小于 1e-3 弧度，
+ *     不保存曲率；
+ *   - QuantizedHistogram<N, T>：量化为 uint8/uint16 的直方图描述子。PCL 的 FPFH 每个子直方图、PFH 整个直方图
+ *     的和都是 100，每个分量都在 [0, 100] 内，按 T 的最大值/100 缩放后取整。FPFHSignature33U8 为 33 字节
+ *     (FPFHSignature33 为 132 字节)。PFH 的 125 个分量共享 100，单个分量通常不到 1，uint8 的步长 0.39 会丢掉大部分
+ *     信息，所以只提供 PFHSignature125U16(250 字节，PFHSignature125 为 500 字节)；
+ *   - computeQuantizedFeatures：按索引分块调用 PCL 的特征估计，每块算完立即量化，浮点描述子只占一块的内存；
+ *   - histogramSAD / QuantizedFeatureMatcher：直接在量化后的直方图上用 L1 距离(绝对差之和)做最近邻匹配，不解码，
+ *     uint8 用 SSE2 的 psadbw 每条指令处理 16 个分量。
+ */
+#pragma once
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstdlib>
+#include <limits>
+#include <numeric>
+#include <utility>
+#include <vector>
+
+#include <boost/shared_ptr.hpp>
+
+#include <pcl/point_cloud.h>
+#include <pcl/point_types.h>
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+struct PackedNormal {
+    std::uint32_t data;
+};
+
+//两个分量都为 -32768 表示无效法线(编码时分量只取 [-32767, 32767])
+static const std::uint32_t kInvalidPackedNormal = 0x80008000u;
+
+inline PackedNormal
+packNormal(float nx, float ny, float nz) {
+    PackedNormal packed;
+    const float l1 = std::abs(nx) + std::abs(ny) + std::abs(nz);
+    if (!std::isfinite(l1) || l1 == 0.0f) {
+        packed.data = kInvalidPackedNormal;
+        return packed;
+    }
+    //投影到八面体 |u|+|v|+|w|=1，下半球沿对角线折到上半球外侧
+    float u = nx / l1, v = ny / l1;
+    if (nz < 0.0f) {
+        const float fu = (1.0f - std::abs(v)) * (u >= 0.0f ? 1.0f : -1.0f);
+        const float fv = (1.0f - std::abs(u)) * (v >= 0.0f ? 1.0f : -1.0f);
+        u = fu;
+        v = fv;
+    }
+    const int qu = static_cast<int>(std::lround(std::max(-1.0f, std::min(1.0f, u)) * 32767.0f));
+    const int qv = static_cast<int>(std::lround(std::max(-1.0f, std::min(1.0f, v)) * 32767.0f));
+    packed.data = static_cast<std::uint32_t>(static_cast<std::uint16_t>(qu)) |
+                  (static_cast<std::uint32_t>(static_cast<std::uint16_t>(qv)) << 16);
+    return packed;
+}
+
+//无效法线返回 false，分量为 NaN
+inline bool
+unpackNormal(PackedNormal packed, float &nx, float &ny, float &nz) {
+    if (packed.data == kInvalidPackedNormal) {
+        nx = ny = nz = std::numeric_limits<float>::quiet_NaN();
+        return false;
+    }
+    const float u = static_cast<float>(static_cast<std::int16_t>(packed.data & 0xffffu)) * (1.0f / 32767.0f);
+    const float v = static_cast<float>(static_cast<std::int16_t>(packed.data >> 16)) * (1.0f / 32767.0f);
+    float x = u, y = v;
+    const float z = 1.0f - std::abs(u) - std::abs(v);
+    if (z < 0.0f) {
+        x = (1.0f - std::abs(v)) * (u >= 0.0f ? 1.0f : -1.0f);
+        y = (1.0f - std::abs(u)) * (v >= 0.0f ? 1.0f : -1.0f);
+    }
+    const float inv = 1.0f / std::sqrt(x * x + y * y + z * z);
+    nx = x * inv;
+    ny = y * inv;
+    nz = z * inv;
+    return true;
+}
+
+template<typename NormalT>
+void
+packNormals(const pcl::PointCloud<NormalT> &normals, std::vector<PackedNormal> &packed) {
+    packed.resize(normals.points.size());
+    for (std::size_t i = 0; i < normals.points.size(); ++i)
+        packed[i] = packNormal(normals.points[i].normal_x, normals.points[i].normal_y, normals.points[i].normal_z);
+}
+
+//解码到 pcl::Normal，曲率置 0
+inline void
+unpackNormals(const std::vector<PackedNormal> &packed, pcl::PointCloud<pcl::Normal> &normals) {
+    normals.points.resize(packed.size());
+    normals.width = static_cast<std::uint32_t>(packed.size());
+    normals.height = 1;
+    normals.is_dense = true;
+    for (std::size_t i = 0; i < packed.size(); ++i) {
+        pcl::Normal &normal = normals.points[i];
+        if (!unpackNormal(packed[i], normal.normal_x, normal.normal_y, normal.normal_z))
+            normals.is_dense = false;
+        normal.curvature = 0.0f;
+    }
+}
+
+template<int N, typename T>
+struct QuantizedHistogram {
+    static const int kBins = N;
+    //量化前的 100 对应的整数值
+    static constexpr float kScale = static_cast<float>(std::numeric_limits<T>::max()) / 100.0f;
+    T histogram[N];
+};
+
+typedef QuantizedHistogram<33, std::uint8_t> FPFHSignature33U8;
+typedef QuantizedHistogram<33, std::uint16_t> FPFHSignature33U16;
+typedef QuantizedHistogram<125, std::uint16_t> PFHSignature125U16;
+
+template<int N, typename T>
+void
+quantizeHistogram(const float *histogram, QuantizedHistogram<N, T> &quantized) {
+    typedef QuantizedHistogram<N, T> Q;
+    const float max_value = static_cast<float>(std::numeric_limits<T>::max());
+    for (int k = 0; k < N; ++k) {
+        //NaN 与负值按 0 处理
+        const float value = histogram[k] * Q::kScale + 0.5f;
+        quantized.histogram[k] = static_cast<T>(value > 0.0f ? std::min(value, max_value) : 0.0f);
+    }
+}
+
+//反量化，只用于显示与调试，匹配不需要
+template<int N, typename T>
+float
+dequantizeBin(const QuantizedHistogram<N, T> &quantized, int bin) {
+    return static_cast<float>(quantized.histogram[bin]) / QuantizedHistogram<N, T>::kScale;
+}
+
+//两个直方图的 L1 距离(绝对差之和)
+inline std::uint32_t
+histogramSAD(const std::uint8_t *a, const std::uint8_t *b, int n) {
+    std::uint32_t sum = 0;
+    int k = 0;
+#if defined(__SSE2__)
+    __m128i acc = _mm_setzero_si128();
+    for (; k + 16 <= n; k += 16)
+        acc = _mm_add_epi64(acc, _mm_sad_epu8(_mm_loadu_si128(reinterpret_cast<const __m128i *>(a + k)),
+                                              _mm_loadu_si128(reinterpret_cast<const __m128i *>(b + k))));
+    sum = static_cast<std::uint32_t>(_mm_cvtsi128_si32(acc) + _mm_cvtsi128_si32(_mm_srli_si128(acc, 8)));
+#endif
+    for (; k < n; ++k)
+        sum += static_cast<std::uint32_t>(std::abs(static_cast<int>(a[k]) - static_cast<int>(b[k])));
+    return sum;
+}
+
+inline std::uint32_t
+histogramSAD(const std::uint16_t *a, const std::uint16_t *b, int n) {
+    std::uint32_t sum = 0;
+    int k = 0;
+#if defined(__SSE2__)
+    //|a-b| = (a -饱和 b) | (b -饱和 a)，再扩展成 32 位累加
+    const __m128i zero = _mm_setzero_si128();
+    __m128i acc = _mm_setzero_si128();
+    for (; k + 8 <= n; k += 8) {
+        const __m128i va = _mm_loadu_si128(reinterpret_cast<const __m128i *>(a + k));
+        const __m128i vb = _mm_loadu_si128(reinterpret_cast<const __m128i *>(b + k));
+        const __m128i diff = _mm_or_si128(_mm_subs_epu16(va, vb), _mm_subs_epu16(vb, va));
+        acc = _mm_add_epi32(acc, _mm_add_epi32(_mm_unpacklo_epi16(diff, zero), _mm_unpackhi_epi16(diff, zero)));
+    }
+    std::uint32_t lanes[4];
+    _mm_storeu_si128(reinterpret_cast<__m128i *>(lanes), acc);
+    sum = lanes[0] + lanes[1] + lanes[2] + lanes[3];
+#endif
+    for (; k < n; ++k)
+        sum += static_cast<std::uint32_t>(std::abs(static_cast<int>(a[k]) - static_cast<int>(b[k])));
+    return sum;
+}
+
+template<int N, typename T>
+std::uint32_t
+histogramSAD(const QuantizedHistogram<N, T> &a, const QuantizedHistogram<N, T> &b) {
+    return histogramSAD(a.histogram, b.histogram, N);
+}
+
+/**
+ * 用 PCL 的特征估计(FPFHEstimation、FPFHEstimationOMP、PFHEstimation 等)计算输入点云全部点的量化描述子。
+ * estimator 须已设置输入点云、法线、搜索方法与半径；它的 indices 会被改写。
+ * 每次只计算 block_size 个点的浮点描述子。FPFH 每块都要重算块内点的邻居的 SPFH，
+ * 点云按空间顺序排列(如体素滤波的输出)时块间重复的部分很少。
+ */
+template<typename EstimatorT, int N, typename T>
+void
+computeQuantizedFeatures(EstimatorT &estimator, std::vector<QuantizedHistogram<N, T> > &output,
+                         int block_size = 65536) {
+    typedef typename EstimatorT::PointCloudOut FloatFeatures;
+    const int n = static_cast<int>(estimator.getInputCloud()->points.size());
+    output.resize(n);
+    FloatFeatures block;
+    for (int begin = 0; begin < n; begin += block_size) {
+        const int end = std::min(n, begin + block_size);
+        boost::shared_ptr<std::vector<int> > indices(new std::vector<int>(end - begin));
+        std::iota(indices->begin(), indices->end(), begin);
+        estimator.setIndices(indices);
+        estimator.compute(block);
+        for (int i = begin; i < end; ++i)
+            quantizeHistogram(block.points[i - begin].histogram, output[i]);
+    }
+}
+
+/**
+ * 量化描述子的 k 近邻(L1 距离)。逐个比较目标的全部描述子，uint8 时每次比较只需几条 psadbw 指令；
+ * 查询是只读的，可以在多个线程中同时进行。
+ */
+template<typename QuantizedT>
+class QuantizedFeatureMatcher {
+public:
+    typedef boost::shared_ptr<QuantizedFeatureMatcher<QuantizedT> > Ptr;
+    typedef boost::shared_ptr<const std::vector<QuantizedT> > FeaturesConstPtr;
+
+    void setInputTarget(const FeaturesConstPtr &target) { target_ = target; }
+
+    FeaturesConstPtr getInputTarget() const { return target_; }
+
+    //按距离从小到大返回 k 个最近的目标描述子
+    int
+    nearestKSearch(const QuantizedT &query, int k, std::vector<int> &indices, std::vector<std::uint32_t> &distances) const {
+        indices.clear();
+        distances.clear();
+        if (!target_ || k <= 0)
+            return 0;
+        const int n = static_cast<int>(target_->size());
+        k = std::min(k, n);
+        //大顶堆保存当前最近的 k 个
+        std::vector<std::pair<std::uint32_t, int> > heap;
+        heap.reserve(k);
+        for (int i = 0; i < n; ++i) {
+            const std::uint32_t distance = histogramSAD(query, (*target_)[i]);
+            if (static_cast<int>(heap.size()) < k) {
+                heap.emplace_back(distance, i);
+                std::push_heap(heap.begin(), heap.end());
+            } else if (distance < heap.front().first) {
+                std::pop_heap(heap.begin(), heap.end());
+                heap.back() = std::make_pair(distance, i);
+                std::push_heap(heap.begin(), heap.end());
+            }
+        }
+        std::sort_heap(heap.begin(), heap.end());
+        indices.resize(heap.size());
+        distances.resize(heap.size());
+        for (std::size_t i = 0; i < heap.size(); ++i) {
+            distances[i] = heap[i].first;
+            indices[i] = heap[i].second;
+        }
+        return static_cast<int>(heap.size());
+    }
+
+private:
+    FeaturesConstPtr target_;
+};
@@ -0,0 +1,327 @@
+/*
+ * 描述子空间的近似最近邻索引与对应点表
+ *   - HNSWDescriptorIndex：量化直方图(compact_features.h)上按 L1 距离建立的 HNSW 图(分层可导航小世界图)。
+ *     每个目标点云建一次，查询只读，可以在多个线程中同时进行；接口与 QuantizedFeatureMatcher 相同。
+ *     建图时先逐个插入，图有一定规模后按批插入：一批中的点在多个线程上同时查询当前的图得到候选邻居，
+ *     再按顺序串行连边，结果与线程数无关；
+ *   - CorrespondenceTable / buildCorrespondenceTable：对源点云的每个描述子预先查好目标中最近的 k 个，
+ *     SampleConsensusPrerejectiveAnytime 与 SampleConsensusInitialAlignmentQuantized 的每次迭代只需查表。
+ */
+#pragma once
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <functional>
+#include <queue>
+#include <random>
+#include <utility>
+#include <vector>
+
+#include <boost/shared_ptr.hpp>
+
+#include "compact_features.h"
+#include "parallel.h"
+
+/**
+ * 每个源描述子在目标中最近的(至多) k 个描述子，按距离从小到大。
+ * 第 i 行为 indices[i*k, i*k + counts[i])。
+ */
+struct CorrespondenceTable {
+    typedef boost::shared_ptr<CorrespondenceTable> Ptr;
+    typedef boost::shared_ptr<const CorrespondenceTable> ConstPtr;
+
+    CorrespondenceTable() : k(0), target_size(0) {}
+
+    std::size_t size() const { return counts.size(); }
+
+    const int *row(std::size_t i) const { return indices.data() + i * k; }
+
+    const std::uint32_t *rowDistances(std::size_t i) const { return distances.data() + i * k; }
+
+    int k;
+    std::size_t target_size;
+    std::vector<int> counts;
+    std::vector<int> indices;
+    std::vector<std::uint32_t> distances;
+};
+
+/**
+ * 用 index(HNSWDescriptorIndex 或 QuantizedFeatureMatcher)为 source 的每个描述子查询最近的 k 个，多线程。
+ */
+template<typename IndexT, typename QuantizedT>
+void
+buildCorrespondenceTable(const IndexT &index, const std::vector<QuantizedT> &source, int k,
+                         CorrespondenceTable &table, int nr_threads = 0) {
+    const int n = static_cast<int>(source.size());
+    table.k = k;
+    table.target_size = index.getInputTarget() ? index.getInputTarget()->size() : 0;
+    table.counts.assign(n, 0);
+    table.indices.assign(static_cast<std::size_t>(n) * k, -1);
+    table.distances.assign(static_cast<std::size_t>(n) * k, 0);
+    parallelForChunks(0, n, [&](int, int begin, int end) {
+        std::vector<int> indices;
+        std::vector<std::uint32_t> distances;
+        for (int i = begin; i < end; ++i) {
+            const int found = index.nearestKSearch(source[i], k, indices, distances);
+            table.counts[i] = found;
+            std::copy(indices.begin(), indices.begin() + found, table.indices.begin() + static_cast<std::size_t>(i) * k);
+            std::copy(distances.begin(), distances.begin() + found,
+                      table.distances.begin() + static_cast<std::size_t>(i) * k);
+        }
+    }, nr_threads);
+}
+
+template<typename QuantizedT>
+class HNSWDescriptorIndex {
+public:
+    typedef boost::shared_ptr<HNSWDescriptorIndex<QuantizedT> > Ptr;
+    typedef boost::shared_ptr<const HNSWDescriptorIndex<QuantizedT> > ConstPtr;
+    typedef boost::shared_ptr<const std::vector<QuantizedT> > FeaturesConstPtr;
+
+    HNSWDescriptorIndex()
+            : max_connections_(16), ef_construction_(64), ef_search_(64), nr_threads_(0), seed_(42),
+              entry_point_(-1), max_level_(-1) {}
+
+    //每层每个点的邻居数 M(第 0 层为 2M)，须在 setInputTarget 之前设置
+    void setMaxConnections(int m) { max_connections_ = m; }
+
+    //建图时每个点的候选邻居数
+    void setEfConstruction(int ef) { ef_construction_ = ef; }
+
+    //查询时的候选数，越大越接近精确结果，不小于 k
+    void setEfSearch(int ef) { ef_search_ = ef; }
+
+    //建图的线程数，0 表示使用全部硬件线程
+    void setNumberOfThreads(int nr_threads) { nr_threads_ = nr_threads; }
+
+    //各点层数的随机种子
+    void setSeed(unsigned int seed) { seed_ = seed; }
+
+    //设置目标描述子并建图
+    void
+    setInputTarget(const FeaturesConstPtr &target) {
+        target_ = target;
+        build();
+    }
+
+    FeaturesConstPtr getInputTarget() const { return target_; }
+
+    //按 (距离, 下标) 从小到大返回 k 个近似最近的目标描述子
+    int
+    nearestKSearch(const QuantizedT &query, int k, std::vector<int> &indices, std::vector<std::uint32_t> &distances) const {
+        indices.clear();
+        distances.clear();
+        if (entry_point_ < 0 || k <= 0)
+            return 0;
+        std::vector<Candidate> entry(1, Candidate(distance(query, entry_point_), entry_point_));
+        for (int level = max_level_; level > 0; --level)
+            searchLayer(query, entry, 1, level);
+        searchLayer(query, entry, std::max(ef_search_, k), 0);
+        const int found = std::min<int>(k, static_cast<int>(entry.size()));
+        indices.resize(found);
+        distances.resize(found);
+        for (int i = 0; i < found; ++i) {
+            distances[i] = entry[i].first;
+            indices[i] = entry[i].second;
+        }
+        return found;
+    }
+
+protected:
+    //(距离, 下标)，按字典序比较，距离相同时结果也是确定的
+    typedef std::pair<std::uint32_t, int> Candidate;
+
+    //查询时标记已访问的点：每次查询换一个标记值，不用清零
+    struct Visited {
+        Visited() : mark(0) {}
+
+        std::vector<std::uint32_t> marks;
+        std::uint32_t mark;
+    };
+
+    std::uint32_t
+    distance(const QuantizedT &query, int node) const { return histogramSAD(query, (*target_)[node]); }
+
+    std::uint32_t
+    distance(int a, int b) const { return histogramSAD((*target_)[a], (*target_)[b]); }
+
+    //第 level 层的邻接表：[个数, 邻居...]
+    int *
+    links(int node, int level) {
+        return level == 0 ? &level0_[static_cast<std::size_t>(node) * (2 * max_connections_ + 1)]
+                          : &upper_[upper_offsets_[node] + static_cast<std::size_t>(level - 1) * (max_connections_ + 1)];
+    }
+
+    const int *
+    links(int node, int level) const { return const_cast<HNSWDescriptorIndex *>(this)->links(node, level); }
+
+    int capacity(int level) const { return level == 0 ? 2 * max_connections_ : max_connections_; }
+
+    /**
+     * 从 entry 出发在第 level 层贪心扩展，保留最近的 ef 个；结果按 (距离, 下标) 升序写回 entry。
+     */
+    void
+    searchLayer(const QuantizedT &query, std::vector<Candidate> &entry, int ef, int level) const {
+        static thread_local Visited visited;
+        if (visited.marks.size() < target_->size())
+            visited.marks.assign(target_->size(), 0);
+        if (++visited.mark == 0) {
+            std::fill(visited.marks.begin(), visited.marks.end(), 0);
+            visited.mark = 1;
+        }
+        std::priority_queue<Candidate, std::vector<Candidate>, std::greater<Candidate> > candidates;
+        std::priority_queue<Candidate> results;
+        for (const Candidate &c: entry) {
+            visited.marks[c.second] = visited.mark;
+            candidates.push(c);
+            results.push(c);
+        }
+        while (static_cast<int>(results.size()) > ef)
+            results.pop();
+        while (!candidates.empty()) {
+            const Candidate c = candidates.top();
+            if (static_cast<int>(results.size()) >= ef && c > results.top())
+                break;
+            candidates.pop();
+            const int *neighbors = links(c.second, level);
+            for (int j = 1; j <= neighbors[0]; ++j) {
+                const int e = neighbors[j];
+                if (visited.marks[e] == visited.mark)
+                    continue;
+                visited.marks[e] = visited.mark;
+                const Candidate candidate(distance(query, e), e);
+                if (static_cast<int>(results.size()) < ef || candidate < results.top()) {
+                    candidates.push(candidate);
+                    results.push(candidate);
+                    if (static_cast<int>(results.size()) > ef)
+                        results.pop();
+                }
+            }
+        }
+        entry.resize(results.size());
+        for (std::size_t i = results.size(); i > 0; --i) {
+            entry[i - 1] = results.top();
+            results.pop();
+        }
+    }
+
+    /**
+     * HNSW 的启发式选邻居：按距离从近到远，只保留比已选的邻居都更靠近中心点的候选，
+     * 量化后相同的描述子(距离为 0)只连一个。candidates 须已升序。
+     */
+    void
+    selectNeighbors(const std::vector<Candidate> &candidates, int m, std::vector<int> &selected) const {
+        selected.clear();
+        for (const Candidate &c: candidates) {
+            if (static_cast<int>(selected.size()) >= m)
+                break;
+            bool keep = true;
+            for (int s: selected) {
+                //与中心点重合(c.first 为 0)的候选之间距离也为 0，用 < 判断不掉，单独排除
+                const auto d = distance(c.second, s);
+                if (d < c.first || d == 0) {
+                    keep = false;
+                    break;
+                }
+            }
+            if (keep)
+                selected.push_back(c.second);
+        }
+    }
+
+    //q 连接到选出的邻居，并给邻居加上反向边；邻居的边超出容量时按同样的启发式重选
+    void
+    connect(int q, int level, const std::vector<Candidate> &candidates) {
+        std::vector<int> selected;
+        selectNeighbors(candidates, max_connections_, selected);
+        int *own = links(q, level);
+        own[0] = static_cast<int>(selected.size());
+        std::copy(selected.begin(), selected.end(), own + 1);
+        std::vector<Candidate> pool;
+        std::vector<int> kept;
+        for (int e: selected) {
+            int *other = links(e, level);
+            if (other[0] < capacity(level)) {
+                other[++other[0]] = q;
+                continue;
+            }
+            pool.clear();
+            pool.push_back(Candidate(distance(e, q), q));
+            for (int j = 1; j <= other[0]; ++j)
+                pool.push_back(Candidate(distance(e, other[j]), other[j]));
+            std::sort(pool.begin(), pool.end());
+            selectNeighbors(pool, capacity(level), kept);
+            other[0] = static_cast<int>(kept.size());
+            std::copy(kept.begin(), kept.end(), other + 1);
+        }
+    }
+
+    void
+    build() {
+        const int n = target_ ? static_cast<int>(target_->size()) : 0;
+        entry_point_ = -1;
+        max_level_ = -1;
+        //层数服从几何分布，P(level >= l) = M^-l
+        std::mt19937 rng(seed_);
+        std::uniform_real_distribution<double> uniform(0.0, 1.0);
+        const double multiplier = 1.0 / std::log(static_cast<double>(std::max(2, max_connections_)));
+        levels_.resize(n);
+        upper_offsets_.assign(n + 1, 0);
+        for (int i = 0; i < n; ++i) {
+            levels_[i] = std::min(16, static_cast<int>(-std::log(1.0 - uniform(rng)) * multiplier));
+            upper_offsets_[i + 1] = upper_offsets_[i] + static_cast<std::size_t>(levels_[i]) * (max_connections_ + 1);
+        }
+        level0_.assign(static_cast<std::size_t>(n) * (2 * max_connections_ + 1), 0);
+        upper_.assign(upper_offsets_[n], 0);
+
+        //前 kSerial 个点逐个插入，之后每批为已插入点数的 1/16
+        const int kSerial = 1024;
+        std::vector<std::vector<std::vector<Candidate> > > candidates;
+        for (int inserted = 0; inserted < n;) {
+            const int batch = inserted < kSerial ? 1 : std::min(n - inserted, std::max(64, inserted / 16));
+            candidates.assign(batch, std::vector<std::vector<Candidate> >());
+            //查询当前的图，各点互不影响
+            parallelFor(0, batch, [&](int b) {
+                const int q = inserted + b;
+                if (entry_point_ < 0)
+                    return;
+                const QuantizedT &query = (*target_)[q];
+                std::vector<Candidate> entry(1, Candidate(distance(query, entry_point_), entry_point_));
+                for (int level = max_level_; level > levels_[q]; --level)
+                    searchLayer(query, entry, 1, level);
+                const int top = std::min(max_level_, levels_[q]);
+                candidates[b].resize(top + 1);
+                for (int level = top; level >= 0; --level) {
+                    searchLayer(query, entry, ef_construction_, level);
+                    candidates[b][level] = entry;
+                }
+            }, batch > 1 ? nr_threads_ : 1);
+            //按顺序连边
+            for (int b = 0; b < batch; ++b) {
+                const int q = inserted + b;
+                for (int level = static_cast<int>(candidates[b].size()) - 1; level >= 0; --level)
+                    connect(q, level, candidates[b][level]);
+                if (levels_[q] > max_level_) {
+                    max_level_ = levels_[q];
+                    entry_point_ = q;
+                }
+            }
+            inserted += batch;
+        }
+    }
+
+    FeaturesConstPtr target_;
+    int max_connections_;
+    int ef_construction_;
+    int ef_search_;
+    int nr_threads_;
+    unsigned int seed_;
+    int entry_point_;
+    int max_level_;
+    std::vector<int> levels_;
+    //第 0 层每个点 2M+1 个整数，第 1 层及以上每层 M+1 个，按点连续存放
+    std::vector<int> level0_;
+    std::vector<std::size_t> upper_offsets_;
+    std::vector<int> upper_;
+};
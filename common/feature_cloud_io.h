@@ -0,0 +1,275 @@
+/*
+ * 预先计算好的特征点云的二进制文件
+ * 128 字节文件头 + 点坐标(每点 3 个 float) + 32 位编码的法线(PackedNormal) + 量化描述子(QuantizedHistogram)，
+ * 各段按 64 字节对齐，读取时直接 mmap，不经过中间缓冲。
+ * 文件头记录计算参数(法线半径、特征半径、体素大小)、描述子类型、源文件的大小与修改时间，
+ * 以及数据段的哈希，参数或源文件变化、文件损坏时都不会被误用。
+ * 只按本机字节序读写，不在不同字节序的机器之间交换。
+ */
+#pragma once
+
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include <vector>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <pcl/point_cloud.h>
+#include <pcl/point_types.h>
+
+#include "compact_features.h"
+
+//计算特征时使用的参数，读取时逐项比较
+struct FeatureCloudParameters {
+    float normal_radius;
+    float feature_radius;
+    float leaf_size;                //0 表示没有降采样
+};
+
+//源文件(如 PCD)的大小与修改时间，用来判断缓存是否过期
+struct FeatureCloudSourceStamp {
+    std::uint64_t size;
+    std::int64_t mtime_ns;
+};
+
+struct FeatureCloudFileHeader {
+    char magic[8];                  //"FCLDRAW"
+    std::uint32_t version;
+    std::uint32_t nr_points;
+    std::uint32_t feature_bins;     //直方图分量数
+    std::uint32_t feature_size;     //每个描述子的字节数
+    FeatureCloudParameters parameters;
+    std::uint32_t reserved;
+    FeatureCloudSourceStamp source;
+    std::uint64_t points_offset, normals_offset, features_offset;
+    std::uint64_t content_hash;     //文件头之后全部字节的哈希
+};
+static_assert(sizeof(FeatureCloudFileHeader) <= 128, "feature cloud header grew");
+
+namespace feature_cloud_io_detail {
+    const std::size_t kDataOffset = 128;
+    const std::size_t kAlignment = 64;
+    const char kMagic[8] = "FCLDRAW";
+
+    inline std::size_t
+    alignUp(std::size_t offset) { return (offset + kAlignment - 1) / kAlignment * kAlignment; }
+
+    //每次处理 8 字节的 FNV-1a 变体，只用于发现损坏与截断，不是密码学哈希
+    inline std::uint64_t
+    hashBytes(const char *data, std::size_t size) {
+        const std::uint64_t prime = 0x100000001b3ull;
+        std::uint64_t hash = 0xcbf29ce484222325ull ^ size;
+        std::size_t i = 0;
+        for (; i + 8 <= size; i += 8) {
+            std::uint64_t word;
+            std::memcpy(&word, data + i, 8);
+            hash = (hash ^ word) * prime;
+            hash ^= hash >> 29;
+        }
+        for (; i < size; ++i)
+            hash = (hash ^ static_cast<unsigned char>(data[i])) * prime;
+        return hash;
+    }
+
+    inline bool
+    sameParameters(const FeatureCloudParameters &a, const FeatureCloudParameters &b) {
+        return a.normal_radius == b.normal_radius && a.feature_radius == b.feature_radius && a.leaf_size == b.leaf_size;
+    }
+}
+
+//读取源文件的大小与修改时间
+inline bool
+getFeatureCloudSourceStamp(const std::string &filename, FeatureCloudSourceStamp &stamp) {
+    struct stat st;
+    if (::stat(filename.c_str(), &st) != 0)
+        return false;
+    stamp.size = static_cast<std::uint64_t>(st.st_size);
+    stamp.mtime_ns = static_cast<std::int64_t>(st.st_mtim.tv_sec) * 1000000000ll + st.st_mtim.tv_nsec;
+    return true;
+}
+
+/**
+ * 写入特征点云。先写到 filename.tmp 再改名，其他进程不会读到写了一半的文件。
+ */
+template<typename PointT, int N, typename T>
+bool
+saveFeatureCloud(const std::string &filename, const FeatureCloudParameters &parameters,
+                 const FeatureCloudSourceStamp &source, const pcl::PointCloud<PointT> &points,
+                 const std::vector<PackedNormal> &normals, const std::vector<QuantizedHistogram<N, T> > &features) {
+    using namespace feature_cloud_io_detail;
+    const std::size_t n = points.points.size();
+    if (normals.size() != n || features.size() != n)
+        return false;
+
+    FeatureCloudFileHeader header;
+    std::memset(&header, 0, sizeof(header));
+    std::memcpy(header.magic, kMagic, sizeof(kMagic));
+    header.version = 1;
+    header.nr_points = static_cast<std::uint32_t>(n);
+    header.feature_bins = N;
+    header.feature_size = sizeof(QuantizedHistogram<N, T>);
+    header.parameters = parameters;
+    header.source = source;
+    header.points_offset = kDataOffset;
+    header.normals_offset = alignUp(header.points_offset + n * 3 * sizeof(float));
+    header.features_offset = alignUp(header.normals_offset + n * sizeof(PackedNormal));
+
+    //文件不大，先在内存中拼好，哈希与写盘都只走一遍
+    std::vector<char> buffer(header.features_offset + n * header.feature_size, 0);
+    float *xyz = reinterpret_cast<float *>(&buffer[header.points_offset]);
+    for (std::size_t i = 0; i < n; ++i) {
+        xyz[3 * i] = points.points[i].x;
+        xyz[3 * i + 1] = points.points[i].y;
+        xyz[3 * i + 2] = points.points[i].z;
+    }
+    if (n > 0) {
+        std::memcpy(&buffer[header.normals_offset], normals.data(), n * sizeof(PackedNormal));
+        std::memcpy(&buffer[header.features_offset], features.data(), n * header.feature_size);
+    }
+    header.content_hash = hashBytes(buffer.data() + kDataOffset, buffer.size() - kDataOffset);
+    std::memcpy(buffer.data(), &header, sizeof(header));
+
+    const std::string temporary = filename + ".tmp";
+    FILE *file = std::fopen(temporary.c_str(), "wb");
+    if (file == nullptr)
+        return false;
+    const bool ok = std::fwrite(buffer.data(), 1, buffer.size(), file) == buffer.size();
+    if (std::fclose(file) != 0 || !ok || std::rename(temporary.c_str(), filename.c_str()) != 0) {
+        std::remove(temporary.c_str());
+        return false;
+    }
+    return true;
+}
+
+//特征点云文件的只读映射，points() / normals() / features() 直接指向文件内容
+class FeatureCloudFileView {
+public:
+    FeatureCloudFileView() : data_(nullptr), size_(0) {}
+
+    ~FeatureCloudFileView() {
+        close();
+    }
+
+    FeatureCloudFileView(const FeatureCloudFileView &) = delete;
+
+    FeatureCloudFileView &operator=(const FeatureCloudFileView &) = delete;
+
+    //verify_hash 为 true 时校验数据段的哈希，每 GB 约需 0.3 秒
+    bool
+    open(const std::string &filename, bool verify_hash = true) {
+        using namespace feature_cloud_io_detail;
+        close();
+        int fd = ::open(filename.c_str(), O_RDONLY);
+        if (fd < 0)
+            return false;
+        struct stat st;
+        if (fstat(fd, &st) == 0 && static_cast<std::size_t>(st.st_size) >= kDataOffset) {
+            void *data = mmap(nullptr, static_cast<std::size_t>(st.st_size), PROT_READ, MAP_PRIVATE, fd, 0);
+            if (data != MAP_FAILED) {
+                data_ = data;
+                size_ = static_cast<std::size_t>(st.st_size);
+            }
+        }
+        ::close(fd);
+        if (data_ == nullptr)
+            return false;
+        const FeatureCloudFileHeader &h = header();
+        const std::size_t n = h.nr_points;
+        const bool layout_valid =
+                std::memcmp(h.magic, kMagic, sizeof(h.magic)) == 0 && h.version == 1 &&
+                h.points_offset == kDataOffset &&
+                h.normals_offset >= h.points_offset + n * 3 * sizeof(float) &&
+                h.features_offset >= h.normals_offset + n * sizeof(PackedNormal) &&
+                size_ == h.features_offset + n * h.feature_size;
+        if (!layout_valid ||
+            (verify_hash && hashBytes(static_cast<const char *>(data_) + kDataOffset, size_ - kDataOffset) != h.content_hash)) {
+            close();
+            return false;
+        }
+        return true;
+    }
+
+    void
+    close() {
+        if (data_ != nullptr)
+            munmap(data_, size_);
+        data_ = nullptr;
+        size_ = 0;
+    }
+
+    bool
+    isOpen() const {
+        return data_ != nullptr;
+    }
+
+    const FeatureCloudFileHeader &
+    header() const {
+        return *static_cast<const FeatureCloudFileHeader *>(data_);
+    }
+
+    std::size_t
+    size() const {
+        return header().nr_points;
+    }
+
+    //描述子类型、计算参数与源文件都一致时才能直接使用
+    template<typename QuantizedT>
+    bool
+    matches(const FeatureCloudParameters &parameters, const FeatureCloudSourceStamp &source) const {
+        const FeatureCloudFileHeader &h = header();
+        return h.feature_bins == static_cast<std::uint32_t>(QuantizedT::kBins) &&
+               h.feature_size == sizeof(QuantizedT) &&
+               feature_cloud_io_detail::sameParameters(h.parameters, parameters) &&
+               h.source.size == source.size && h.source.mtime_ns == source.mtime_ns;
+    }
+
+    //每点 x, y, z 三个 float
+    const float *
+    points() const {
+        return reinterpret_cast<const float *>(bytes() + header().points_offset);
+    }
+
+    const PackedNormal *
+    normals() const {
+        return reinterpret_cast<const PackedNormal *>(bytes() + header().normals_offset);
+    }
+
+    template<typename QuantizedT>
+    const QuantizedT *
+    features() const {
+        return reinterpret_cast<const QuantizedT *>(bytes() + header().features_offset);
+    }
+
+    template<typename PointT>
+    void
+    copyPoints(pcl::PointCloud<PointT> &cloud) const {
+        const std::size_t n = size();
+        const float *xyz = points();
+        cloud.points.resize(n);
+        cloud.width = static_cast<std::uint32_t>(n);
+        cloud.height = 1;
+        cloud.is_dense = true;
+        for (std::size_t i = 0; i < n; ++i) {
+            cloud.points[i].x = xyz[3 * i];
+            cloud.points[i].y = xyz[3 * i + 1];
+            cloud.points[i].z = xyz[3 * i + 2];
+            if (!std::isfinite(xyz[3 * i]) || !std::isfinite(xyz[3 * i + 1]) || !std::isfinite(xyz[3 * i + 2]))
+                cloud.is_dense = false;
+        }
+    }
+
+private:
+    const char *
+    bytes() const {
+        return static_cast<const char *>(data_);
+    }
+
+    void *data_;
+    std::size_t size_;
+};
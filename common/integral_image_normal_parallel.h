@@ -0,0 +1,289 @@
+/*
+ * 多线程、分块的积分图法线估计
+ * IntegralImageNormalEstimationParallel 继承 pcl::IntegralImageNormalEstimation，用法相同。
+ * AVERAGE_3D_GRADIENT(默认的 BORDER_POLICY_IGNORE，不使用随深度变化的平滑窗口)时走这里的实现：
+ *   - 不生成整幅的 double 积分图。图像按行分成若干条带，由各个线程处理；
+ *     每条带再按列分块，块内加上窗口半径的边缘后现算左右/上下差分，建局部的 float 积分图，立即求出块内法线，数据一直在缓存里；
+ *   - 局部积分图只覆盖几十行几十列，前缀和的量级很小，float 累加的误差与 double 积分图相当；
+ *   - 深度跳变图与 chamfer 距离图也按条带计算，条带上下多算 smoothing 行，距离 ≤ smoothing 时与整幅计算的结果相同。
+ * 其它方法或设置交给 pcl::IntegralImageNormalEstimation。
+ */
+#pragma once
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <vector>
+
+#include <pcl/features/integral_image_normal.h>
+#include <pcl/point_cloud.h>
+#include <pcl/point_types.h>
+
+#include "parallel.h"
+
+template<typename PointInT, typename PointOutT>
+class IntegralImageNormalEstimationParallel : public pcl::IntegralImageNormalEstimation<PointInT, PointOutT> {
+public:
+    typedef pcl::IntegralImageNormalEstimation<PointInT, PointOutT> Base;
+    typedef typename Base::NormalEstimationMethod NormalEstimationMethod;
+    typedef typename Base::BorderPolicy BorderPolicy;
+    typedef typename Base::PointCloudOut PointCloudOut;
+    typedef typename pcl::PointCloud<PointInT>::ConstPtr PointCloudInConstPtr;
+
+    static const int kBandRows = 16;    //每条带的行数
+    static const int kTileCols = 64;    //每块的列数
+
+    IntegralImageNormalEstimationParallel()
+            : method_(Base::AVERAGE_3D_GRADIENT), border_policy_(Base::BORDER_POLICY_IGNORE),
+              max_depth_change_factor_(20.0f * 0.001f), normal_smoothing_size_(10.0f),
+              depth_dependent_smoothing_(false), nr_threads_(0) {}
+
+    //以下设置同时交给基类，回退到 PCL 实现时使用
+    void
+    setNormalEstimationMethod(NormalEstimationMethod method) {
+        Base::setNormalEstimationMethod(method);
+        method_ = method;
+    }
+
+    void
+    setBorderPolicy(BorderPolicy border_policy) {
+        Base::setBorderPolicy(border_policy);
+        border_policy_ = border_policy;
+    }
+
+    void
+    setMaxDepthChangeFactor(float max_depth_change_factor) {
+        Base::setMaxDepthChangeFactor(max_depth_change_factor);
+        max_depth_change_factor_ = max_depth_change_factor;
+    }
+
+    void
+    setNormalSmoothingSize(float normal_smoothing_size) {
+        Base::setNormalSmoothingSize(normal_smoothing_size);
+        normal_smoothing_size_ = normal_smoothing_size;
+    }
+
+    void
+    setDepthDependentSmoothing(bool use_depth_dependent_smoothing) {
+        Base::setDepthDependentSmoothing(use_depth_dependent_smoothing);
+        depth_dependent_smoothing_ = use_depth_dependent_smoothing;
+    }
+
+    void
+    setInputCloud(const PointCloudInConstPtr &cloud) {
+        Base::setInputCloud(cloud);
+        cloud_ = cloud;
+    }
+
+    //线程数，0 表示使用全部硬件线程
+    void setNumberOfThreads(int nr_threads) { nr_threads_ = nr_threads; }
+
+    void
+    compute(PointCloudOut &output) {
+        if (method_ != Base::AVERAGE_3D_GRADIENT || border_policy_ != Base::BORDER_POLICY_IGNORE ||
+            depth_dependent_smoothing_ || !cloud_ || !cloud_->isOrganized() || normal_smoothing_size_ <= 0.0f) {
+            Base::compute(output);
+            return;
+        }
+        const int width = static_cast<int>(cloud_->width), height = static_cast<int>(cloud_->height);
+        const float nan = std::numeric_limits<float>::quiet_NaN();
+        output.header = cloud_->header;
+        output.width = cloud_->width;
+        output.height = cloud_->height;
+        output.is_dense = false;
+        output.points.resize(cloud_->points.size());
+        for (PointOutT &normal: output.points) {
+            normal.normal_x = normal.normal_y = normal.normal_z = nan;
+            normal.curvature = nan;
+        }
+        //与 PCL 相同：离图像边缘 border 以内的点不计算
+        const int border = static_cast<int>(normal_smoothing_size_);
+        const int first_row = border, last_row = height - border;
+        if (last_row <= first_row || width - border <= border)
+            return;
+        const int nr_bands = (last_row - first_row + kBandRows - 1) / kBandRows;
+        parallelForChunks(0, nr_bands, [&](int, int band_begin, int band_end) {
+            BandBuffers buffers;
+            for (int band = band_begin; band < band_end; ++band) {
+                const int r0 = first_row + band * kBandRows, r1 = std::min(last_row, r0 + kBandRows);
+                computeBand(r0, r1, buffers, output);
+            }
+        }, nr_threads_);
+    }
+
+protected:
+    struct BandBuffers {
+        std::vector<unsigned char> depth_change;
+        std::vector<float> distance;
+        std::vector<float> integral;    //每项 6 个分量：水平差分 xyz、竖直差分 xyz
+    };
+
+    //计算第 [r0, r1) 行的法线
+    void
+    computeBand(int r0, int r1, BandBuffers &buffers, PointCloudOut &output) const {
+        const int width = static_cast<int>(cloud_->width), height = static_cast<int>(cloud_->height);
+        const float smoothing_size = normal_smoothing_size_;
+        //距离图只需要 ≤ smoothing 的值，多算 halo 行即可与整幅计算一致
+        const int halo = static_cast<int>(std::ceil(smoothing_size)) + 1;
+        const int d0 = std::max(0, r0 - halo), d1 = std::min(height, r1 + halo);
+        computeDistanceMap(d0, d1, buffers);
+
+        float vpx, vpy, vpz;
+        this->getViewPoint(vpx, vpy, vpz);
+        const int window = static_cast<int>(smoothing_size);
+        for (int c0 = window; c0 < width - window; c0 += kTileCols) {
+            const int c1 = std::min(width - window, c0 + kTileCols);
+            //块内窗口覆盖 [c - w/2, c - w/2 + w)，w ≤ window
+            const int x0 = c0 - window / 2, x1 = c1 + window - window / 2;
+            const int y0 = r0 - window / 2, y1 = r1 + window - window / 2;
+            buildIntegral(x0, x1, y0, y1, buffers.integral);
+            const int stride = x1 - x0 + 1;
+            for (int ri = r0; ri < r1; ++ri) {
+                for (int ci = c0; ci < c1; ++ci) {
+                    const int index = ri * width + ci;
+                    const PointInT &p = cloud_->points[index];
+                    if (!std::isfinite(p.z))
+                        continue;
+                    const float smoothing = std::min(buffers.distance[(ri - d0) * width + ci], smoothing_size);
+                    if (!(smoothing > 2.0f))
+                        continue;
+                    const int w = static_cast<int>(smoothing);
+                    const int ax = ci - w / 2 - x0, ay = ri - w / 2 - y0;
+                    const float *a = &buffers.integral[(ay * stride + ax) * 6];
+                    const float *b = &buffers.integral[(ay * stride + ax + w) * 6];
+                    const float *c = &buffers.integral[((ay + w) * stride + ax) * 6];
+                    const float *d = &buffers.integral[((ay + w) * stride + ax + w) * 6];
+                    double sum[6];
+                    for (int k = 0; k < 6; ++k)
+                        sum[k] = static_cast<double>(d[k] - b[k] - c[k] + a[k]);
+                    //法线 = 竖直梯度 × 水平梯度
+                    double nx = sum[4] * sum[2] - sum[5] * sum[1];
+                    double ny = sum[5] * sum[0] - sum[3] * sum[2];
+                    double nz = sum[3] * sum[1] - sum[4] * sum[0];
+                    const double length = nx * nx + ny * ny + nz * nz;
+                    if (length == 0.0)
+                        continue;
+                    const double inv = 1.0 / std::sqrt(length);
+                    nx *= inv;
+                    ny *= inv;
+                    nz *= inv;
+                    if ((vpx - p.x) * nx + (vpy - p.y) * ny + (vpz - p.z) * nz < 0.0) {
+                        nx = -nx;
+                        ny = -ny;
+                        nz = -nz;
+                    }
+                    output.points[index].normal_x = static_cast<float>(nx);
+                    output.points[index].normal_y = static_cast<float>(ny);
+                    output.points[index].normal_z = static_cast<float>(nz);
+                }
+            }
+        }
+    }
+
+    /**
+     * 第 [d0, d1) 行的深度跳变图与 chamfer 距离(1 与 1.4)，与 PCL 的两遍扫描相同，
+     * 但行尾不越界读取下一行。distance 的第 0 行对应图像第 d0 行。
+     */
+    void
+    computeDistanceMap(int d0, int d1, BandBuffers &buffers) const {
+        const int width = static_cast<int>(cloud_->width), height = static_cast<int>(cloud_->height);
+        const int rows = d1 - d0;
+        std::vector<unsigned char> &change = buffers.depth_change;
+        change.assign(static_cast<std::size_t>(rows) * width, 255);
+        //跳变由 (ri, ci) 与右侧、下方的点决定，也要看 d0 上一行与下方的点
+        for (int ri = std::max(0, d0 - 1); ri < std::min(height - 1, d1); ++ri) {
+            for (int ci = 0; ci < width - 1; ++ci) {
+                const int index = ri * width + ci;
+                const float depth = cloud_->points[index].z;
+                const float depth_r = cloud_->points[index + 1].z;
+                const float depth_d = cloud_->points[index + width].z;
+                const float threshold = max_depth_change_factor_ * (std::abs(depth) + 1.0f) * 2.0f;
+                const int local = ri - d0;
+                if (std::fabs(depth - depth_r) > threshold || !std::isfinite(depth) || !std::isfinite(depth_r)) {
+                    if (local >= 0) {
+                        change[local * width + ci] = 0;
+                        change[local * width + ci + 1] = 0;
+                    }
+                }
+                if (std::fabs(depth - depth_d) > threshold || !std::isfinite(depth) || !std::isfinite(depth_d)) {
+                    if (local >= 0)
+                        change[local * width + ci] = 0;
+                    if (local + 1 < rows)
+                        change[(local + 1) * width + ci] = 0;
+                }
+            }
+        }
+
+        std::vector<float> &distance = buffers.distance;
+        distance.resize(change.size());
+        const float far = static_cast<float>(width + height);
+        for (std::size_t i = 0; i < change.size(); ++i)
+            distance[i] = change[i] == 0 ? 0.0f : far;
+        for (int ri = 1; ri < rows; ++ri) {
+            float *previous = &distance[(ri - 1) * width], *current = &distance[ri * width];
+            for (int ci = 1; ci < width; ++ci) {
+                float value = std::min(previous[ci - 1] + 1.4f, previous[ci] + 1.0f);
+                if (ci + 1 < width)
+                    value = std::min(value, previous[ci + 1] + 1.4f);
+                value = std::min(value, current[ci - 1] + 1.0f);
+                current[ci] = std::min(current[ci], value);
+            }
+        }
+        for (int ri = rows - 2; ri >= 0; --ri) {
+            float *next = &distance[(ri + 1) * width], *current = &distance[ri * width];
+            for (int ci = width - 2; ci >= 0; --ci) {
+                float value = std::min(next[ci] + 1.0f, next[ci + 1] + 1.4f);
+                if (ci > 0)
+                    value = std::min(value, next[ci - 1] + 1.4f);
+                value = std::min(value, current[ci + 1] + 1.0f);
+                current[ci] = std::min(current[ci], value);
+            }
+        }
+    }
+
+    /**
+     * 像素 [x0, x1) x [y0, y1) 上水平差分 p(c+1)-p(c-1) 与竖直差分 p(r+1)-p(r-1) 的局部积分图，
+     * 与 PCL 相同：图像最外一圈的差分为 0，含 NaN 的差分按 0 处理。
+     */
+    void
+    buildIntegral(int x0, int x1, int y0, int y1, std::vector<float> &integral) const {
+        const int width = static_cast<int>(cloud_->width), height = static_cast<int>(cloud_->height);
+        const int stride = x1 - x0 + 1;
+        integral.assign(static_cast<std::size_t>(y1 - y0 + 1) * stride * 6, 0.0f);
+        for (int y = y0; y < y1; ++y) {
+            float row_sum[6] = {0.0f, 0.0f, 0.0f, 0.0f, 0.0f, 0.0f};
+            const float *above = &integral[((y - y0) * stride) * 6];
+            float *current = &integral[((y - y0 + 1) * stride) * 6];
+            for (int x = x0; x < x1; ++x) {
+                float diff[6] = {0.0f, 0.0f, 0.0f, 0.0f, 0.0f, 0.0f};
+                if (y > 0 && y < height - 1 && x > 0 && x < width - 1) {
+                    const PointInT &left = cloud_->points[y * width + x - 1], &right = cloud_->points[y * width + x + 1];
+                    const PointInT &up = cloud_->points[(y - 1) * width + x], &down = cloud_->points[(y + 1) * width + x];
+                    diff[0] = right.x - left.x;
+                    diff[1] = right.y - left.y;
+                    diff[2] = right.z - left.z;
+                    diff[3] = down.x - up.x;
+                    diff[4] = down.y - up.y;
+                    diff[5] = down.z - up.z;
+                    if (!std::isfinite(diff[0] + diff[1] + diff[2]))
+                        diff[0] = diff[1] = diff[2] = 0.0f;
+                    if (!std::isfinite(diff[3] + diff[4] + diff[5]))
+                        diff[3] = diff[4] = diff[5] = 0.0f;
+                }
+                const int column = x - x0 + 1;
+                for (int k = 0; k < 6; ++k) {
+                    row_sum[k] += diff[k];
+                    current[column * 6 + k] = above[column * 6 + k] + row_sum[k];
+                }
+            }
+        }
+    }
+
+    PointCloudInConstPtr cloud_;
+    NormalEstimationMethod method_;
+    BorderPolicy border_policy_;
+    float max_depth_change_factor_;
+    float normal_smoothing_size_;
+    bool depth_dependent_smoothing_;
+    int nr_threads_;
+};
@@ -0,0 +1,225 @@
+/*
+ * 按需计算的法线场
+ * 关键点检测、RANSAC 内点检查等往往只读取少数点的法线。LazyNormalField 不预先计算整片点云的法线：
+ *   - getNormal(i) 第一次访问时查询邻域、求法线并缓存，之后直接返回；可以在多个线程中同时调用，
+ *     同一个点只计算一次(其它线程等待计算完成)；
+ *   - prefetch(indices) 对已知的索引集合批量计算，多线程，每 8 个邻域一起求特征值；已计算的点跳过；
+ *   - 法线与 NormalEstimationBatch 相同(共用 normal_estimation_batch.h 的 accumulateNormalCovariance / solveNormalBatch)，
+ *     邻居少于 3 个时为 NaN。
+ * 搜索方法未设置时，第一次访问时建立 kd-tree。setInputCloud 与各个参数的设置不是线程安全的，应在访问之前完成。
+ */
+#pragma once
+
+#include <atomic>
+#include <cmath>
+#include <limits>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include <pcl/point_cloud.h>
+#include <pcl/point_types.h>
+#include <pcl/search/kdtree.h>
+#include <pcl/search/search.h>
+
+#include "normal_estimation_batch.h"
+#include "parallel.h"
+
+template<typename PointT>
+class LazyNormalField {
+public:
+    typedef boost::shared_ptr<LazyNormalField<PointT> > Ptr;
+    typedef typename pcl::PointCloud<PointT>::ConstPtr PointCloudConstPtr;
+    typedef typename pcl::search::Search<PointT>::Ptr SearchPtr;
+
+    LazyNormalField()
+            : radius_(0.0), k_(0), vpx_(0.0f), vpy_(0.0f), vpz_(0.0f), nr_threads_(0), size_(0),
+              search_once_(new std::once_flag) {}
+
+    //更换点云会清空已缓存的法线
+    void
+    setInputCloud(const PointCloudConstPtr &cloud) {
+        cloud_ = cloud;
+        reset();
+    }
+
+    //可选：已建立好的搜索结构(如 NeighborhoodGraphSearch)，输入点云须相同
+    void
+    setSearchMethod(const SearchPtr &search) {
+        search_ = search;
+        reset();
+    }
+
+    void
+    setRadiusSearch(double radius) {
+        radius_ = radius;
+        k_ = 0;
+        reset();
+    }
+
+    void
+    setKSearch(int k) {
+        k_ = k;
+        radius_ = 0.0;
+        reset();
+    }
+
+    void
+    setViewPoint(float vpx, float vpy, float vpz) {
+        vpx_ = vpx;
+        vpy_ = vpy;
+        vpz_ = vpz;
+        reset();
+    }
+
+    //prefetch 使用的线程数，0 表示使用全部硬件线程
+    void setNumberOfThreads(int nr_threads) { nr_threads_ = nr_threads; }
+
+    //第 index 个点的法线，第一次访问时计算
+    const pcl::Normal &
+    getNormal(int index) {
+        ensureSearch();
+        if (state_[index].load(std::memory_order_acquire) != kReady) {
+            unsigned char expected = kEmpty;
+            if (state_[index].compare_exchange_strong(expected, kComputing, std::memory_order_acq_rel)) {
+                std::vector<int> nn_indices;
+                std::vector<float> nn_dists;
+                NormalCovarianceBatch batch;
+                batch.size = 0;
+                addToBatch(index, batch, nn_indices, nn_dists);
+                solve(batch);
+            } else {
+                //其它线程正在计算
+                while (state_[index].load(std::memory_order_acquire) != kReady)
+                    std::this_thread::yield();
+            }
+        }
+        return normals_[index];
+    }
+
+    //批量计算 indices 中尚未计算的点
+    void
+    prefetch(const std::vector<int> &indices) {
+        ensureSearch();
+        parallelForChunks(0, static_cast<int>(indices.size()), [&](int, int begin, int end) {
+            std::vector<int> nn_indices;
+            std::vector<float> nn_dists;
+            std::vector<int> waiting;
+            NormalCovarianceBatch batch;
+            batch.size = 0;
+            for (int i = begin; i < end; ++i) {
+                const int index = indices[i];
+                unsigned char expected = kEmpty;
+                if (!state_[index].compare_exchange_strong(expected, kComputing, std::memory_order_acq_rel)) {
+                    if (expected == kComputing)
+                        waiting.push_back(index);
+                    continue;
+                }
+                addToBatch(index, batch, nn_indices, nn_dists);
+                if (batch.size == NormalCovarianceBatch::kLanes)
+                    solve(batch);
+            }
+            solve(batch);
+            //返回前保证 indices 中的点都已算完
+            for (int index: waiting)
+                while (state_[index].load(std::memory_order_acquire) != kReady)
+                    std::this_thread::yield();
+        }, nr_threads_);
+    }
+
+    //indices 对应的法线，按 indices 的顺序输出
+    void
+    getNormals(const std::vector<int> &indices, pcl::PointCloud<pcl::Normal> &normals) {
+        prefetch(indices);
+        normals.points.resize(indices.size());
+        normals.width = static_cast<std::uint32_t>(indices.size());
+        normals.height = 1;
+        normals.is_dense = true;
+        for (std::size_t i = 0; i < indices.size(); ++i) {
+            normals.points[i] = normals_[indices[i]];
+            if (!std::isfinite(normals.points[i].normal_x))
+                normals.is_dense = false;
+        }
+    }
+
+    bool
+    isComputed(int index) const {
+        return state_ && state_[index].load(std::memory_order_acquire) == kReady;
+    }
+
+    //已计算的点数
+    int
+    getNumberOfComputed() const {
+        int count = 0;
+        for (std::size_t i = 0; state_ && i < size_; ++i)
+            if (state_[i].load(std::memory_order_relaxed) == kReady)
+                ++count;
+        return count;
+    }
+
+    std::size_t size() const { return size_; }
+
+protected:
+    enum : unsigned char { kEmpty = 0, kComputing = 1, kReady = 2 };
+
+    void
+    reset() {
+        size_ = cloud_ ? cloud_->points.size() : 0;
+        normals_.assign(size_, pcl::Normal());
+        state_.reset(new std::atomic<unsigned char>[size_]);
+        for (std::size_t i = 0; i < size_; ++i)
+            state_[i].store(kEmpty, std::memory_order_relaxed);
+        search_once_.reset(new std::once_flag);
+    }
+
+    void
+    ensureSearch() {
+        std::call_once(*search_once_, [this]() {
+            if (!search_)
+                search_.reset(new pcl::search::KdTree<PointT>);
+            if (search_->getInputCloud() != cloud_)
+                search_->setInputCloud(cloud_);
+        });
+    }
+
+    //查询邻域并累加协方差；不足 3 个有效邻居时直接写入 NaN
+    void
+    addToBatch(int index, NormalCovarianceBatch &batch, std::vector<int> &nn_indices, std::vector<float> &nn_dists) {
+        const PointT &query = cloud_->points[index];
+        int found = 0;
+        if (std::isfinite(query.x) && std::isfinite(query.y) && std::isfinite(query.z))
+            found = k_ > 0 ? search_->nearestKSearch(index, k_, nn_indices, nn_dists)
+                           : search_->radiusSearch(index, radius_, nn_indices, nn_dists);
+        if (accumulateNormalCovariance(query, *cloud_, nn_indices, found, batch, index))
+            return;
+        const float nan = std::numeric_limits<float>::quiet_NaN();
+        pcl::Normal &normal = normals_[index];
+        normal.normal_x = normal.normal_y = normal.normal_z = normal.curvature = nan;
+        state_[index].store(kReady, std::memory_order_release);
+    }
+
+    void
+    solve(NormalCovarianceBatch &batch) {
+        auto store = [this](int index, float nx, float ny, float nz, float curvature) {
+            pcl::Normal &normal = normals_[index];
+            normal.normal_x = nx;
+            normal.normal_y = ny;
+            normal.normal_z = nz;
+            normal.curvature = curvature;
+            state_[index].store(kReady, std::memory_order_release);
+        };
+        solveNormalBatch(batch, vpx_, vpy_, vpz_, store);
+    }
+
+    PointCloudConstPtr cloud_;
+    SearchPtr search_;
+    double radius_;
+    int k_;
+    float vpx_, vpy_, vpz_;
+    int nr_threads_;
+    std::size_t size_;
+    std::vector<pcl::Normal, Eigen::aligned_allocator<pcl::Normal> > normals_;
+    std::unique_ptr<std::atomic<unsigned char>[]> state_;
+    std::unique_ptr<std::once_flag> search_once_;
+};
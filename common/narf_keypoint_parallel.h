@@ -0,0 +1,359 @@
+/*
+ * 多线程 NARF 关键点
+ * 兴趣值按 Steder 等人的 NARF 论文计算：I = I1 * I2
+ *   I1 = min_n (1 - w_n * max(1 - |p-n| / (optimal_distance_to_high_surface_change * support_size), 0))
+ *        惩罚紧挨着强表面变化的位置，让关键点落在稳定的表面上；
+ *   I2 = max_{i,j} f(n_i) f(n_j) (1 - |cos(a_i - a_j)|)，f(n) = sqrt(w_n (1 - |2|p-n|/support_size - 1/2|))
+ *        支持区域内存在多个不同方向的表面变化时兴趣值高，方向 a 按 18 格角度直方图近似。
+ * 兴趣图按行并行，非极大值抑制按行分段并行、按段顺序合并，结果与线程数无关。
+ * 边界与表面变化可以由调用者传入(与深度图边界显示共用一次 RangeImageBorderExtractorParallel 的结果)。
+ * computeMultiScale 对一组 support_size 只遍历一次邻域：只访问最大尺度窗口内的表面变化像素，
+ * 每个像素按距离同时更新所有覆盖到它的尺度，耗时与单尺度运行(最大尺度)相当。
+ */
+#pragma once
+
+#include <algorithm>
+#include <cmath>
+#include <vector>
+
+#include <pcl/point_cloud.h>
+#include <pcl/point_types.h>
+#include <pcl/range_image/range_image.h>
+
+#include "parallel.h"
+#include "range_image_border_parallel.h"
+
+class NarfKeypointParallel {
+public:
+    //带尺度的关键点：index 为深度图中的点索引，support_size 为检测到它的尺度
+    struct ScaledKeypoint {
+        int index;
+        float support_size;
+        float interest;
+    };
+
+    //与 pcl::NarfKeypoint::Parameters 同名的参数含义相同
+    struct Parameters {
+        float support_size = -1.0f;                         //支持区域直径，必须设置
+        int max_no_of_interest_points = -1;                 //-1 表示不限制
+        float min_distance_between_interest_points = 0.25f; //关键点之间的最小距离(相对 support_size)
+        float optimal_distance_to_high_surface_change = 0.25f;
+        float min_interest_value = 0.45f;
+        float min_surface_change_score = 0.2f;
+        bool do_non_maximum_suppression = true;
+        int max_no_of_threads = 0;                          //0 表示使用全部硬件线程
+    };
+
+    NarfKeypointParallel() : range_image_(nullptr), borders_(nullptr), surface_changes_(nullptr) {}
+
+    void
+    setRangeImage(const pcl::RangeImage *range_image) {
+        range_image_ = range_image;
+        borders_ = nullptr;
+        surface_changes_ = nullptr;
+    }
+
+    //传入已经算好的边界与表面变化，compute 时不再重新提取
+    void
+    setBorders(const RangeImageBorders *borders, const RangeImageSurfaceChanges *surface_changes) {
+        borders_ = borders;
+        surface_changes_ = surface_changes;
+    }
+
+    Parameters &
+    getParameters() {
+        return parameters_;
+    }
+
+    //单尺度时为 support_size 的兴趣图，多尺度时为最小尺度的兴趣图
+    const std::vector<float> &
+    getInterestImage() const {
+        return getInterestImage(0);
+    }
+
+    const std::vector<float> &
+    getInterestImage(int scale) const {
+        static const std::vector<float> empty;
+        return scale < static_cast<int>(interest_images_.size()) ? interest_images_[scale] : empty;
+    }
+
+    void
+    compute(pcl::PointCloud<int> &keypoint_indices) {
+        keypoint_indices.points.clear();
+        keypoint_indices.width = 0;
+        keypoint_indices.height = 1;
+        std::vector<ScaledKeypoint> keypoints;
+        if (parameters_.support_size <= 0.0f || !prepare())
+            return;
+        calculateInterestImages(std::vector<float>(1, parameters_.support_size));
+        extractKeypoints(0, parameters_.support_size, keypoints);
+        for (const ScaledKeypoint &keypoint: keypoints)
+            keypoint_indices.points.push_back(keypoint.index);
+        keypoint_indices.width = static_cast<std::uint32_t>(keypoint_indices.points.size());
+    }
+
+    //一次遍历得到多个尺度的关键点，结果按 support_sizes 从小到大、同一尺度内按兴趣值从高到低排列
+    void
+    computeMultiScale(const std::vector<float> &support_sizes, std::vector<ScaledKeypoint> &keypoints) {
+        keypoints.clear();
+        std::vector<float> scales;
+        for (float support_size: support_sizes)
+            if (support_size > 0.0f)
+                scales.push_back(support_size);
+        std::sort(scales.begin(), scales.end());
+        scales.erase(std::unique(scales.begin(), scales.end()), scales.end());
+        if (scales.empty() || !prepare())
+            return;
+        calculateInterestImages(scales);
+        for (std::size_t k = 0; k < scales.size(); ++k)
+            extractKeypoints(static_cast<int>(k), scales[k], keypoints);
+    }
+
+protected:
+    static const int kHistogramSize = 18;
+    static const int kCellSize = 8;
+
+    //没有传入边界时自己提取一次
+    bool
+    prepare() {
+        interest_images_.clear();
+        active_borders_ = borders_;
+        active_surface_changes_ = surface_changes_;
+        if (range_image_ == nullptr || range_image_->points.empty())
+            return false;
+        if (active_borders_ == nullptr || active_surface_changes_ == nullptr ||
+            active_surface_changes_->width != static_cast<int>(range_image_->width) ||
+            active_surface_changes_->height != static_cast<int>(range_image_->height)) {
+            RangeImageBorderExtractorParallel border_extractor(range_image_);
+            border_extractor.getParameters().max_no_of_threads = parameters_.max_no_of_threads;
+            border_extractor.compute(own_borders_, own_surface_changes_);
+            active_borders_ = &own_borders_;
+            active_surface_changes_ = &own_surface_changes_;
+        }
+        return true;
+    }
+
+    /**
+     * 表面变化超过阈值的像素通常只占一小部分，按 8x8 像素的格子分桶(CSR，同一格子行的数据连续存放)，
+     * 每个像素只遍历最大尺度窗口内的这些像素，再按距离同时更新所有尺度，遍历代价与尺度个数无关。
+     */
+    void
+    buildChangeCells(const RangeImageSurfaceChanges &changes) {
+        const int w = static_cast<int>(range_image_->width), h = static_cast<int>(range_image_->height);
+        cells_x_ = (w + kCellSize - 1) / kCellSize;
+        cells_y_ = (h + kCellSize - 1) / kCellSize;
+        cell_start_.assign(static_cast<std::size_t>(cells_x_) * cells_y_ + 1, 0);
+        parallelFor(0, cells_y_, [&](int cy) {
+            for (int y = cy * kCellSize; y < std::min(h, (cy + 1) * kCellSize); ++y)
+                for (int x = 0; x < w; ++x)
+                    if (changes.scores[y * w + x] >= parameters_.min_surface_change_score)
+                        ++cell_start_[cy * cells_x_ + x / kCellSize + 1];
+        }, parameters_.max_no_of_threads);
+        for (std::size_t c = 1; c < cell_start_.size(); ++c)
+            cell_start_[c] += cell_start_[c - 1];
+
+        const std::size_t nr_changes = static_cast<std::size_t>(cell_start_.back());
+        change_pixel_.resize(nr_changes);
+        change_score_.resize(nr_changes);
+        change_point_.resize(nr_changes);
+        change_direction_.resize(nr_changes);
+        parallelFor(0, cells_y_, [&](int cy) {
+            std::vector<int> fill(cell_start_.begin() + cy * cells_x_, cell_start_.begin() + (cy + 1) * cells_x_);
+            for (int y = cy * kCellSize; y < std::min(h, (cy + 1) * kCellSize); ++y)
+                for (int x = 0; x < w; ++x) {
+                    const int index = y * w + x;
+                    if (changes.scores[index] < parameters_.min_surface_change_score)
+                        continue;
+                    const int entry = fill[x / kCellSize]++;
+                    change_pixel_[entry] = index;
+                    change_score_[entry] = changes.scores[index];
+                    change_point_[entry] = range_image_->points[index].getVector3fMap();
+                    change_direction_[entry] = Eigen::Vector3f(changes.direction_x[index], changes.direction_y[index],
+                                                               changes.direction_z[index]);
+                }
+        }, parameters_.max_no_of_threads);
+    }
+
+    //scales 从小到大排列，每个尺度一张兴趣图
+    void
+    calculateInterestImages(const std::vector<float> &scales) {
+        const int w = static_cast<int>(range_image_->width), h = static_cast<int>(range_image_->height);
+        const int nr_scales = static_cast<int>(scales.size());
+        interest_images_.assign(nr_scales, std::vector<float>(static_cast<std::size_t>(w) * h, 0.0f));
+        const RangeImageBorders &borders = *active_borders_;
+        buildChangeCells(*active_surface_changes_);
+        if (change_pixel_.empty())
+            return;
+
+        //直方图格子之间的 1 - |cos(a_i - a_j)|
+        float angle_weight[kHistogramSize][kHistogramSize];
+        for (int a = 0; a < kHistogramSize; ++a)
+            for (int b = 0; b < kHistogramSize; ++b)
+                angle_weight[a][b] = 1.0f - std::abs(std::cos(static_cast<float>(M_PI) * (a - b) / kHistogramSize));
+
+        std::vector<float> search_radius_squared(nr_scales), optimal_distance(nr_scales);
+        for (int k = 0; k < nr_scales; ++k) {
+            search_radius_squared[k] = 0.25f * scales[k] * scales[k];
+            optimal_distance[k] = parameters_.optimal_distance_to_high_surface_change * scales[k];
+        }
+        const float max_search_radius = 0.5f * scales[nr_scales - 1];
+        const float angular_resolution = std::min(range_image_->getAngularResolutionX(),
+                                                  range_image_->getAngularResolutionY());
+        const Eigen::Vector3f sensor_pos = range_image_->getSensorPos();
+
+        parallelFor(0, h, [&](int y) {
+            std::vector<float> histograms(static_cast<std::size_t>(nr_scales) * kHistogramSize), interest1(nr_scales);
+            for (int x = 0; x < w; ++x) {
+                const int index = y * w + x;
+                const pcl::PointWithRange &point = range_image_->points[index];
+                if (!std::isfinite(point.range) || borders.shadow.test(x, y) || borders.veil.test(x, y))
+                    continue;
+                const Eigen::Vector3f p(point.x, point.y, point.z);
+
+                //最大尺度的支持区域在图像上的像素半径
+                const int pixel_radius = std::max(1, static_cast<int>(std::ceil(
+                        std::atan2(max_search_radius, point.range) / angular_resolution)));
+                const int cx_begin = std::max(0, (x - pixel_radius) / kCellSize),
+                        cx_end = std::min(cells_x_ - 1, (x + pixel_radius) / kCellSize);
+                const int cy_begin = std::max(0, (y - pixel_radius) / kCellSize),
+                        cy_end = std::min(cells_y_ - 1, (y + pixel_radius) / kCellSize);
+
+                //视线方向的垂直平面上的基，用来把三维变化方向转成角度
+                const Eigen::Vector3f view = (p - sensor_pos).normalized();
+                const Eigen::Vector3f u = view.unitOrthogonal(), v = view.cross(u);
+
+                std::fill(histograms.begin(), histograms.end(), 0.0f);
+                std::fill(interest1.begin(), interest1.end(), 1.0f);
+                bool any = false;
+                for (int cy = cy_begin; cy <= cy_end; ++cy) {
+                    const int begin = cell_start_[cy * cells_x_ + cx_begin], end = cell_start_[cy * cells_x_ + cx_end + 1];
+                    for (int entry = begin; entry < end; ++entry) {
+                        const int n_index = change_pixel_[entry];
+                        const int dx = n_index % w - x, dy = n_index / w - y;
+                        if (std::abs(dx) > pixel_radius || std::abs(dy) > pixel_radius)
+                            continue;
+                        const float distance_squared = (change_point_[entry] - p).squaredNorm();
+                        if (!(distance_squared <= search_radius_squared[nr_scales - 1]))
+                            continue;
+                        const float distance = std::sqrt(distance_squared), score = change_score_[entry];
+                        const Eigen::Vector3f &direction = change_direction_[entry];
+                        //方向没有正负之分，角度折到 [0, pi)
+                        float angle = std::atan2(direction.dot(v), direction.dot(u));
+                        if (angle < 0.0f)
+                            angle += static_cast<float>(M_PI);
+                        const int bin = std::min(kHistogramSize - 1,
+                                                 static_cast<int>(angle * kHistogramSize / static_cast<float>(M_PI)));
+
+                        //尺度从大到小，距离超出某个尺度后更小的尺度也不包含它
+                        for (int k = nr_scales - 1; k >= 0 && distance_squared <= search_radius_squared[k]; --k) {
+                            if (optimal_distance[k] > 0.0f)
+                                interest1[k] = std::min(interest1[k], 1.0f - score * std::max(1.0f - distance / optimal_distance[k], 0.0f));
+                            const float f = std::sqrt(score * std::max(0.0f, 1.0f - std::abs(2.0f * distance / scales[k] - 0.5f)));
+                            float &bin_value = histograms[k * kHistogramSize + bin];
+                            bin_value = std::max(bin_value, f);
+                        }
+                        any = true;
+                    }
+                }
+                if (!any)
+                    continue;
+
+                for (int k = 0; k < nr_scales; ++k) {
+                    if (interest1[k] <= 0.0f)
+                        continue;
+                    const float *histogram = &histograms[k * kHistogramSize];
+                    float interest2 = 0.0f;
+                    for (int a = 0; a < kHistogramSize; ++a) {
+                        if (histogram[a] <= 0.0f)
+                            continue;
+                        for (int b = a + 1; b < kHistogramSize; ++b)
+                            interest2 = std::max(interest2, histogram[a] * histogram[b] * angle_weight[a][b]);
+                    }
+                    interest_images_[k][index] = interest1[k] * interest2;
+                }
+            }
+        }, parameters_.max_no_of_threads);
+    }
+
+    //像素 index 是否是 3x3 邻域中的极大值；相等时光栅顺序在前的像素胜出，保证结果唯一
+    static bool
+    isLocalMaximum(const std::vector<float> &interest_image, int x, int y, int w, int h) {
+        const int index = y * w + x;
+        const float value = interest_image[index];
+        for (int dy = -1; dy <= 1; ++dy)
+            for (int dx = -1; dx <= 1; ++dx) {
+                const int nx = x + dx, ny = y + dy;
+                if ((dx == 0 && dy == 0) || nx < 0 || nx >= w || ny < 0 || ny >= h)
+                    continue;
+                const int n_index = ny * w + nx;
+                const float n_value = interest_image[n_index];
+                if (n_value > value || (n_value == value && n_index < index))
+                    return false;
+            }
+        return true;
+    }
+
+    //在第 scale 张兴趣图上做非极大值抑制与最小间距筛选，结果追加到 keypoints
+    void
+    extractKeypoints(int scale, float support_size, std::vector<ScaledKeypoint> &keypoints) const {
+        const std::vector<float> &interest_image = interest_images_[scale];
+        const int w = static_cast<int>(range_image_->width), h = static_cast<int>(range_image_->height);
+        const int nr_threads = static_cast<int>(getNumberOfThreads(parameters_.max_no_of_threads));
+
+        //每个线程处理一段连续的行，按段顺序拼接
+        std::vector<std::vector<int> > candidates(nr_threads);
+        parallelForChunks(0, h, [&](int thread_id, int begin, int end) {
+            std::vector<int> &local = candidates[thread_id];
+            for (int y = begin; y < end; ++y)
+                for (int x = 0; x < w; ++x) {
+                    if (interest_image[y * w + x] < parameters_.min_interest_value)
+                        continue;
+                    if (parameters_.do_non_maximum_suppression && !isLocalMaximum(interest_image, x, y, w, h))
+                        continue;
+                    local.push_back(y * w + x);
+                }
+        }, nr_threads);
+        std::vector<int> sorted;
+        for (const std::vector<int> &local: candidates)
+            sorted.insert(sorted.end(), local.begin(), local.end());
+        std::stable_sort(sorted.begin(), sorted.end(), [&interest_image](int a, int b) {
+            return interest_image[a] > interest_image[b];
+        });
+
+        //按兴趣值从高到低贪心选取，保持最小间距
+        const float min_distance = parameters_.min_distance_between_interest_points * support_size;
+        const float min_distance_squared = min_distance * min_distance;
+        std::vector<Eigen::Vector3f, Eigen::aligned_allocator<Eigen::Vector3f> > selected_points;
+        for (int index: sorted) {
+            if (parameters_.max_no_of_interest_points > 0 &&
+                static_cast<int>(selected_points.size()) >= parameters_.max_no_of_interest_points)
+                break;
+            const Eigen::Vector3f p = range_image_->points[index].getVector3fMap();
+            bool too_close = false;
+            for (const Eigen::Vector3f &q: selected_points)
+                if ((q - p).squaredNorm() < min_distance_squared) {
+                    too_close = true;
+                    break;
+                }
+            if (too_close)
+                continue;
+            selected_points.push_back(p);
+            keypoints.push_back(ScaledKeypoint{index, support_size, interest_image[index]});
+        }
+    }
+
+    const pcl::RangeImage *range_image_;
+    const RangeImageBorders *borders_;
+    const RangeImageSurfaceChanges *surface_changes_;
+    const RangeImageBorders *active_borders_ = nullptr;
+    const RangeImageSurfaceChanges *active_surface_changes_ = nullptr;
+    RangeImageBorders own_borders_;
+    RangeImageSurfaceChanges own_surface_changes_;
+    Parameters parameters_;
+    std::vector<std::vector<float> > interest_images_;
+    //表面变化像素的分桶
+    int cells_x_ = 0, cells_y_ = 0;
+    std::vector<int> cell_start_, change_pixel_;
+    std::vector<float> change_score_;
+    std::vector<Eigen::Vector3f, Eigen::aligned_allocator<Eigen::Vector3f> > change_point_, change_direction_;
+};
@@ -0,0 +1,325 @@
+/*
+ * 预先计算的邻域图(CSR 存储)，法线、特征描述子、滤波共用一次 kd-tree 查询
+ *   - NeighborhoodGraph：按最大半径(或最大 K)对每个点查询一次，邻居按距离升序连续存放，
+ *     offsets_[i]..offsets_[i+1] 为第 i 个点的邻居；更小的半径/K 只需在每行上截取前缀。
+ *   - NeighborhoodGraphSearch：pcl::search::Search 的子类，可直接传给 NormalEstimation、PFHEstimation、
+ *     FPFHEstimation 等的 setSearchMethod；图覆盖不了的查询(更大的半径、其它点云、任意坐标)交给内部的 kd-tree。
+ *   - statisticalOutlierRemoval：与 pcl::StatisticalOutlierRemoval 相同的统计滤波，直接读图中的 K 近邻。
+ */
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <utility>
+#include <vector>
+
+#include <pcl/point_cloud.h>
+#include <pcl/point_types.h>
+#include <pcl/search/kdtree.h>
+#include <pcl/search/search.h>
+
+#include "parallel.h"
+
+template<typename PointT>
+class NeighborhoodGraph {
+public:
+    typedef boost::shared_ptr<NeighborhoodGraph<PointT> > Ptr;
+    typedef boost::shared_ptr<const NeighborhoodGraph<PointT> > ConstPtr;
+    typedef typename pcl::PointCloud<PointT>::ConstPtr PointCloudConstPtr;
+    typedef typename pcl::search::KdTree<PointT>::Ptr KdTreePtr;
+
+    NeighborhoodGraph() : radius_(0.0), k_(0), nr_threads_(0), tree_(new pcl::search::KdTree<PointT>) {}
+
+    //线程数，0 表示使用全部硬件线程
+    void setNumberOfThreads(int nr_threads) { nr_threads_ = nr_threads; }
+
+    //以 radius 为半径建图，之后任何不超过 radius 的半径查询都可以从图中截取
+    void
+    buildRadius(const PointCloudConstPtr &cloud, double radius) {
+        radius_ = radius;
+        k_ = 0;
+        build(cloud, [this](int i, std::vector<int> &indices, std::vector<float> &distances) {
+            tree_->radiusSearch(static_cast<int>(i), radius_, indices, distances);
+        });
+    }
+
+    //以 K 近邻建图(含点本身)，之后任何不超过 k 的近邻查询都可以从图中截取
+    void
+    buildKNN(const PointCloudConstPtr &cloud, int k) {
+        radius_ = 0.0;
+        k_ = k;
+        build(cloud, [this](int i, std::vector<int> &indices, std::vector<float> &distances) {
+            tree_->nearestKSearch(static_cast<int>(i), k_, indices, distances);
+        });
+    }
+
+    PointCloudConstPtr getInputCloud() const { return input_; }
+
+    //建图用的 kd-tree，图覆盖不了的查询由它完成
+    KdTreePtr getSearchMethod() const { return tree_; }
+
+    double getRadius() const { return radius_; }
+
+    int getK() const { return k_; }
+
+    std::size_t size() const { return offsets_.empty() ? 0 : offsets_.size() - 1; }
+
+    //第 i 个点的邻居个数(按最大半径/K)
+    int
+    degree(int i) const {
+        return static_cast<int>(offsets_[i + 1] - offsets_[i]);
+    }
+
+    //第 i 个点的邻居与距离平方，按距离升序
+    const int *neighbors(int i) const { return neighbors_.data() + offsets_[i]; }
+
+    const float *sqrDistances(int i) const { return sqr_distances_.data() + offsets_[i]; }
+
+    /**
+     * 第 i 个点在 radius 以内的邻居个数；图无法保证完整时(半径超过建图半径，
+     * 或 K 近邻图中第 K 个邻居仍在 radius 以内)返回 -1。
+     */
+    int
+    countWithinRadius(int i, double radius) const {
+        const float sqr_radius = static_cast<float>(radius * radius);
+        const float *first = sqrDistances(i), *last = first + degree(i);
+        const int count = static_cast<int>(std::upper_bound(first, last, sqr_radius) - first);
+        if (k_ > 0) {
+            //K 近邻图：只有第 K 个邻居已经在半径以外，半径内的点才是完整的
+            return count < degree(i) || degree(i) < k_ ? count : -1;
+        }
+        return radius <= radius_ ? count : -1;
+    }
+
+    //第 i 个点的前 k 个近邻是否都在图中
+    bool
+    hasKNearest(int i, int k) const {
+        return degree(i) >= k;
+    }
+
+protected:
+    template<typename Query>
+    void
+    build(const PointCloudConstPtr &cloud, Query query) {
+        input_ = cloud;
+        tree_->setInputCloud(cloud);
+        const int n = static_cast<int>(cloud->points.size());
+        const int nr_threads = static_cast<int>(std::min<unsigned int>(getNumberOfThreads(nr_threads_),
+                                                                       static_cast<unsigned int>(std::max(1, n))));
+        //每个线程负责一段连续的点，先写到自己的缓冲区，再按点的顺序拼成 CSR
+        std::vector<std::vector<int> > local_neighbors(nr_threads);
+        std::vector<std::vector<float> > local_distances(nr_threads);
+        std::vector<int> counts(n, 0);
+        std::vector<int> chunk_begin(nr_threads, n);
+        parallelForChunks(0, n, [&](int thread_id, int begin, int end) {
+            chunk_begin[thread_id] = begin;
+            std::vector<int> indices;
+            std::vector<float> distances;
+            std::vector<std::pair<float, int> > row;
+            for (int i = begin; i < end; ++i) {
+                const PointT &p = cloud->points[i];
+                if (!std::isfinite(p.x) || !std::isfinite(p.y) || !std::isfinite(p.z))
+                    continue;
+                query(i, indices, distances);
+                //kd-tree 不保证按距离排序(sorted 可被关闭)，统一排序，距离相同按下标
+                row.resize(indices.size());
+                for (std::size_t j = 0; j < indices.size(); ++j)
+                    row[j] = std::make_pair(distances[j], indices[j]);
+                std::sort(row.begin(), row.end());
+                for (const std::pair<float, int> &entry: row) {
+                    local_distances[thread_id].push_back(entry.first);
+                    local_neighbors[thread_id].push_back(entry.second);
+                }
+                counts[i] = static_cast<int>(row.size());
+            }
+        }, nr_threads);
+
+        offsets_.assign(n + 1, 0);
+        for (int i = 0; i < n; ++i)
+            offsets_[i + 1] = offsets_[i] + counts[i];
+        neighbors_.resize(offsets_[n]);
+        sqr_distances_.resize(offsets_[n]);
+        parallelFor(0, nr_threads, [&](int t) {
+            if (local_neighbors[t].empty())
+                return;
+            std::copy(local_neighbors[t].begin(), local_neighbors[t].end(), neighbors_.begin() + offsets_[chunk_begin[t]]);
+            std::copy(local_distances[t].begin(), local_distances[t].end(),
+                      sqr_distances_.begin() + offsets_[chunk_begin[t]]);
+        }, nr_threads);
+    }
+
+    PointCloudConstPtr input_;
+    double radius_;
+    int k_;
+    int nr_threads_;
+    KdTreePtr tree_;
+
+    //CSR：offsets_ 长度为点数 + 1
+    std::vector<std::size_t> offsets_;
+    std::vector<int> neighbors_;
+    std::vector<float> sqr_distances_;
+};
+
+/**
+ * 把 NeighborhoodGraph 包装成 pcl::search::Search。Feature 按输入点的下标查询邻域时，
+ * 从图中截取前缀后直接返回，不再访问 kd-tree；setInputCloud 传入其它点云或带 indices 时全部交给 kd-tree。
+ */
+template<typename PointT>
+class NeighborhoodGraphSearch : public pcl::search::Search<PointT> {
+public:
+    typedef pcl::search::Search<PointT> Base;
+    typedef typename Base::PointCloud PointCloud;
+    typedef typename Base::PointCloudConstPtr PointCloudConstPtr;
+    typedef typename Base::IndicesConstPtr IndicesConstPtr;
+    typedef boost::shared_ptr<NeighborhoodGraphSearch<PointT> > Ptr;
+
+    explicit NeighborhoodGraphSearch(const typename NeighborhoodGraph<PointT>::ConstPtr &graph)
+            : Base("NeighborhoodGraphSearch", true), graph_(graph), fallback_(new pcl::search::KdTree<PointT>),
+              graph_hits_(0), tree_hits_(0) {
+        Base::setInputCloud(graph_->getInputCloud());
+    }
+
+    void
+    setInputCloud(const PointCloudConstPtr &cloud, const IndicesConstPtr &indices = IndicesConstPtr()) override {
+        Base::setInputCloud(cloud, indices);
+        use_graph_ = cloud == graph_->getInputCloud() && !indices;
+        if (!use_graph_)
+            fallback_->setInputCloud(cloud, indices);
+    }
+
+    int
+    nearestKSearch(const PointT &point, int k, std::vector<int> &k_indices,
+                   std::vector<float> &k_sqr_distances) const override {
+        ++tree_hits_;
+        return tree().nearestKSearch(point, k, k_indices, k_sqr_distances);
+    }
+
+    int
+    nearestKSearch(const PointCloud &cloud, int index, int k, std::vector<int> &k_indices,
+                   std::vector<float> &k_sqr_distances) const override {
+        if (use_graph_ && &cloud == graph_->getInputCloud().get())
+            return nearestKSearch(index, k, k_indices, k_sqr_distances);
+        ++tree_hits_;
+        return tree().nearestKSearch(cloud[index], k, k_indices, k_sqr_distances);
+    }
+
+    int
+    nearestKSearch(int index, int k, std::vector<int> &k_indices, std::vector<float> &k_sqr_distances) const override {
+        if (use_graph_ && graph_->hasKNearest(index, k)) {
+            ++graph_hits_;
+            return copyRow(index, k, k_indices, k_sqr_distances);
+        }
+        ++tree_hits_;
+        return tree().nearestKSearch((*this->input_)[index], k, k_indices, k_sqr_distances);
+    }
+
+    int
+    radiusSearch(const PointT &point, double radius, std::vector<int> &k_indices, std::vector<float> &k_sqr_distances,
+                 unsigned int max_nn = 0) const override {
+        ++tree_hits_;
+        return tree().radiusSearch(point, radius, k_indices, k_sqr_distances, max_nn);
+    }
+
+    int
+    radiusSearch(const PointCloud &cloud, int index, double radius, std::vector<int> &k_indices,
+                 std::vector<float> &k_sqr_distances, unsigned int max_nn = 0) const override {
+        if (use_graph_ && &cloud == graph_->getInputCloud().get())
+            return radiusSearch(index, radius, k_indices, k_sqr_distances, max_nn);
+        ++tree_hits_;
+        return tree().radiusSearch(cloud[index], radius, k_indices, k_sqr_distances, max_nn);
+    }
+
+    int
+    radiusSearch(int index, double radius, std::vector<int> &k_indices, std::vector<float> &k_sqr_distances,
+                 unsigned int max_nn = 0) const override {
+        const int count = use_graph_ ? graph_->countWithinRadius(index, radius) : -1;
+        if (count >= 0) {
+            ++graph_hits_;
+            return copyRow(index, max_nn > 0 ? std::min(count, static_cast<int>(max_nn)) : count, k_indices,
+                           k_sqr_distances);
+        }
+        ++tree_hits_;
+        return tree().radiusSearch((*this->input_)[index], radius, k_indices, k_sqr_distances, max_nn);
+    }
+
+    //从图中直接得到结果的查询次数与交给 kd-tree 的次数
+    long getGraphHits() const { return graph_hits_.load(); }
+
+    long getTreeHits() const { return tree_hits_.load(); }
+
+protected:
+    const pcl::search::KdTree<PointT> &
+    tree() const {
+        return use_graph_ ? *graph_->getSearchMethod() : *fallback_;
+    }
+
+    int
+    copyRow(int index, int count, std::vector<int> &k_indices, std::vector<float> &k_sqr_distances) const {
+        const int *neighbors = graph_->neighbors(index);
+        const float *distances = graph_->sqrDistances(index);
+        k_indices.assign(neighbors, neighbors + count);
+        k_sqr_distances.assign(distances, distances + count);
+        return count;
+    }
+
+    typename NeighborhoodGraph<PointT>::ConstPtr graph_;
+    typename pcl::search::KdTree<PointT>::Ptr fallback_;
+    bool use_graph_ = true;
+    mutable std::atomic<long> graph_hits_, tree_hits_;
+};
+
+/**
+ * 统计滤波，结果与 pcl::StatisticalOutlierRemoval(setMeanK(mean_k)、setStddevMulThresh(std_mul)) 相同：
+ * 每个点到 mean_k 个近邻(不含自身)的平均距离超过 全局均值 + std_mul·标准差 的点为离群点。
+ * 近邻从图中读取，图中不足 mean_k + 1 个邻居的点改用 kd-tree 查询。inliers 为保留的点的下标(升序)。
+ */
+template<typename PointT>
+void
+statisticalOutlierRemoval(const NeighborhoodGraph<PointT> &graph, int mean_k, double std_mul, std::vector<int> &inliers,
+                          int nr_threads = 0) {
+    const typename pcl::PointCloud<PointT>::ConstPtr cloud = graph.getInputCloud();
+    const int n = static_cast<int>(graph.size());
+    std::vector<float> distances(n, 0.0f);
+    std::vector<char> valid(n, 0);
+    parallelForChunks(0, n, [&](int, int begin, int end) {
+        std::vector<int> indices;
+        std::vector<float> sqr_distances;
+        for (int i = begin; i < end; ++i) {
+            const PointT &p = cloud->points[i];
+            if (!std::isfinite(p.x) || !std::isfinite(p.y) || !std::isfinite(p.z))
+                continue;
+            const float *row = graph.sqrDistances(i);
+            int count = mean_k + 1;
+            if (!graph.hasKNearest(i, count)) {
+                count = graph.getSearchMethod()->nearestKSearch(i, mean_k + 1, indices, sqr_distances);
+                row = sqr_distances.data();
+            }
+            //第一个邻居是点本身
+            double sum = 0.0;
+            for (int j = 1; j < count; ++j)
+                sum += std::sqrt(row[j]);
+            distances[i] = static_cast<float>(sum / mean_k);
+            valid[i] = 1;
+        }
+    }, nr_threads);
+
+    double sum = 0.0, sq_sum = 0.0;
+    int valid_count = 0;
+    for (int i = 0; i < n; ++i) {
+        if (!valid[i])
+            continue;
+        sum += distances[i];
+        sq_sum += static_cast<double>(distances[i]) * distances[i];
+        ++valid_count;
+    }
+    inliers.clear();
+    if (valid_count == 0)
+        return;
+    const double mean = sum / valid_count;
+    const double variance = valid_count > 1 ? (sq_sum - sum * sum / valid_count) / (valid_count - 1) : 0.0;
+    const double threshold = mean + std_mul * std::sqrt(variance);
+    for (int i = 0; i < n; ++i)
+        if (valid[i] && distances[i] <= threshold)
+            inliers.push_back(i);
+}
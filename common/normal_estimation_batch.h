@@ -0,0 +1,285 @@
+/*
+ * 批量法线估计
+ * NormalEstimationBatch 继承 pcl::NormalEstimation，用法完全相同(setInputCloud、setRadiusSearch/setKSearch、
+ * setSearchMethod、setViewPoint、compute)，只替换逐点的计算：
+ *   - 邻域查询按点分段在多个线程上进行(kd-tree 的查询是只读的)；
+ *   - 每个邻域以查询点为原点累加一阶、二阶矩，kLanes 个邻域的协方差按分量存成 SoA；
+ *   - 对称 3x3 矩阵的最小特征值用闭式解(三角函数法，先按对角线均值平移、按范数缩放)，acos/cos 用多项式代替，
+ *     kLanes 个邻域一起计算，循环没有分支，编译器按 SSE/AVX 向量化；特征向量取 (A-λI) 两行叉积中最长的一个，
+ *     与 pcl::eigen33 的做法相同。曲率为 λ_min / (λ1+λ2+λ3)。
+ * 邻居少于 3 个或查询点无效时法线与曲率为 NaN，与 PCL 相同。
+ * computePacked 直接输出 PackedNormal(compact_features.h)。
+ */
+#pragma once
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <vector>
+
+#include <Eigen/Core>
+
+#include <pcl/features/normal_3d.h>
+#include <pcl/point_cloud.h>
+#include <pcl/point_types.h>
+
+#include "compact_features.h"
+#include "parallel.h"
+
+//kLanes 个邻域的协方差(SoA)、查询点坐标与调用者给的编号，NormalEstimationBatch 与 LazyNormalField 共用
+struct NormalCovarianceBatch {
+    static const int kLanes = 8;    //每批的邻域个数
+    float xx[kLanes], xy[kLanes], xz[kLanes], yy[kLanes], yz[kLanes], zz[kLanes];
+    float px[kLanes], py[kLanes], pz[kLanes];
+    int id[kLanes];
+    int size;
+};
+
+/**
+ * 一批对称矩阵 [xx xy xz; xy yy yz; xz yz zz] 的最小特征值与对应的单位特征向量(各分量为长度 kLanes 的数组)。
+ * curvature 为 λ_min / trace，trace 为 0 时为 0。
+ */
+inline void
+solveSmallestEigen(const float *xx, const float *xy, const float *xz, const float *yy, const float *yz,
+                   const float *zz, float *nx, float *ny, float *nz, float *curvature) {
+    const int kLanes = NormalCovarianceBatch::kLanes;
+    const float kPi = 3.14159265358979f;
+    float beta[kLanes], scale[kLanes], shift[kLanes];
+    for (int l = 0; l < kLanes; ++l) {
+        //B = (A - qI)/p，q 为对角线均值，p 使 B 的 Frobenius 范数为 sqrt(6)，B 的特征值都在 [-2, 2] 内
+        const float q = (xx[l] + yy[l] + zz[l]) * (1.0f / 3.0f);
+        const float a = xx[l] - q, d = yy[l] - q, f = zz[l] - q;
+        const float off = xy[l] * xy[l] + xz[l] * xz[l] + yz[l] * yz[l];
+        const float p2 = (a * a + d * d + f * f + 2.0f * off) * (1.0f / 6.0f);
+        const float p = std::sqrt(p2);
+        const float inv = p > 0.0f ? 1.0f / p : 0.0f;
+        const float ba = a * inv, bd = d * inv, bf = f * inv;
+        const float bb = xy[l] * inv, bc = xz[l] * inv, be = yz[l] * inv;
+        //r = det(B)/2 ∈ [-1, 1]
+        float r = 0.5f * (ba * (bd * bf - be * be) - bb * (bb * bf - be * bc) + bc * (bb * be - bd * bc));
+        r = std::min(1.0f, std::max(-1.0f, r));
+        //acos(r)，A&S 4.4.46：acos(|r|) = sqrt(1-|r|)·poly(|r|)，误差 2e-8
+        const float ar = std::abs(r);
+        float poly = -0.0012624911f;
+        poly = poly * ar + 0.0066700901f;
+        poly = poly * ar - 0.0170881256f;
+        poly = poly * ar + 0.0308918810f;
+        poly = poly * ar - 0.0501743046f;
+        poly = poly * ar + 0.0889789874f;
+        poly = poly * ar - 0.2145988016f;
+        poly = poly * ar + 1.5707963050f;
+        const float acos_abs = std::sqrt(1.0f - ar) * poly;
+        const float acos_r = r >= 0.0f ? acos_abs : kPi - acos_abs;
+        //最小特征值 2cos(acos(r)/3 + 2π/3) = -2cos(u)，u = π/3 - acos(r)/3 ∈ [0, π/3]
+        const float u = (kPi - acos_r) * (1.0f / 3.0f);
+        const float u2 = u * u;
+        const float cos_u = 1.0f + u2 * (-0.5f + u2 * (1.0f / 24.0f + u2 * (-1.0f / 720.0f + u2 * (1.0f / 40320.0f -
+                                                                                       u2 * (1.0f / 3628800.0f)))));
+        beta[l] = -2.0f * cos_u;
+        scale[l] = p;
+        shift[l] = q;
+    }
+    for (int l = 0; l < kLanes; ++l) {
+        //(B - βI) 的三行，零空间即特征向量；取两两叉积中最长的一个
+        const float p = scale[l], inv = p > 0.0f ? 1.0f / p : 0.0f;
+        const float r00 = (xx[l] - shift[l]) * inv - beta[l], r01 = xy[l] * inv, r02 = xz[l] * inv;
+        const float r11 = (yy[l] - shift[l]) * inv - beta[l], r12 = yz[l] * inv;
+        const float r22 = (zz[l] - shift[l]) * inv - beta[l];
+        //c0 = row0 x row1，c1 = row0 x row2，c2 = row1 x row2
+        const float c0x = r01 * r12 - r02 * r11, c0y = r02 * r01 - r00 * r12, c0z = r00 * r11 - r01 * r01;
+        const float c1x = r01 * r22 - r02 * r12, c1y = r02 * r02 - r00 * r22, c1z = r00 * r12 - r01 * r02;
+        const float c2x = r11 * r22 - r12 * r12, c2y = r12 * r02 - r01 * r22, c2z = r01 * r12 - r11 * r02;
+        const float l0 = c0x * c0x + c0y * c0y + c0z * c0z;
+        const float l1 = c1x * c1x + c1y * c1y + c1z * c1z;
+        const float l2 = c2x * c2x + c2y * c2y + c2z * c2z;
+        const bool pick0 = l0 >= l1 && l0 >= l2, pick1 = !pick0 && l1 >= l2;
+        const float vx = pick0 ? c0x : (pick1 ? c1x : c2x);
+        const float vy = pick0 ? c0y : (pick1 ? c1y : c2y);
+        const float vz = pick0 ? c0z : (pick1 ? c1z : c2z);
+        const float len2 = std::max(l0, std::max(l1, l2));
+        const float inv_len = len2 > 0.0f ? 1.0f / std::sqrt(len2) : 0.0f;
+        nx[l] = vx * inv_len;
+        ny[l] = vy * inv_len;
+        nz[l] = vz * inv_len;
+        const float trace = 3.0f * shift[l];
+        curvature[l] = trace > 0.0f ? std::abs((shift[l] + p * beta[l]) / trace) : 0.0f;
+    }
+    //最小的两个特征值相同(如直线上的点)时叉积都为 0，取与最长的行正交的任意方向
+    for (int l = 0; l < kLanes; ++l) {
+        if (nx[l] != 0.0f || ny[l] != 0.0f || nz[l] != 0.0f)
+            continue;
+        const Eigen::Vector3f rows[3] = {Eigen::Vector3f(xx[l] - shift[l] - scale[l] * beta[l], xy[l], xz[l]),
+                                         Eigen::Vector3f(xy[l], yy[l] - shift[l] - scale[l] * beta[l], yz[l]),
+                                         Eigen::Vector3f(xz[l], yz[l], zz[l] - shift[l] - scale[l] * beta[l])};
+        int longest = 0;
+        for (int i = 1; i < 3; ++i)
+            if (rows[i].squaredNorm() > rows[longest].squaredNorm())
+                longest = i;
+        const Eigen::Vector3f v = rows[longest].squaredNorm() > 0.0f ? rows[longest].unitOrthogonal()
+                                                                     : Eigen::Vector3f::UnitZ();
+        nx[l] = v[0];
+        ny[l] = v[1];
+        nz[l] = v[2];
+    }
+}
+
+//以查询点为原点累加前 found 个邻居的矩，避免大坐标下的抵消误差；有效邻居少于 3 个时返回 false，不加入 batch
+template<typename PointT>
+bool
+accumulateNormalCovariance(const PointT &query, const pcl::PointCloud<PointT> &surface,
+                           const std::vector<int> &nn_indices, int found, NormalCovarianceBatch &batch, int id) {
+    float sx = 0.0f, sy = 0.0f, sz = 0.0f, sxx = 0.0f, sxy = 0.0f, sxz = 0.0f, syy = 0.0f, syz = 0.0f, szz = 0.0f;
+    int count = 0;
+    for (int i = 0; i < found; ++i) {
+        const PointT &p = surface.points[nn_indices[i]];
+        const float x = p.x - query.x, y = p.y - query.y, z = p.z - query.z;
+        if (!std::isfinite(x) || !std::isfinite(y) || !std::isfinite(z))
+            continue;
+        sx += x;
+        sy += y;
+        sz += z;
+        sxx += x * x;
+        sxy += x * y;
+        sxz += x * z;
+        syy += y * y;
+        syz += y * z;
+        szz += z * z;
+        ++count;
+    }
+    if (count < 3)
+        return false;
+    const float inv = 1.0f / static_cast<float>(count);
+    const float mx = sx * inv, my = sy * inv, mz = sz * inv;
+    const int l = batch.size++;
+    batch.xx[l] = sxx * inv - mx * mx;
+    batch.xy[l] = sxy * inv - mx * my;
+    batch.xz[l] = sxz * inv - mx * mz;
+    batch.yy[l] = syy * inv - my * my;
+    batch.yz[l] = syz * inv - my * mz;
+    batch.zz[l] = szz * inv - mz * mz;
+    batch.px[l] = query.x;
+    batch.py[l] = query.y;
+    batch.pz[l] = query.z;
+    batch.id[l] = id;
+    return true;
+}
+
+//求 batch 中各邻域的法线并朝向视点(与 flipNormalTowardsViewpoint 相同)，sink(id, nx, ny, nz, curvature) 接收结果，之后清空 batch
+template<typename Sink>
+void
+solveNormalBatch(NormalCovarianceBatch &batch, float vpx, float vpy, float vpz, Sink &sink) {
+    const int kLanes = NormalCovarianceBatch::kLanes;
+    if (batch.size == 0)
+        return;
+    //不满一批时用第一个邻域补齐，补齐的结果丢弃
+    for (int l = batch.size; l < kLanes; ++l) {
+        batch.xx[l] = batch.xx[0];
+        batch.xy[l] = batch.xy[0];
+        batch.xz[l] = batch.xz[0];
+        batch.yy[l] = batch.yy[0];
+        batch.yz[l] = batch.yz[0];
+        batch.zz[l] = batch.zz[0];
+    }
+    float nx[kLanes], ny[kLanes], nz[kLanes], curvature[kLanes];
+    solveSmallestEigen(batch.xx, batch.xy, batch.xz, batch.yy, batch.yz, batch.zz, nx, ny, nz, curvature);
+    for (int l = 0; l < batch.size; ++l) {
+        if ((vpx - batch.px[l]) * nx[l] + (vpy - batch.py[l]) * ny[l] + (vpz - batch.pz[l]) * nz[l] < 0.0f) {
+            nx[l] = -nx[l];
+            ny[l] = -ny[l];
+            nz[l] = -nz[l];
+        }
+        sink(batch.id[l], nx[l], ny[l], nz[l], curvature[l]);
+    }
+    batch.size = 0;
+}
+
+template<typename PointInT, typename PointOutT>
+class NormalEstimationBatch : public pcl::NormalEstimation<PointInT, PointOutT> {
+public:
+    typedef typename pcl::NormalEstimation<PointInT, PointOutT>::PointCloudOut PointCloudOut;
+
+    NormalEstimationBatch() : nr_threads_(0) {
+        this->feature_name_ = "NormalEstimationBatch";
+    }
+
+    //线程数，0 表示使用全部硬件线程
+    void setNumberOfThreads(int nr_threads) { nr_threads_ = nr_threads; }
+
+    static const int kLanes = NormalCovarianceBatch::kLanes;    //每批的邻域个数
+
+    /**
+     * 与 compute 相同，但直接输出八面体编码的 32 位法线(不保存曲率)，不生成 pcl::Normal 点云。
+     * packed[i] 对应 indices 中的第 i 个点，无效的点为 kInvalidPackedNormal。
+     */
+    void
+    computePacked(std::vector<PackedNormal> &packed) {
+        if (!this->initCompute()) {
+            packed.clear();
+            return;
+        }
+        PackedNormal invalid;
+        invalid.data = kInvalidPackedNormal;
+        packed.assign(indices_->size(), invalid);
+        forEachNormal([&](int idx, float nx, float ny, float nz, float) {
+            packed[idx] = packNormal(nx, ny, nz);
+        });
+        this->deinitCompute();
+    }
+
+protected:
+    using pcl::NormalEstimation<PointInT, PointOutT>::indices_;
+    using pcl::NormalEstimation<PointInT, PointOutT>::input_;
+    using pcl::NormalEstimation<PointInT, PointOutT>::surface_;
+    using pcl::NormalEstimation<PointInT, PointOutT>::search_parameter_;
+    using pcl::NormalEstimation<PointInT, PointOutT>::vpx_;
+    using pcl::NormalEstimation<PointInT, PointOutT>::vpy_;
+    using pcl::NormalEstimation<PointInT, PointOutT>::vpz_;
+
+    void
+    computeFeature(PointCloudOut &output) override {
+        const int n = static_cast<int>(indices_->size());
+        const float nan = std::numeric_limits<float>::quiet_NaN();
+        std::vector<char> valid(n, 0);
+        forEachNormal([&](int idx, float nx, float ny, float nz, float curvature) {
+            output.points[idx].normal_x = nx;
+            output.points[idx].normal_y = ny;
+            output.points[idx].normal_z = nz;
+            output.points[idx].curvature = curvature;
+            valid[idx] = 1;
+        });
+
+        output.is_dense = true;
+        for (int idx = 0; idx < n; ++idx) {
+            if (valid[idx])
+                continue;
+            output.points[idx].normal_x = output.points[idx].normal_y = output.points[idx].normal_z = nan;
+            output.points[idx].curvature = nan;
+            output.is_dense = false;
+        }
+    }
+
+    //在所有线程上求每个有效邻域的法线，sink(idx, nx, ny, nz, curvature) 接收结果(已朝向视点)
+    template<typename Sink>
+    void
+    forEachNormal(Sink sink) {
+        const int n = static_cast<int>(indices_->size());
+        parallelForChunks(0, n, [&](int, int begin, int end) {
+            std::vector<int> nn_indices;
+            std::vector<float> nn_dists;
+            NormalCovarianceBatch batch;
+            batch.size = 0;
+            for (int idx = begin; idx < end; ++idx) {
+                const PointInT &query = (*input_)[(*indices_)[idx]];
+                if (!std::isfinite(query.x) || !std::isfinite(query.y) || !std::isfinite(query.z) ||
+                    this->searchForNeighbors((*indices_)[idx], search_parameter_, nn_indices, nn_dists) < 3)
+                    continue;
+                if (accumulateNormalCovariance(query, *surface_, nn_indices, static_cast<int>(nn_indices.size()), batch,
+                                               idx) && batch.size == kLanes)
+                    solveNormalBatch(batch, vpx_, vpy_, vpz_, sink);
+            }
+            solveNormalBatch(batch, vpx_, vpy_, vpz_, sink);
+        }, nr_threads_);
+    }
+
+    int nr_threads_;
+};
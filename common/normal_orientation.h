@@ -0,0 +1,339 @@
+/*
+ * 法线方向一致化(最小生成树传播)
+ * NormalEstimation 只按固定视点翻转法线，多视角拼接的点云(如 room_scan1 + room_scan2)中，同一曲面上的法线
+ * 会一半朝里一半朝外。NormalOrientation 在邻域图上按 Hoppe 的方法传播方向：
+ *   - 边权 1 - |n_i·n_j|，取邻域图中每个点的前 K 个邻居(按无向边处理)；可以直接使用已建好的 NeighborhoodGraph；
+ *   - 最小生成森林用并行 Borůvka 求：每轮各连通分量用原子 min 选出权最小的出边(权相同时按目标分量的编号，
+ *     保证不成环)，挂到目标分量上，再用指针跳跃压缩；分量内部的边扫描时删去，轮数不超过 log2(点数)；
+ *   - 方向在合并时一起传播：每个点记录相对所在分量根的翻转奇偶性，挂接时由连接边 (v,u) 算出两个根之间的奇偶性，
+ *     指针跳跃时沿路径异或，不需要串行的 BFS；
+ *   - 最后每个连通分量按视点投票决定整体方向(多数点朝向视点)。
+ * 法线或坐标无效的点不参与，保持原值。
+ */
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <limits>
+#include <memory>
+#include <vector>
+
+#include <pcl/point_cloud.h>
+#include <pcl/point_types.h>
+
+#include "neighborhood_graph.h"
+#include "parallel.h"
+
+template<typename PointT, typename NormalT>
+class NormalOrientation {
+public:
+    typedef typename pcl::PointCloud<PointT>::ConstPtr PointCloudConstPtr;
+    typedef typename NeighborhoodGraph<PointT>::ConstPtr GraphConstPtr;
+
+    NormalOrientation()
+            : max_neighbors_(8), vpx_(0.0f), vpy_(0.0f), vpz_(0.0f), nr_threads_(0), nr_components_(0),
+              nr_flipped_(0), nr_rounds_(0), normals_(nullptr), n_(0) {}
+
+    //未设置邻域图时，按 K 近邻自己建图
+    void setInputCloud(const PointCloudConstPtr &cloud) { cloud_ = cloud; }
+
+    //使用已建好的邻域图(其输入点云即法线对应的点云)
+    void
+    setNeighborhoodGraph(const GraphConstPtr &graph) {
+        graph_ = graph;
+        cloud_ = graph->getInputCloud();
+    }
+
+    //每个点取图中前 K 个邻居作为边(不含自身)
+    void setMaxNeighbors(int k) { max_neighbors_ = k; }
+
+    //每个连通分量按这个视点投票决定整体方向
+    void
+    setViewPoint(float vpx, float vpy, float vpz) {
+        vpx_ = vpx;
+        vpy_ = vpy;
+        vpz_ = vpz;
+    }
+
+    //线程数，0 表示使用全部硬件线程
+    void setNumberOfThreads(int nr_threads) { nr_threads_ = nr_threads; }
+
+    //原地翻转 normals(与点云一一对应)，返回连通分量个数
+    int
+    orient(pcl::PointCloud<NormalT> &normals) {
+        nr_components_ = nr_flipped_ = nr_rounds_ = 0;
+        if (!graph_) {
+            typename NeighborhoodGraph<PointT>::Ptr graph(new NeighborhoodGraph<PointT>);
+            graph->setNumberOfThreads(nr_threads_);
+            graph->buildKNN(cloud_, max_neighbors_ + 1);
+            graph_ = graph;
+        }
+        n_ = static_cast<int>(normals.points.size());
+        if (n_ == 0 || static_cast<int>(cloud_->points.size()) != n_ || static_cast<int>(graph_->size()) != n_)
+            return 0;
+        normals_ = &normals;
+        buildEdges();
+        spanningForest();
+        orientComponents();
+        normals_ = nullptr;
+        return nr_components_;
+    }
+
+    int getNumberOfComponents() const { return nr_components_; }
+
+    //相对输入被翻转的法线个数
+    int getNumberOfFlipped() const { return nr_flipped_; }
+
+    //Borůvka 的轮数
+    int getNumberOfRounds() const { return nr_rounds_; }
+
+protected:
+    static const std::uint64_t kNone = std::numeric_limits<std::uint64_t>::max();
+
+    bool
+    isValid(int i) const {
+        const NormalT &n = normals_->points[i];
+        const PointT &p = cloud_->points[i];
+        return std::isfinite(n.normal_x) && std::isfinite(n.normal_y) && std::isfinite(n.normal_z) &&
+               std::isfinite(p.x) && std::isfinite(p.y) && std::isfinite(p.z);
+    }
+
+    float
+    dot(int i, int j) const {
+        const NormalT &a = normals_->points[i], &b = normals_->points[j];
+        return a.normal_x * b.normal_x + a.normal_y * b.normal_y + a.normal_z * b.normal_z;
+    }
+
+    //边权 1 - |n_v·n_u| 左移 32 位：权为非负 float，位模式与大小顺序一致
+    std::uint64_t
+    edgeWeight(int v, int u) const {
+        const float weight = std::max(0.0f, 1.0f - std::abs(dot(v, u)));
+        std::uint32_t bits;
+        std::memcpy(&bits, &weight, sizeof(bits));
+        return static_cast<std::uint64_t>(bits) << 32;
+    }
+
+    //分量选边的键：高 32 位为权，低 32 位为目标分量
+    static std::uint64_t
+    edgeKey(std::uint64_t weight, int target) {
+        return weight | static_cast<std::uint32_t>(target);
+    }
+
+    static std::uint64_t
+    edgeCode(int from, int to) {
+        return (static_cast<std::uint64_t>(from) << 32) | static_cast<std::uint32_t>(to);
+    }
+
+    static void
+    atomicMin(std::atomic<std::uint64_t> &target, std::uint64_t value) {
+        std::uint64_t current = target.load(std::memory_order_relaxed);
+        while (value < current && !target.compare_exchange_weak(current, value, std::memory_order_relaxed)) {}
+    }
+
+    //图中每个有效点的前 max_neighbors_ 个有效邻居，复制成可以原地删边的 CSR。
+    //K 近邻图不对称，边 (v, u) 在扫描时同时作为 v 与 u 所在分量的出边，相当于无向图
+    void
+    buildEdges() {
+        valid_.assign(n_, 0);
+        parallelFor(0, n_, [&](int i) { valid_[i] = isValid(i) ? 1 : 0; }, nr_threads_);
+        auto forEachEdge = [&](int v, auto visit) {
+            if (!valid_[v])
+                return;
+            const int *neighbors = graph_->neighbors(v);
+            const int count = graph_->degree(v);
+            int taken = 0;
+            for (int j = 0; j < count && taken < max_neighbors_; ++j) {
+                const int u = neighbors[j];
+                if (u == v || !valid_[u])
+                    continue;
+                ++taken;
+                visit(u);
+            }
+        };
+        std::vector<int> counts(n_, 0);
+        parallelFor(0, n_, [&](int v) { forEachEdge(v, [&](int) { ++counts[v]; }); }, nr_threads_);
+        adjacency_offsets_.assign(n_ + 1, 0);
+        for (int i = 0; i < n_; ++i)
+            adjacency_offsets_[i + 1] = adjacency_offsets_[i] + counts[i];
+        adjacency_.resize(adjacency_offsets_[n_]);
+        parallelFor(0, n_, [&](int v) {
+            std::size_t position = adjacency_offsets_[v];
+            forEachEdge(v, [&](int u) { adjacency_[position++] = u; });
+        }, nr_threads_);
+    }
+
+    void
+    spanningForest() {
+        //label_[v]：v 所在分量的根；parity_[v]：v 相对根的翻转奇偶性
+        label_.resize(n_);
+        parity_.assign(n_, 0);
+        parallelFor(0, n_, [&](int i) { label_[i] = i; }, nr_threads_);
+        //row_end[v]：v 的邻接表中仍指向其它分量的边的末尾，分量内部的边扫描时删去，之后各轮只看剩下的边
+        std::vector<std::size_t> row_end(adjacency_offsets_.begin() + 1, adjacency_offsets_.end());
+        //当前的分量(根)
+        std::vector<int> components;
+        components.reserve(n_);
+        for (int i = 0; i < n_; ++i)
+            if (valid_[i])
+                components.push_back(i);
+        std::unique_ptr<std::atomic<std::uint64_t>[]> best(new std::atomic<std::uint64_t>[n_]);
+        std::unique_ptr<std::atomic<std::uint64_t>[]> edge(new std::atomic<std::uint64_t>[n_]);
+        std::vector<int> parent(n_), next_parent(n_);
+        std::vector<unsigned char> relative(n_), next_relative(n_);
+        while (true) {
+            const int nr_components = static_cast<int>(components.size());
+            parallelFor(0, nr_components, [&](int k) {
+                best[components[k]].store(kNone, std::memory_order_relaxed);
+                edge[components[k]].store(kNone, std::memory_order_relaxed);
+            }, nr_threads_);
+            //每个分量权最小的出边
+            std::atomic<bool> found(false);
+            parallelForChunks(0, n_, [&](int, int begin, int end) {
+                bool local_found = false;
+                for (int v = begin; v < end; ++v) {
+                    const int cv = label_[v];
+                    std::size_t kept = adjacency_offsets_[v];
+                    for (std::size_t j = adjacency_offsets_[v]; j < row_end[v]; ++j) {
+                        const int u = adjacency_[j];
+                        const int cu = label_[u];
+                        if (cu == cv)
+                            continue;
+                        adjacency_[kept++] = u;
+                        const std::uint64_t weight = edgeWeight(v, u);
+                        atomicMin(best[cv], edgeKey(weight, cu));
+                        atomicMin(best[cu], edgeKey(weight, cv));
+                    }
+                    row_end[v] = kept;
+                    local_found = local_found || kept > adjacency_offsets_[v];
+                }
+                if (local_found)
+                    found.store(true, std::memory_order_relaxed);
+            }, nr_threads_);
+            if (!found.load())
+                break;
+            ++nr_rounds_;
+            //达到最小键的边中取 (v, u) 编码最小的一条，结果与线程数无关
+            parallelFor(0, n_, [&](int v) {
+                if (row_end[v] == adjacency_offsets_[v])
+                    return;
+                const int cv = label_[v];
+                const std::uint64_t key = best[cv].load(std::memory_order_relaxed);
+                for (std::size_t j = adjacency_offsets_[v]; j < row_end[v]; ++j) {
+                    const int u = adjacency_[j];
+                    const int cu = label_[u];
+                    const std::uint64_t weight = edgeWeight(v, u);
+                    if (edgeKey(weight, cu) == key)
+                        atomicMin(edge[cv], edgeCode(v, u));
+                    if (edgeKey(weight, cv) == best[cu].load(std::memory_order_relaxed))
+                        atomicMin(edge[cu], edgeCode(u, v));
+                }
+            }, nr_threads_);
+            //挂接：分量挂到目标分量上；互相选中的两个分量中编号小的作根
+            parallelFor(0, nr_components, [&](int k) {
+                const int c = components[k];
+                parent[c] = c;
+                relative[c] = 0;
+                const std::uint64_t key = best[c].load(std::memory_order_relaxed);
+                if (key == kNone)
+                    return;
+                const int d = static_cast<int>(key & 0xffffffffu);
+                const std::uint64_t back = best[d].load(std::memory_order_relaxed);
+                if (back != kNone && static_cast<int>(back & 0xffffffffu) == c && c < d)
+                    return;
+                const std::uint64_t e = edge[c].load(std::memory_order_relaxed);
+                const int v = static_cast<int>(e >> 32), u = static_cast<int>(e & 0xffffffffu);
+                parent[c] = d;
+                relative[c] = parity_[v] ^ parity_[u] ^ (dot(v, u) < 0.0f ? 1 : 0);
+            }, nr_threads_);
+            //指针跳跃，直到都指向根；奇偶性沿路径累加
+            while (true) {
+                std::atomic<bool> changed(false);
+                parallelFor(0, nr_components, [&](int k) {
+                    const int c = components[k];
+                    const int p = parent[c];
+                    next_parent[c] = parent[p];
+                    next_relative[c] = relative[c] ^ relative[p];
+                    if (next_parent[c] != p)
+                        changed.store(true, std::memory_order_relaxed);
+                }, nr_threads_);
+                parallelFor(0, nr_components, [&](int k) {
+                    const int c = components[k];
+                    parent[c] = next_parent[c];
+                    relative[c] = next_relative[c];
+                }, nr_threads_);
+                if (!changed.load())
+                    break;
+            }
+            parallelFor(0, n_, [&](int v) {
+                if (!valid_[v])
+                    return;
+                const int c = label_[v];
+                parity_[v] ^= relative[c];
+                label_[v] = parent[c];
+            }, nr_threads_);
+            components.erase(std::remove_if(components.begin(), components.end(),
+                                            [&](int c) { return parent[c] != c; }), components.end());
+        }
+    }
+
+    //每个分量按视点投票，多数点背离视点时整体翻转
+    void
+    orientComponents() {
+        std::vector<signed char> vote(n_, 0);
+        parallelFor(0, n_, [&](int v) {
+            if (!valid_[v])
+                return;
+            const NormalT &n = normals_->points[v];
+            const PointT &p = cloud_->points[v];
+            const float d = (vpx_ - p.x) * n.normal_x + (vpy_ - p.y) * n.normal_y + (vpz_ - p.z) * n.normal_z;
+            vote[v] = static_cast<signed char>((d >= 0.0f) != (parity_[v] != 0) ? 1 : -1);
+        }, nr_threads_);
+        std::vector<long long> votes(n_, 0);
+        for (int v = 0; v < n_; ++v) {
+            if (!valid_[v])
+                continue;
+            votes[label_[v]] += vote[v];
+            if (label_[v] == v)
+                ++nr_components_;
+        }
+        std::atomic<int> flipped(0);
+        parallelForChunks(0, n_, [&](int, int begin, int end) {
+            int local = 0;
+            for (int v = begin; v < end; ++v) {
+                if (!valid_[v])
+                    continue;
+                const bool flip = (votes[label_[v]] < 0) != (parity_[v] != 0);
+                if (!flip)
+                    continue;
+                NormalT &n = normals_->points[v];
+                n.normal_x = -n.normal_x;
+                n.normal_y = -n.normal_y;
+                n.normal_z = -n.normal_z;
+                ++local;
+            }
+            flipped.fetch_add(local);
+        }, nr_threads_);
+        nr_flipped_ = flipped.load();
+    }
+
+    PointCloudConstPtr cloud_;
+    GraphConstPtr graph_;
+    int max_neighbors_;
+    float vpx_, vpy_, vpz_;
+    int nr_threads_;
+    int nr_components_;
+    int nr_flipped_;
+    int nr_rounds_;
+
+    //以下为 orient 期间的临时数据
+    pcl::PointCloud<NormalT> *normals_;
+    int n_;
+    std::vector<unsigned char> valid_;
+    std::vector<std::size_t> adjacency_offsets_;
+    std::vector<int> adjacency_;
+    std::vector<int> label_;
+    std::vector<unsigned char> parity_;
+};
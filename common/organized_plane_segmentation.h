@@ -0,0 +1,93 @@
+/*
+ * 有序点云(如 640x480 的 RGB-D 点云)的多平面分割
+ * 利用图像上的邻接关系代替 kd-tree：积分图计算法线，再按法线夹角与到平面距离做连通域生长，
+ * 一次线性扫描得到所有平面及其系数(pcl::IntegralImageNormalEstimation + pcl::OrganizedMultiPlaneSegmentation)。
+ */
+#pragma once
+
+#include <algorithm>
+#include <vector>
+
+#include <pcl/ModelCoefficients.h>
+#include <pcl/PointIndices.h>
+#include <pcl/common/angles.h>
+#include <pcl/features/integral_image_normal.h>
+#include <pcl/point_cloud.h>
+#include <pcl/point_types.h>
+#include <pcl/segmentation/organized_multi_plane_segmentation.h>
+
+#include "integral_image_normal_parallel.h"
+
+template<typename PointT>
+class OrganizedPlaneExtractor {
+public:
+    typedef typename pcl::PointCloud<PointT>::ConstPtr PointCloudConstPtr;
+
+    struct Parameters {
+        float max_depth_change_factor;      //积分图法线：深度跳变超过该比例时不跨越
+        float normal_smoothing_size;        //积分图法线的平滑窗口(像素)
+        unsigned int min_inliers;           //平面的最少点数
+        double angular_threshold;           //相邻点法线夹角阈值(弧度)
+        double distance_threshold;          //相邻点到平面的距离阈值(米)
+        double maximum_curvature;           //曲率大于该值的点不参与平面生长
+
+        Parameters()
+                : max_depth_change_factor(0.02f), normal_smoothing_size(10.0f), min_inliers(1000),
+                  angular_threshold(pcl::deg2rad(3.0)), distance_threshold(0.02), maximum_curvature(0.001) {}
+    };
+
+    OrganizedPlaneExtractor() : normals_(new pcl::PointCloud<pcl::Normal>) {}
+
+    Parameters &getParameters() { return parameters_; }
+
+    void setInputCloud(const PointCloudConstPtr &cloud) { input_ = cloud; }
+
+    //compute 之后的法线，与输入点云同样是有序的，无效点为 NaN
+    pcl::PointCloud<pcl::Normal>::Ptr getNormals() const { return normals_; }
+
+    /**
+     * 计算法线并分割所有平面，按内点数从多到少排序。输入不是有序点云时返回 false。
+     */
+    bool
+    compute(std::vector<pcl::ModelCoefficients> &model_coefficients, std::vector<pcl::PointIndices> &inliers) {
+        model_coefficients.clear();
+        inliers.clear();
+        if (!input_ || !input_->isOrganized())
+            return false;
+
+        IntegralImageNormalEstimationParallel<PointT, pcl::Normal> ne;
+        ne.setNormalEstimationMethod(ne.AVERAGE_3D_GRADIENT);
+        ne.setMaxDepthChangeFactor(parameters_.max_depth_change_factor);
+        ne.setNormalSmoothingSize(parameters_.normal_smoothing_size);
+        ne.setInputCloud(input_);
+        ne.compute(*normals_);
+
+        pcl::OrganizedMultiPlaneSegmentation<PointT, pcl::Normal, pcl::Label> mps;
+        mps.setMinInliers(parameters_.min_inliers);
+        mps.setAngularThreshold(parameters_.angular_threshold);
+        mps.setDistanceThreshold(parameters_.distance_threshold);
+        mps.setMaximumCurvature(parameters_.maximum_curvature);
+        mps.setInputNormals(normals_);
+        mps.setInputCloud(input_);
+        std::vector<pcl::ModelCoefficients> coefficients;
+        std::vector<pcl::PointIndices> indices;
+        mps.segment(coefficients, indices);
+
+        std::vector<std::size_t> order(indices.size());
+        for (std::size_t i = 0; i < order.size(); ++i)
+            order[i] = i;
+        std::stable_sort(order.begin(), order.end(), [&indices](std::size_t a, std::size_t b) {
+            return indices[a].indices.size() > indices[b].indices.size();
+        });
+        for (std::size_t i: order) {
+            model_coefficients.push_back(coefficients[i]);
+            inliers.push_back(indices[i]);
+        }
+        return true;
+    }
+
+protected:
+    PointCloudConstPtr input_;
+    pcl::PointCloud<pcl::Normal>::Ptr normals_;
+    Parameters parameters_;
+};
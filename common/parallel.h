@@ -0,0 +1,78 @@
+/*
+ * 多线程辅助函数（std::thread，不依赖 OpenMP 编译选项）
+ */
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <thread>
+#include <vector>
+
+//返回实际使用的线程数，requested<=0 时使用硬件线程数
+inline unsigned int
+getNumberOfThreads(int requested = 0) {
+    if (requested > 0)
+        return static_cast<unsigned int>(requested);
+    unsigned int hw = std::thread::hardware_concurrency();
+    return hw == 0 ? 1u : hw;
+}
+
+//把 [begin, end) 切成 nr_threads 段连续区间，每段调用 f(thread_id, chunk_begin, chunk_end)
+//分段方式只取决于区间长度与线程数，便于每个线程使用自己的缓冲区再合并
+template<typename Function>
+void
+parallelForChunks(int begin, int end, Function f, int nr_threads = 0) {
+    const int n = end - begin;
+    if (n <= 0)
+        return;
+    const int threads = static_cast<int>(std::min<unsigned int>(getNumberOfThreads(nr_threads),
+                                                                 static_cast<unsigned int>(n)));
+    if (threads <= 1) {
+        f(0, begin, end);
+        return;
+    }
+    std::vector<std::thread> workers;
+    workers.reserve(threads - 1);
+    for (int t = 1; t < threads; ++t) {
+        int chunk_begin = begin + static_cast<int>(static_cast<long long>(n) * t / threads);
+        int chunk_end = begin + static_cast<int>(static_cast<long long>(n) * (t + 1) / threads);
+        workers.emplace_back(f, t, chunk_begin, chunk_end);
+    }
+    f(0, begin, begin + n / threads);
+    for (std::thread &worker: workers)
+        worker.join();
+}
+
+//逐元素的并行循环，f(i)
+template<typename Function>
+void
+parallelFor(int begin, int end, Function f, int nr_threads = 0) {
+    parallelForChunks(begin, end, [&f](int, int chunk_begin, int chunk_end) {
+        for (int i = chunk_begin; i < chunk_end; ++i)
+            f(i);
+    }, nr_threads);
+}
+
+//动态分配的并行循环：各线程每次从共享计数器取下一个下标，f(thread_id, i)。
+//适合每个元素耗时差别大的情形；元素由哪个线程处理不确定，f 的结果不能依赖 thread_id
+template<typename Function>
+void
+parallelForDynamic(int begin, int end, Function f, int nr_threads = 0) {
+    const int n = end - begin;
+    if (n <= 0)
+        return;
+    const int threads = static_cast<int>(std::min<unsigned int>(getNumberOfThreads(nr_threads),
+                                                                 static_cast<unsigned int>(n)));
+    std::atomic<int> next(begin);
+    auto worker = [&f, &next, end](int thread_id) {
+        for (int i = next.fetch_add(1); i < end; i = next.fetch_add(1))
+            f(thread_id, i);
+    };
+    std::vector<std::thread> workers;
+    workers.reserve(threads - 1);
+    for (int t = 1; t < threads; ++t)
+        workers.emplace_back(worker, t);
+    worker(0);
+    for (std::thread &w: workers)
+        w.join();
+}
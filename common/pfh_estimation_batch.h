@@ -0,0 +1,487 @@
+/*
+ * 多线程、SIMD 的 PFH，可选并发的点对缓存
+ * pcl::PFHEstimation 对每个邻域的全部 O(k²) 个点对逐个调用 computePairFeatures(Eigen、acos、atan2)，单线程，
+ * PCL 自带的点对缓存(setUseInternalCache)是 std::map 加先进先出队列，查一次比算一次还慢。
+ * PFHEstimationBatch 继承它，用法相同(setInputCloud、setInputNormals、setSearchMethod、setRadiusSearch、compute)：
+ *   - 查询点按段在多个线程上计算；
+ *   - 每个邻域的有效点先复制成 SoA，点 i 与它之前的点 j 按 4 个一组用 SSE2 一起求 Darboux 坐标系与三个角度，
+ *     连续读取，不需要逐对收集数据；atan2 用多项式，无分支；
+ *   - 点对总按 (下标小, 下标大) 的顺序计算，结果与线程数、是否使用缓存无关。与 PCL 的差别：
+ *     法线无效(NaN)的点对跳过，PCL 把它们计入 0 号格子；atan2 多项式的误差约 1e-5 rad，恰好在格子边界上的点对
+ *     可能落入相邻的格子；|cos| 恰好相等时源点/目标点的选择可能与 PCL 相反。
+ * setUseInternalCache(true) 时点对落入的直方图格子存入 PairFeatureCache(组相联、组内 LRU，多线程共用，
+ * 条数由 setMaximumCacheSize 限定，默认 1<<20 条，16MB)；输入点云与法线不变时多次 compute
+ * (如 computeQuantizedFeatures 分块计算)共用缓存。SIMD 计算一个点对只需几十个周期，实测缓存命中并不比重算快，
+ * 默认与 PCL 一样不使用缓存；点对计算更贵(如不支持 SSE2 的平台)时可以打开。
+ */
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <cstdint>
+#include <limits>
+#include <memory>
+#include <vector>
+
+#include <pcl/features/pfh.h>
+#include <pcl/point_cloud.h>
+#include <pcl/point_types.h>
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+#include "parallel.h"
+
+/**
+ * 点对 -> 直方图格子的并发缓存，组相联：每组 kWays 条，组内按 LRU 淘汰，每组一个自旋锁，正好占一条 64 字节缓存行。
+ * 点对 (p, q) 所在的组由较小的下标 p 决定一段连续的组(kSetsPerPoint 个)，再由 q 的哈希在其中选一组。
+ * 相邻的查询点邻域重叠，访问集中在少数几段组上，大多在 CPU 缓存中命中(全局的哈希表每次查询都是一次随机访存)。
+ */
+class PairFeatureCache {
+public:
+    static const int kWays = 4;
+    static const int kSetsPerPoint = 8;
+
+    PairFeatureCache() : capacity_(0), mask_(0) {}
+
+    //capacity 为最多缓存的点对数，向上取整到 2 的幂
+    void
+    reset(std::size_t capacity) {
+        capacity_ = capacity;
+        std::size_t nr_sets = kSetsPerPoint;
+        while (nr_sets * kWays < capacity)
+            nr_sets <<= 1;
+        sets_.reset(new Set[nr_sets]);
+        for (std::size_t i = 0; i < nr_sets; ++i) {
+            Set &set = sets_[i];
+            for (int w = 0; w < kWays; ++w) {
+                set.key[w] = kEmpty;
+                set.bin[w] = -1;
+                set.rank[w] = static_cast<std::uint8_t>(w);
+            }
+            set.lock.clear();
+        }
+        mask_ = nr_sets - 1;
+    }
+
+    std::size_t capacity() const { return capacity_; }
+
+    //命中时把该条移到组内最近使用的位置
+    bool
+    find(std::uint64_t key, std::int16_t &bin) {
+        Set &set = sets_[setIndex(key)];
+        lock(set);
+        for (int w = 0; w < kWays; ++w) {
+            if (set.key[w] != key)
+                continue;
+            touch(set, w);
+            bin = set.bin[w];
+            set.lock.clear(std::memory_order_release);
+            return true;
+        }
+        set.lock.clear(std::memory_order_release);
+        return false;
+    }
+
+    //组满时替换最久未用的一条
+    void
+    insert(std::uint64_t key, std::int16_t bin) {
+        Set &set = sets_[setIndex(key)];
+        lock(set);
+        int victim = 0;
+        for (int w = 0; w < kWays; ++w) {
+            //其它线程可能刚插入了同一点对
+            if (set.key[w] == key) {
+                victim = -1;
+                break;
+            }
+            if (set.rank[w] > set.rank[victim])
+                victim = w;
+        }
+        if (victim >= 0) {
+            set.key[victim] = key;
+            set.bin[victim] = bin;
+            touch(set, victim);
+        }
+        set.lock.clear(std::memory_order_release);
+    }
+
+protected:
+    //p < q，p 与 q 都不为 0xffffffff，不会与空标记冲突
+    static const std::uint64_t kEmpty = ~std::uint64_t(0);
+
+    struct alignas(64) Set {
+        std::uint64_t key[kWays];
+        std::int16_t bin[kWays];
+        //0 为最近使用
+        std::uint8_t rank[kWays];
+        std::atomic_flag lock;
+    };
+
+    std::size_t
+    setIndex(std::uint64_t key) const {
+        const std::uint64_t p = key >> 32;
+        //q 的低位乘以奇数后取高位
+        const std::uint64_t q = (static_cast<std::uint32_t>(key) * 0x9e3779b1u) >> 29;
+        return static_cast<std::size_t>(p * kSetsPerPoint + (q & (kSetsPerPoint - 1))) & mask_;
+    }
+
+    static void
+    lock(Set &set) {
+        while (set.lock.test_and_set(std::memory_order_acquire)) {}
+    }
+
+    static void
+    touch(Set &set, int way) {
+        const std::uint8_t rank = set.rank[way];
+        for (int w = 0; w < kWays; ++w)
+            if (set.rank[w] < rank)
+                ++set.rank[w];
+        set.rank[way] = 0;
+    }
+
+    std::size_t capacity_;
+    std::size_t mask_;
+    std::unique_ptr<Set[]> sets_;
+};
+
+template<typename PointInT, typename PointNT, typename PointOutT = pcl::PFHSignature125>
+class PFHEstimationBatch : public pcl::PFHEstimation<PointInT, PointNT, PointOutT> {
+public:
+    typedef pcl::PFHEstimation<PointInT, PointNT, PointOutT> Base;
+    typedef typename Base::PointCloudOut PointCloudOut;
+
+    PFHEstimationBatch()
+            : nr_threads_(0), hits_(0), misses_(0), cached_surface_(nullptr), cached_normals_(nullptr), cached_subdiv_(0) {
+        this->feature_name_ = "PFHEstimationBatch";
+        this->max_cache_size_ = 1u << 20;
+    }
+
+    //线程数，0 表示使用全部硬件线程
+    void setNumberOfThreads(int nr_threads) { nr_threads_ = nr_threads; }
+
+    //丢弃缓存的点对，下一次 compute 重新建立
+    void clearCache() { cached_surface_ = nullptr; }
+
+    //最近一次 compute 中命中与未命中缓存的点对数
+    long getNumberOfCacheHits() const { return hits_; }
+
+    long getNumberOfCacheMisses() const { return misses_; }
+
+protected:
+    using Base::indices_;
+    using Base::input_;
+    using Base::max_cache_size_;
+    using Base::normals_;
+    using Base::nr_subdiv_;
+    using Base::search_parameter_;
+    using Base::surface_;
+    using Base::use_cache_;
+
+    //一个邻域中有效点的坐标、法线(SoA)与下标，末尾补齐到 4 的倍数
+    struct Neighborhood {
+        std::vector<float> px, py, pz, nx, ny, nz;
+        std::vector<int> index;
+        int size;
+    };
+
+    void
+    computeFeature(PointCloudOut &output) override {
+        //缓存的是格子编号，细分数变化后同一点对落入的格子也不同
+        if (use_cache_ && (cached_surface_ != surface_.get() || cached_normals_ != normals_.get() ||
+                           cached_subdiv_ != nr_subdiv_ || cache_.capacity() != max_cache_size_)) {
+            cache_.reset(max_cache_size_);
+            cached_surface_ = surface_.get();
+            cached_normals_ = normals_.get();
+            cached_subdiv_ = nr_subdiv_;
+        }
+        const int nr_bins = nr_subdiv_ * nr_subdiv_ * nr_subdiv_;
+        const float nan = std::numeric_limits<float>::quiet_NaN();
+        std::atomic<long> hits(0), misses(0);
+        std::atomic<bool> is_dense(true);
+        parallelForChunks(0, static_cast<int>(indices_->size()), [&](int, int begin, int end) {
+            std::vector<int> nn_indices;
+            std::vector<float> nn_dists;
+            std::vector<float> histogram(nr_bins);
+            Neighborhood neighborhood;
+            long local_hits = 0, local_misses = 0;
+            for (int idx = begin; idx < end; ++idx) {
+                float *out = output.points[idx].histogram;
+                if (!pcl::isFinite((*input_)[(*indices_)[idx]]) ||
+                    this->searchForNeighbors((*indices_)[idx], search_parameter_, nn_indices, nn_dists) == 0) {
+                    std::fill(out, out + nr_bins, nan);
+                    is_dense.store(false, std::memory_order_relaxed);
+                    continue;
+                }
+                std::fill(histogram.begin(), histogram.end(), 0.0f);
+                //与 PCL 相同，按全部邻居(含无效点)的点对数归一化
+                const std::size_t m = nn_indices.size();
+                const float increment = 100.0f / static_cast<float>(m * (m - 1) / 2);
+                gather(nn_indices, neighborhood);
+                std::int16_t bins[4];
+                for (int i = 1; i < neighborhood.size; ++i) {
+                    for (int j = 0; j < i; j += 4) {
+                        const int count = std::min(4, i - j);
+                        if (use_cache_)
+                            cachedBins(neighborhood, i, j, count, bins, local_hits, local_misses);
+                        else
+                            pairBins(neighborhood, i, j, bins);
+                        for (int k = 0; k < count; ++k)
+                            if (bins[k] >= 0)
+                                histogram[bins[k]] += increment;
+                    }
+                }
+                std::copy(histogram.begin(), histogram.end(), out);
+            }
+            hits.fetch_add(local_hits);
+            misses.fetch_add(local_misses);
+        }, nr_threads_);
+        output.is_dense = is_dense.load();
+        hits_ = hits.load();
+        misses_ = misses.load();
+    }
+
+    void
+    gather(const std::vector<int> &nn_indices, Neighborhood &neighborhood) const {
+        neighborhood.index.clear();
+        for (int index: nn_indices)
+            if (pcl::isFinite((*surface_)[index]))
+                neighborhood.index.push_back(index);
+        const int size = static_cast<int>(neighborhood.index.size());
+        neighborhood.size = size;
+        if (size == 0)
+            return;
+        //补齐的部分重复最后一个点，结果丢弃
+        const int padded = (size + 3) / 4 * 4;
+        neighborhood.index.resize(padded, neighborhood.index.back());
+        neighborhood.px.resize(padded);
+        neighborhood.py.resize(padded);
+        neighborhood.pz.resize(padded);
+        neighborhood.nx.resize(padded);
+        neighborhood.ny.resize(padded);
+        neighborhood.nz.resize(padded);
+        for (int k = 0; k < padded; ++k) {
+            const PointInT &p = (*surface_)[neighborhood.index[k]];
+            const PointNT &n = (*normals_)[neighborhood.index[k]];
+            neighborhood.px[k] = p.x;
+            neighborhood.py[k] = p.y;
+            neighborhood.pz[k] = p.z;
+            neighborhood.nx[k] = n.normal_x;
+            neighborhood.ny[k] = n.normal_y;
+            neighborhood.nz[k] = n.normal_z;
+        }
+    }
+
+    //先查缓存，4 个点对中有未命中的才计算，并把未命中的写入缓存
+    void
+    cachedBins(const Neighborhood &nb, int i, int j, int count, std::int16_t *bins, long &hits, long &misses) {
+        std::uint64_t keys[4];
+        bool found[4];
+        bool all_found = true;
+        for (int k = 0; k < count; ++k) {
+            const int p = std::min(nb.index[i], nb.index[j + k]), q = std::max(nb.index[i], nb.index[j + k]);
+            keys[k] = (static_cast<std::uint64_t>(p) << 32) | static_cast<std::uint32_t>(q);
+            found[k] = cache_.find(keys[k], bins[k]);
+            all_found = all_found && found[k];
+        }
+        if (all_found) {
+            hits += count;
+            return;
+        }
+        std::int16_t computed[4];
+        pairBins(nb, i, j, computed);
+        for (int k = 0; k < count; ++k) {
+            if (found[k]) {
+                ++hits;
+                continue;
+            }
+            ++misses;
+            bins[k] = computed[k];
+            cache_.insert(keys[k], computed[k]);
+        }
+    }
+
+    /**
+     * 点 i 与点 j..j+3 组成的 4 个点对的直方图格子：与 pcl::computePairFeatures 相同的 (f1, f2, f3)，
+     * 再按 PFHEstimation 的方式映射到 nr_subdiv³ 个格子之一。两点中下标小的作为第一个点。
+     * 两点重合、连线与法线平行(PCL 跳过这样的点对)或法线无效时为 -1。
+     */
+    void
+    pairBins(const Neighborhood &nb, int i, int j, std::int16_t *bins) const {
+        const float splits = static_cast<float>(nr_subdiv_);
+#if defined(__SSE2__)
+        //下标 i 较小的通道，点 i 为第一个点
+        const __m128 first = _mm_castsi128_ps(_mm_cmplt_epi32(
+                _mm_set1_epi32(nb.index[i]), _mm_loadu_si128(reinterpret_cast<const __m128i *>(&nb.index[j]))));
+        const __m128 ix = _mm_set1_ps(nb.px[i]), iy = _mm_set1_ps(nb.py[i]), iz = _mm_set1_ps(nb.pz[i]);
+        const __m128 inx = _mm_set1_ps(nb.nx[i]), iny = _mm_set1_ps(nb.ny[i]), inz = _mm_set1_ps(nb.nz[i]);
+        const __m128 jx = _mm_loadu_ps(&nb.px[j]), jy = _mm_loadu_ps(&nb.py[j]), jz = _mm_loadu_ps(&nb.pz[j]);
+        const __m128 jnx = _mm_loadu_ps(&nb.nx[j]), jny = _mm_loadu_ps(&nb.ny[j]), jnz = _mm_loadu_ps(&nb.nz[j]);
+        std::int32_t result[4];
+        _mm_storeu_si128(reinterpret_cast<__m128i *>(result), pairBins4(
+                select(first, ix, jx), select(first, iy, jy), select(first, iz, jz),
+                select(first, inx, jnx), select(first, iny, jny), select(first, inz, jnz),
+                select(first, jx, ix), select(first, jy, iy), select(first, jz, iz),
+                select(first, jnx, inx), select(first, jny, iny), select(first, jnz, inz), splits));
+        for (int k = 0; k < 4; ++k)
+            bins[k] = static_cast<std::int16_t>(result[k]);
+#else
+        for (int k = 0; k < 4; ++k) {
+            const int a = nb.index[i] < nb.index[j + k] ? i : j + k, b = a == i ? j + k : i;
+            bins[k] = static_cast<std::int16_t>(pairBin(nb.px[a], nb.py[a], nb.pz[a], nb.nx[a], nb.ny[a], nb.nz[a],
+                                                        nb.px[b], nb.py[b], nb.pz[b], nb.nx[b], nb.ny[b], nb.nz[b],
+                                                        splits));
+        }
+#endif
+    }
+
+#if defined(__SSE2__)
+    static __m128
+    select(__m128 mask, __m128 a, __m128 b) { return _mm_or_ps(_mm_and_ps(mask, a), _mm_andnot_ps(mask, b)); }
+
+    static __m128
+    dot(__m128 ax, __m128 ay, __m128 az, __m128 bx, __m128 by, __m128 bz) {
+        return _mm_add_ps(_mm_add_ps(_mm_mul_ps(ax, bx), _mm_mul_ps(ay, by)), _mm_mul_ps(az, bz));
+    }
+
+    //max(NaN, 0) 为 0；先截到 [0, nr_subdiv-1] 再截断取整，与 floor 后截断相同
+    static __m128
+    binIndex(__m128 value, __m128 last) {
+        return _mm_cvtepi32_ps(_mm_cvttps_epi32(_mm_min_ps(_mm_max_ps(value, _mm_setzero_ps()), last)));
+    }
+
+    //pairBin 的 SSE2 版本，每一步相同
+    static __m128i
+    pairBins4(__m128 p1x, __m128 p1y, __m128 p1z, __m128 n1x, __m128 n1y, __m128 n1z,
+              __m128 p2x, __m128 p2y, __m128 p2z, __m128 n2x, __m128 n2y, __m128 n2z, float splits) {
+        const __m128 zero = _mm_setzero_ps(), one = _mm_set1_ps(1.0f), half = _mm_set1_ps(0.5f);
+        const __m128 sign_mask = _mm_set1_ps(-0.0f), pi = _mm_set1_ps(3.14159265358979f);
+        __m128 dx = _mm_sub_ps(p2x, p1x), dy = _mm_sub_ps(p2y, p1y), dz = _mm_sub_ps(p2z, p1z);
+        const __m128 f4 = _mm_sqrt_ps(dot(dx, dy, dz, dx, dy, dz));
+        const __m128 f4_nonzero = _mm_cmpneq_ps(f4, zero);
+        const __m128 safe_f4 = select(f4_nonzero, f4, one);
+        const __m128 angle1 = _mm_div_ps(dot(n1x, n1y, n1z, dx, dy, dz), safe_f4);
+        const __m128 angle2 = _mm_div_ps(dot(n2x, n2y, n2z, dx, dy, dz), safe_f4);
+        const __m128 swap = _mm_cmplt_ps(_mm_andnot_ps(sign_mask, angle1), _mm_andnot_ps(sign_mask, angle2));
+        const __m128 ux = select(swap, n2x, n1x), uy = select(swap, n2y, n1y), uz = select(swap, n2z, n1z);
+        const __m128 mx = select(swap, n1x, n2x), my = select(swap, n1y, n2y), mz = select(swap, n1z, n2z);
+        const __m128 flip = _mm_and_ps(swap, sign_mask);
+        dx = _mm_xor_ps(dx, flip);
+        dy = _mm_xor_ps(dy, flip);
+        dz = _mm_xor_ps(dz, flip);
+        const __m128 f3 = select(swap, _mm_xor_ps(angle2, sign_mask), angle1);
+        __m128 vx = _mm_sub_ps(_mm_mul_ps(dy, uz), _mm_mul_ps(dz, uy));
+        __m128 vy = _mm_sub_ps(_mm_mul_ps(dz, ux), _mm_mul_ps(dx, uz));
+        __m128 vz = _mm_sub_ps(_mm_mul_ps(dx, uy), _mm_mul_ps(dy, ux));
+        const __m128 v_norm = _mm_sqrt_ps(dot(vx, vy, vz, vx, vy, vz));
+        const __m128 v_nonzero = _mm_cmpneq_ps(v_norm, zero);
+        const __m128 safe_v_norm = select(v_nonzero, v_norm, one);
+        vx = _mm_div_ps(vx, safe_v_norm);
+        vy = _mm_div_ps(vy, safe_v_norm);
+        vz = _mm_div_ps(vz, safe_v_norm);
+        const __m128 wx = _mm_sub_ps(_mm_mul_ps(uy, vz), _mm_mul_ps(uz, vy));
+        const __m128 wy = _mm_sub_ps(_mm_mul_ps(uz, vx), _mm_mul_ps(ux, vz));
+        const __m128 wz = _mm_sub_ps(_mm_mul_ps(ux, vy), _mm_mul_ps(uy, vx));
+        const __m128 f2 = dot(vx, vy, vz, mx, my, mz);
+        const __m128 y = dot(wx, wy, wz, mx, my, mz), x = dot(ux, uy, uz, mx, my, mz);
+        const __m128 ax = _mm_andnot_ps(sign_mask, x), ay = _mm_andnot_ps(sign_mask, y);
+        const __m128 hi = _mm_max_ps(ax, ay), lo = _mm_min_ps(ax, ay);
+        const __m128 hi_positive = _mm_cmpgt_ps(hi, zero);
+        const __m128 a = _mm_and_ps(hi_positive, _mm_div_ps(lo, select(hi_positive, hi, one)));
+        const __m128 s = _mm_mul_ps(a, a);
+        __m128 r = _mm_set1_ps(-0.0117212f);
+        r = _mm_add_ps(_mm_mul_ps(r, s), _mm_set1_ps(0.05265332f));
+        r = _mm_add_ps(_mm_mul_ps(r, s), _mm_set1_ps(-0.11643287f));
+        r = _mm_add_ps(_mm_mul_ps(r, s), _mm_set1_ps(0.19354346f));
+        r = _mm_add_ps(_mm_mul_ps(r, s), _mm_set1_ps(-0.33262347f));
+        r = _mm_add_ps(_mm_mul_ps(r, s), _mm_set1_ps(0.99997726f));
+        r = _mm_mul_ps(r, a);
+        r = select(_mm_cmpgt_ps(ay, ax), _mm_sub_ps(_mm_mul_ps(half, pi), r), r);
+        r = select(_mm_cmplt_ps(x, zero), _mm_sub_ps(pi, r), r);
+        const __m128 f1 = _mm_xor_ps(r, _mm_and_ps(_mm_cmplt_ps(y, zero), sign_mask));
+        //SSE2 没有 32 位整数乘法，格子编号用浮点算(都是小整数，没有误差)
+        const __m128 nr = _mm_set1_ps(splits), last = _mm_set1_ps(splits - 1.0f);
+        const __m128 i0 = binIndex(_mm_mul_ps(nr, _mm_mul_ps(_mm_add_ps(f1, pi), _mm_div_ps(half, pi))), last);
+        const __m128 i1 = binIndex(_mm_mul_ps(nr, _mm_mul_ps(_mm_add_ps(f2, one), half)), last);
+        const __m128 i2 = binIndex(_mm_mul_ps(nr, _mm_mul_ps(_mm_add_ps(f3, one), half)), last);
+        const __m128 bin = _mm_add_ps(i0, _mm_mul_ps(nr, _mm_add_ps(i1, _mm_mul_ps(nr, i2))));
+        const __m128 t = _mm_add_ps(_mm_add_ps(f1, f2), f3);
+        const __m128 valid = _mm_and_ps(_mm_and_ps(f4_nonzero, v_nonzero), _mm_cmpeq_ps(_mm_sub_ps(t, t), zero));
+        return _mm_cvttps_epi32(select(valid, bin, _mm_set1_ps(-1.0f)));
+    }
+#endif
+
+    //一个点对的格子，无效时为 -1
+    static int
+    pairBin(float p1x, float p1y, float p1z, float n1x, float n1y, float n1z,
+            float p2x, float p2y, float p2z, float n2x, float n2y, float n2z, float splits) {
+        const float kPi = 3.14159265358979f;
+        float dx = p2x - p1x, dy = p2y - p1y, dz = p2z - p1z;
+        const float f4 = std::sqrt(dx * dx + dy * dy + dz * dz);
+        const float safe_f4 = f4 != 0.0f ? f4 : 1.0f;
+        const float angle1 = (n1x * dx + n1y * dy + n1z * dz) / safe_f4;
+        const float angle2 = (n2x * dx + n2y * dy + n2z * dz) / safe_f4;
+        //acos(|angle1|) > acos(|angle2|) 时交换两点，u 取与连线夹角较小的法线
+        const bool swap = std::abs(angle1) < std::abs(angle2);
+        const float ux = swap ? n2x : n1x, uy = swap ? n2y : n1y, uz = swap ? n2z : n1z;
+        const float mx = swap ? n1x : n2x, my = swap ? n1y : n2y, mz = swap ? n1z : n2z;
+        if (swap) {
+            dx = -dx;
+            dy = -dy;
+            dz = -dz;
+        }
+        const float f3 = swap ? -angle2 : angle1;
+        //Darboux 坐标系：v = d x u / |d x u|，w = u x v
+        float vx = dy * uz - dz * uy, vy = dz * ux - dx * uz, vz = dx * uy - dy * ux;
+        const float v_norm = std::sqrt(vx * vx + vy * vy + vz * vz);
+        const float safe_v_norm = v_norm != 0.0f ? v_norm : 1.0f;
+        vx /= safe_v_norm;
+        vy /= safe_v_norm;
+        vz /= safe_v_norm;
+        const float wx = uy * vz - uz * vy, wy = uz * vx - ux * vz, wz = ux * vy - uy * vx;
+        const float f2 = vx * mx + vy * my + vz * mz;
+        const float f1 = atan2Approx(wx * mx + wy * my + wz * mz, ux * mx + uy * my + uz * mz);
+        const float last = splits - 1.0f;
+        float i0 = splits * ((f1 + kPi) * (0.5f / kPi));
+        float i1 = splits * ((f2 + 1.0f) * 0.5f);
+        float i2 = splits * ((f3 + 1.0f) * 0.5f);
+        i0 = i0 > 0.0f ? (i0 < last ? i0 : last) : 0.0f;
+        i1 = i1 > 0.0f ? (i1 < last ? i1 : last) : 0.0f;
+        i2 = i2 > 0.0f ? (i2 < last ? i2 : last) : 0.0f;
+        const int nr_split = static_cast<int>(splits);
+        const int bin = static_cast<int>(i0) + nr_split * (static_cast<int>(i1) + nr_split * static_cast<int>(i2));
+        //t - t 只在 t 为 NaN 或无穷时不为 0
+        const float t = f1 + f2 + f3;
+        return f4 != 0.0f && v_norm != 0.0f && t - t == 0.0f ? bin : -1;
+    }
+
+    //atan2 的多项式近似，最大误差约 1e-5 弧度；先化到 [0, 1] 上求 atan，再按象限还原
+    static float
+    atan2Approx(float y, float x) {
+        const float kPi = 3.14159265358979f;
+        const float ax = std::abs(x), ay = std::abs(y);
+        const float hi = std::max(ax, ay), lo = std::min(ax, ay);
+        const float a = hi > 0.0f ? lo / hi : 0.0f;
+        const float s = a * a;
+        float r = -0.0117212f;
+        r = r * s + 0.05265332f;
+        r = r * s - 0.11643287f;
+        r = r * s + 0.19354346f;
+        r = r * s - 0.33262347f;
+        r = r * s + 0.99997726f;
+        r *= a;
+        r = ay > ax ? 0.5f * kPi - r : r;
+        r = x < 0.0f ? kPi - r : r;
+        return y < 0.0f ? -r : r;
+    }
+
+    int nr_threads_;
+    long hits_, misses_;
+    PairFeatureCache cache_;
+    //缓存对应的点云、法线与细分数
+    const void *cached_surface_;
+    const void *cached_normals_;
+    int cached_subdiv_;
+};
@@ -0,0 +1,566 @@
+/*
+ * 分块多线程的深度图边界提取
+ * 与 pcl::RangeImageBorderExtractor 相同的思路：用局部表面的典型点间距判断某个方向上是否有深度跳变，
+ * 跳变近侧为障碍边界(obstacle)，远侧为阴影边界(shadow)，两者之间的混合像素为面纱点(veil)。
+ * 结果以每像素一位的位平面给出，不再为每个像素生成 BorderDescription。
+ *
+ * 计算分三步，每一步内部按 64 像素宽的块并行（块宽是 64 的倍数，保证每个 64 位字只被一个线程写）：
+ *   1. 局部表面间距 + 四个方向的跳变分数（SSE 向量化）
+ *   2. 沿方向的非极大值抑制，并为障碍边界寻找对应的阴影像素
+ *   3. 每个块只写自己像素的 obstacle/shadow/veil 位，读取的邻域(halo)由填充边界保证不越界
+ * 需要时再追加两步计算表面变化(NARF 关键点的输入)，复用上面的 SoA 数据与分类结果：
+ *   4. 排除跳变邻居后的局部法向
+ *   5. 表面变化分数与方向：障碍边界为 1、方向为表面上指向跳变的方向；其余像素取法向投影协方差的主曲率
+ */
+#pragma once
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <limits>
+#include <vector>
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+#include <Eigen/Eigenvalues>
+
+#include <pcl/point_types.h>
+#include <pcl/range_image/range_image.h>
+
+#include "parallel.h"
+
+//一个边界类别的位平面，按行存储，每行补齐到 64 位
+struct BorderBitplane {
+    int width = 0, height = 0, words_per_row = 0;
+    std::vector<std::uint64_t> bits;
+
+    void
+    resize(int w, int h) {
+        width = w;
+        height = h;
+        words_per_row = (w + 63) / 64;
+        bits.assign(static_cast<std::size_t>(words_per_row) * h, 0);
+    }
+
+    bool
+    test(int x, int y) const {
+        return (bits[y * words_per_row + (x >> 6)] >> (x & 63)) & 1u;
+    }
+
+    bool
+    test(int index) const {
+        return test(index % width, index / width);
+    }
+
+    void
+    set(int x, int y) {
+        bits[y * words_per_row + (x >> 6)] |= std::uint64_t(1) << (x & 63);
+    }
+
+    std::size_t
+    count() const {
+        std::size_t n = 0;
+        for (std::uint64_t word: bits)
+            n += __builtin_popcountll(word);
+        return n;
+    }
+
+    //把置位的像素转成深度图中的点索引 y*width+x
+    std::vector<int>
+    toIndices() const {
+        std::vector<int> indices;
+        indices.reserve(count());
+        for (int y = 0; y < height; ++y)
+            for (int word_index = 0; word_index < words_per_row; ++word_index) {
+                std::uint64_t word = bits[y * words_per_row + word_index];
+                while (word) {
+                    int x = word_index * 64 + __builtin_ctzll(word);
+                    indices.push_back(y * width + x);
+                    word &= word - 1;
+                }
+            }
+        return indices;
+    }
+};
+
+struct RangeImageBorders {
+    BorderBitplane obstacle, shadow, veil;
+};
+
+//每个像素的表面变化分数(0..1)与变化方向(世界坐标系单位向量)，对应 RangeImageBorderExtractor::getSurfaceChangeScores/Directions
+struct RangeImageSurfaceChanges {
+    int width = 0, height = 0;
+    std::vector<float> scores;
+    std::vector<float> direction_x, direction_y, direction_z;
+
+    void
+    resize(int w, int h) {
+        width = w;
+        height = h;
+        const std::size_t size = static_cast<std::size_t>(w) * h;
+        scores.assign(size, 0.0f);
+        direction_x.assign(size, 0.0f);
+        direction_y.assign(size, 0.0f);
+        direction_z.assign(size, 0.0f);
+    }
+};
+
+class RangeImageBorderExtractorParallel {
+public:
+    //四个检测方向，与 pcl::BorderDescription 的 right/left/top/bottom 一致
+    enum Direction {
+        BORDER_RIGHT = 0, BORDER_LEFT = 1, BORDER_TOP = 2, BORDER_BOTTOM = 3
+    };
+
+    struct Parameters {
+        int pixel_radius_borders = 3;               //沿方向取平均的像素数，也是局部表面窗口半径
+        float minimum_border_probability = 0.8f;    //障碍边界的最小分数
+        float minimum_shadow_probability = 0.4f;    //对应阴影边界的最小(绝对)分数
+        int pixel_radius_principal_curvature = 2;   //主曲率的窗口半径
+        int tile_height = 32;                       //块高，块宽固定为 64
+        int max_no_of_threads = 0;                  //0 表示使用全部硬件线程
+    };
+
+    explicit RangeImageBorderExtractorParallel(const pcl::RangeImage *range_image = nullptr)
+            : range_image_(range_image) {}
+
+    void
+    setRangeImage(const pcl::RangeImage *range_image) {
+        range_image_ = range_image;
+    }
+
+    Parameters &
+    getParameters() {
+        return parameters_;
+    }
+
+    void
+    compute(RangeImageBorders &borders) {
+        borders.obstacle.resize(0, 0);
+        borders.shadow.resize(0, 0);
+        borders.veil.resize(0, 0);
+        if (range_image_ == nullptr || range_image_->width == 0 || range_image_->height == 0)
+            return;
+        width_ = static_cast<int>(range_image_->width);
+        height_ = static_cast<int>(range_image_->height);
+        radius_ = std::max(1, parameters_.pixel_radius_borders);
+        pad_ = 2 * radius_;
+        stride_ = width_ + 2 * pad_;
+        tile_height_ = std::max(1, parameters_.tile_height);
+        tiles_x_ = (width_ + kTileWidth - 1) / kTileWidth;
+        tiles_y_ = (height_ + tile_height_ - 1) / tile_height_;
+
+        borders.obstacle.resize(width_, height_);
+        borders.shadow.resize(width_, height_);
+        borders.veil.resize(width_, height_);
+
+        buildSoA();
+        forEachTile([this](int x0, int y0, int x1, int y1) { computeScores(x0, y0, x1, y1); });
+        forEachTile([this](int x0, int y0, int x1, int y1) { findShadowPartners(x0, y0, x1, y1); });
+        forEachTile([this, &borders](int x0, int y0, int x1, int y1) { classify(x0, y0, x1, y1, borders); });
+    }
+
+    //在边界之外同时给出表面变化，供 NarfKeypointParallel 直接使用，避免再算一遍局部表面
+    void
+    compute(RangeImageBorders &borders, RangeImageSurfaceChanges &surface_changes) {
+        compute(borders);
+        surface_changes.resize(width_, height_);
+        if (width_ == 0)
+            return;
+        const float nan = std::numeric_limits<float>::quiet_NaN();
+        const std::size_t size = x_.size();
+        normal_x_.assign(size, nan);
+        normal_y_.assign(size, nan);
+        normal_z_.assign(size, nan);
+        forEachTile([this](int x0, int y0, int x1, int y1) { computeNormals(x0, y0, x1, y1); });
+        forEachTile([this, &borders, &surface_changes](int x0, int y0, int x1, int y1) {
+            computeSurfaceChanges(x0, y0, x1, y1, borders, surface_changes);
+        });
+    }
+
+    //某个方向上的带符号跳变分数：正值表示该方向的邻居更远，负值表示更近
+    float
+    getBorderScore(int x, int y, Direction direction) const {
+        return scores_[direction][at(x, y)];
+    }
+
+protected:
+    static const int kTileWidth = 64;
+
+    int
+    at(int x, int y) const {
+        return (y + pad_) * stride_ + (x + pad_);
+    }
+
+    int
+    step(Direction direction) const {
+        switch (direction) {
+            case BORDER_RIGHT:
+                return 1;
+            case BORDER_LEFT:
+                return -1;
+            case BORDER_TOP:
+                return -stride_;
+            default:
+                return stride_;
+        }
+    }
+
+    static Direction
+    opposite(Direction direction) {
+        return static_cast<Direction>(direction ^ 1);
+    }
+
+    template<typename Function>
+    void
+    forEachTile(Function f) {
+        parallelFor(0, tiles_x_ * tiles_y_, [&](int tile) {
+            int x0 = (tile % tiles_x_) * kTileWidth, y0 = (tile / tiles_x_) * tile_height_;
+            f(x0, y0, std::min(x0 + kTileWidth, width_), std::min(y0 + tile_height_, height_));
+        }, parameters_.max_no_of_threads);
+    }
+
+    //把深度图转成带填充边界的 SoA 数组，无效像素的坐标为 NaN
+    void
+    buildSoA() {
+        const std::size_t size = static_cast<std::size_t>(stride_) * (height_ + 2 * pad_);
+        const float nan = std::numeric_limits<float>::quiet_NaN();
+        x_.assign(size, nan);
+        y_.assign(size, nan);
+        z_.assign(size, nan);
+        range_.assign(size, -std::numeric_limits<float>::infinity());
+        surface_distance_squared_.assign(size, nan);
+        for (int d = 0; d < 4; ++d) {
+            scores_[d].assign(size, 0.0f);
+            partner_[d].assign(size, 0);
+        }
+        parallelFor(0, height_, [this](int y) {
+            for (int x = 0; x < width_; ++x) {
+                const pcl::PointWithRange &point = range_image_->points[y * width_ + x];
+                const int i = at(x, y);
+                range_[i] = point.range;
+                if (std::isfinite(point.range)) {
+                    x_[i] = point.x;
+                    y_[i] = point.y;
+                    z_[i] = point.z;
+                }
+            }
+        }, parameters_.max_no_of_threads);
+    }
+
+    //一行中连续 n 个像素与偏移 offset 处像素的距离平方，无效时为 +inf
+    void
+    squaredDistances(int row_start, int offset, int n, float *out) const {
+        const float *px = &x_[row_start], *py = &y_[row_start], *pz = &z_[row_start];
+        const float *qx = px + offset, *qy = py + offset, *qz = pz + offset;
+        int i = 0;
+#if defined(__SSE2__)
+        const __m128 inf = _mm_set1_ps(std::numeric_limits<float>::infinity());
+        for (; i + 4 <= n; i += 4) {
+            __m128 dx = _mm_sub_ps(_mm_loadu_ps(px + i), _mm_loadu_ps(qx + i));
+            __m128 dy = _mm_sub_ps(_mm_loadu_ps(py + i), _mm_loadu_ps(qy + i));
+            __m128 dz = _mm_sub_ps(_mm_loadu_ps(pz + i), _mm_loadu_ps(qz + i));
+            __m128 d2 = _mm_add_ps(_mm_add_ps(_mm_mul_ps(dx, dx), _mm_mul_ps(dy, dy)), _mm_mul_ps(dz, dz));
+            __m128 valid = _mm_cmpord_ps(d2, d2);
+            _mm_storeu_ps(out + i, _mm_or_ps(_mm_and_ps(valid, d2), _mm_andnot_ps(valid, inf)));
+        }
+#endif
+        for (; i < n; ++i) {
+            float dx = px[i] - qx[i], dy = py[i] - qy[i], dz = pz[i] - qz[i];
+            float d2 = dx * dx + dy * dy + dz * dz;
+            out[i] = std::isnan(d2) ? std::numeric_limits<float>::infinity() : d2;
+        }
+    }
+
+    /**
+     * 第一步：局部表面的典型点间距 + 四个方向的跳变分数
+     * 典型间距取 (2r+1)^2 窗口内第 (r+1)^2 近邻居的距离（与 RangeImageBorderExtractor 相同）；
+     * 方向分数与 getNeighborDistanceChangeScore 相同：沿方向 r 个像素的平均点与当前点的距离 d，
+     * d^2 <= 典型间距^2 时为 0，否则为 1 - sqrt(典型^2 / d^2)，邻居更近时取负。
+     */
+    void
+    computeScores(int x0, int y0, int x1, int y1) {
+        const int n = x1 - x0, r = radius_;
+        const int window = (2 * r + 1) * (2 * r + 1) - 1;
+        const int k = std::min(window, (r + 1) * (r + 1));
+        std::vector<float> distances(static_cast<std::size_t>(window) * n), candidates(window);
+        std::vector<float> sum_x(n), sum_y(n), sum_z(n), sum_range(n), count(n);
+
+        for (int y = y0; y < y1; ++y) {
+            const int row = at(x0, y);
+
+            //每个窗口偏移一次算出整行的距离，连续内存便于向量化
+            int o = 0;
+            for (int dy = -r; dy <= r; ++dy)
+                for (int dx = -r; dx <= r; ++dx) {
+                    if (dx == 0 && dy == 0)
+                        continue;
+                    squaredDistances(row, dy * stride_ + dx, n, &distances[static_cast<std::size_t>(o) * n]);
+                    ++o;
+                }
+            for (int i = 0; i < n; ++i) {
+                if (!std::isfinite(range_[row + i]))
+                    continue;
+                int valid = 0;
+                for (int j = 0; j < window; ++j) {
+                    float d2 = distances[static_cast<std::size_t>(j) * n + i];
+                    if (d2 < std::numeric_limits<float>::infinity())
+                        candidates[valid++] = d2;
+                }
+                if (valid == 0)
+                    continue;
+                int kth = std::min(k, valid) - 1;
+                std::nth_element(candidates.begin(), candidates.begin() + kth, candidates.begin() + valid);
+                surface_distance_squared_[row + i] = candidates[kth];
+            }
+
+            for (int d = 0; d < 4; ++d) {
+                const Direction direction = static_cast<Direction>(d);
+                const int s = step(direction);
+                std::fill(sum_x.begin(), sum_x.end(), 0.0f);
+                std::fill(sum_y.begin(), sum_y.end(), 0.0f);
+                std::fill(sum_z.begin(), sum_z.end(), 0.0f);
+                std::fill(sum_range.begin(), sum_range.end(), 0.0f);
+                std::fill(count.begin(), count.end(), 0.0f);
+                for (int j = 1; j <= r; ++j) {
+                    const int offset = row + j * s;
+                    for (int i = 0; i < n; ++i) {
+                        const float range = range_[offset + i];
+                        const bool valid = std::isfinite(range);
+                        sum_x[i] += valid ? x_[offset + i] : 0.0f;
+                        sum_y[i] += valid ? y_[offset + i] : 0.0f;
+                        sum_z[i] += valid ? z_[offset + i] : 0.0f;
+                        sum_range[i] += valid ? range : 0.0f;
+                        count[i] += valid ? 1.0f : 0.0f;
+                    }
+                }
+                scoreRow(row, s, n, sum_x.data(), sum_y.data(), sum_z.data(), sum_range.data(), count.data(),
+                         &scores_[d][row]);
+            }
+        }
+    }
+
+    void
+    scoreRow(int row, int s, int n, const float *sum_x, const float *sum_y, const float *sum_z,
+             const float *sum_range, const float *count, float *out) const {
+        const float *px = &x_[row], *py = &y_[row], *pz = &z_[row], *pr = &range_[row];
+        const float *surface = &surface_distance_squared_[row];
+        int i = 0;
+#if defined(__SSE2__)
+        const __m128 zero = _mm_setzero_ps(), one = _mm_set1_ps(1.0f);
+        const __m128 sign_bit = _mm_set1_ps(-0.0f);
+        for (; i + 4 <= n; i += 4) {
+            __m128 c = _mm_loadu_ps(count + i);
+            __m128 has = _mm_cmpgt_ps(c, zero);
+            __m128 inv = _mm_div_ps(one, _mm_max_ps(c, one));
+            __m128 dx = _mm_sub_ps(_mm_mul_ps(_mm_loadu_ps(sum_x + i), inv), _mm_loadu_ps(px + i));
+            __m128 dy = _mm_sub_ps(_mm_mul_ps(_mm_loadu_ps(sum_y + i), inv), _mm_loadu_ps(py + i));
+            __m128 dz = _mm_sub_ps(_mm_mul_ps(_mm_loadu_ps(sum_z + i), inv), _mm_loadu_ps(pz + i));
+            __m128 d2 = _mm_add_ps(_mm_add_ps(_mm_mul_ps(dx, dx), _mm_mul_ps(dy, dy)), _mm_mul_ps(dz, dz));
+            __m128 surface_d2 = _mm_loadu_ps(surface + i);
+            //d2 > surface_d2 对 NaN 为假，无效像素自然得到 0
+            __m128 jump = _mm_and_ps(_mm_cmpgt_ps(d2, surface_d2), has);
+            __m128 score = _mm_sub_ps(one, _mm_sqrt_ps(_mm_div_ps(surface_d2, _mm_max_ps(d2, surface_d2))));
+            __m128 closer = _mm_cmplt_ps(_mm_mul_ps(_mm_loadu_ps(sum_range + i), inv), _mm_loadu_ps(pr + i));
+            score = _mm_xor_ps(score, _mm_and_ps(closer, sign_bit));
+            _mm_storeu_ps(out + i, _mm_and_ps(jump, score));
+        }
+#endif
+        for (; i < n; ++i) {
+            out[i] = 0.0f;
+            if (count[i] <= 0.0f)
+                continue;
+            float inv = 1.0f / count[i];
+            float dx = sum_x[i] * inv - px[i], dy = sum_y[i] * inv - py[i], dz = sum_z[i] * inv - pz[i];
+            float d2 = dx * dx + dy * dy + dz * dz;
+            if (!(d2 > surface[i]))
+                continue;
+            float score = 1.0f - std::sqrt(surface[i] / d2);
+            out[i] = sum_range[i] * inv < pr[i] ? -score : score;
+        }
+        //第一个邻居是远距离读数(+inf)时直接视为跳变到最远处
+        for (i = 0; i < n; ++i)
+            if (std::isfinite(pr[i]) && pr[i + s] == std::numeric_limits<float>::infinity())
+                out[i] = 1.0f;
+    }
+
+    //第二步：沿方向的非极大值抑制，为障碍边界找阴影像素，partner_ 记录步数(0 表示不是障碍边界)
+    void
+    findShadowPartners(int x0, int y0, int x1, int y1) {
+        const float threshold = parameters_.minimum_border_probability;
+        for (int d = 0; d < 4; ++d) {
+            const Direction direction = static_cast<Direction>(d);
+            const int s = step(direction);
+            const std::vector<float> &score = scores_[d], &back_score = scores_[opposite(direction)];
+            for (int y = y0; y < y1; ++y)
+                for (int x = x0; x < x1; ++x) {
+                    const int i = at(x, y);
+                    const float value = score[i];
+                    if (value < threshold || value < score[i - s] || value <= score[i + s])
+                        continue;
+                    //跳变到最远处时没有阴影像素，partner 记为 -1
+                    if (range_[i + s] == std::numeric_limits<float>::infinity()) {
+                        partner_[d][i] = -1;
+                        continue;
+                    }
+                    int best_step = 0;
+                    float best_score = -parameters_.minimum_shadow_probability;
+                    for (int j = 1; j <= radius_; ++j)
+                        if (back_score[i + j * s] <= best_score) {
+                            best_score = back_score[i + j * s];
+                            best_step = j;
+                        }
+                    partner_[d][i] = static_cast<signed char>(best_step);
+                }
+        }
+    }
+
+    //第三步：每个像素检查沿各方向 r 步以内是否有以它为阴影/面纱的障碍边界，只写本块的位
+    void
+    classify(int x0, int y0, int x1, int y1, RangeImageBorders &borders) const {
+        for (int y = y0; y < y1; ++y)
+            for (int x = x0; x < x1; ++x) {
+                const int i = at(x, y);
+                bool obstacle = false, shadow = false, veil = false;
+                for (int d = 0; d < 4; ++d) {
+                    const int s = step(static_cast<Direction>(d));
+                    if (partner_[d][i] != 0)
+                        obstacle = true;
+                    for (int j = 1; j <= radius_; ++j) {
+                        const int partner = partner_[d][i - j * s];
+                        if (partner == j)
+                            shadow = true;
+                        else if (partner > j)
+                            veil = true;
+                    }
+                }
+                if (obstacle)
+                    borders.obstacle.set(x, y);
+                if (shadow)
+                    borders.shadow.set(x, y);
+                if (veil && !obstacle && !shadow)
+                    borders.veil.set(x, y);
+            }
+    }
+
+    //第四步：窗口内与当前点距离不超过 2 倍典型间距的邻居做 PCA，法向朝向传感器
+    void
+    computeNormals(int x0, int y0, int x1, int y1) {
+        const int r = radius_;
+        const Eigen::Vector3f sensor_pos = range_image_->getSensorPos();
+        for (int y = y0; y < y1; ++y)
+            for (int x = x0; x < x1; ++x) {
+                const int i = at(x, y);
+                const float max_distance_squared = 4.0f * surface_distance_squared_[i];
+                if (!(max_distance_squared >= 0.0f))
+                    continue;
+                const Eigen::Vector3f p(x_[i], y_[i], z_[i]);
+                Eigen::Vector3f mean(Eigen::Vector3f::Zero());
+                Eigen::Matrix3f second_moment(Eigen::Matrix3f::Zero());
+                int count = 0;
+                for (int dy = -r; dy <= r; ++dy)
+                    for (int dx = -r; dx <= r; ++dx) {
+                        const int j = i + dy * stride_ + dx;
+                        const Eigen::Vector3f q(x_[j] - p.x(), y_[j] - p.y(), z_[j] - p.z());
+                        //无效邻居为 NaN，比较结果为假
+                        if (!(q.squaredNorm() <= max_distance_squared))
+                            continue;
+                        mean += q;
+                        second_moment += q * q.transpose();
+                        ++count;
+                    }
+                if (count < 3)
+                    continue;
+                mean /= static_cast<float>(count);
+                const Eigen::Matrix3f covariance = second_moment / static_cast<float>(count) - mean * mean.transpose();
+                Eigen::SelfAdjointEigenSolver<Eigen::Matrix3f> solver;
+                solver.computeDirect(covariance);
+                Eigen::Vector3f normal = solver.eigenvectors().col(0);
+                if (normal.dot(p - sensor_pos) > 0.0f)
+                    normal = -normal;
+                normal_x_[i] = normal.x();
+                normal_y_[i] = normal.y();
+                normal_z_[i] = normal.z();
+            }
+    }
+
+    /**
+     * 第五步：阴影边界与面纱点没有表面变化；障碍边界分数为 1，方向为前景表面上指向跳变一侧的三维方向；
+     * 其余像素把邻居法向投影到切平面求协方差，最大特征值对应主曲率方向，分数取 2*sqrt(最大特征值)（截断到 1），
+     * 90 度折角约为 1，平面为 0。
+     */
+    void
+    computeSurfaceChanges(int x0, int y0, int x1, int y1, const RangeImageBorders &borders,
+                          RangeImageSurfaceChanges &surface_changes) const {
+        //窗口不能超出填充边界
+        const int r = std::max(1, std::min(parameters_.pixel_radius_principal_curvature, pad_));
+        for (int y = y0; y < y1; ++y)
+            for (int x = x0; x < x1; ++x) {
+                const int i = at(x, y), index = y * width_ + x;
+                if (!std::isfinite(range_[i]) || borders.shadow.test(x, y) || borders.veil.test(x, y))
+                    continue;
+                const Eigen::Vector3f p(x_[i], y_[i], z_[i]);
+                Eigen::Vector3f direction(Eigen::Vector3f::Zero());
+                float score = 0.0f;
+                if (borders.obstacle.test(x, y)) {
+                    for (int d = 0; d < 4; ++d) {
+                        if (partner_[d][i] == 0)
+                            continue;
+                        //跨过跳变的向量几乎与视线平行，改用内侧邻居指向边界点的向量，它位于前景表面上
+                        const int j = i - step(static_cast<Direction>(d));
+                        const Eigen::Vector3f offset(p.x() - x_[j], p.y() - y_[j], p.z() - z_[j]);
+                        if (offset.allFinite())
+                            direction += offset.normalized();
+                    }
+                    score = 1.0f;
+                } else {
+                    const Eigen::Vector3f normal(normal_x_[i], normal_y_[i], normal_z_[i]);
+                    if (!normal.allFinite())
+                        continue;
+                    const float max_distance_squared = 4.0f * surface_distance_squared_[i];
+                    const Eigen::Matrix3f projection = Eigen::Matrix3f::Identity() - normal * normal.transpose();
+                    Eigen::Vector3f mean(Eigen::Vector3f::Zero());
+                    Eigen::Matrix3f second_moment(Eigen::Matrix3f::Zero());
+                    int count = 0;
+                    for (int dy = -r; dy <= r; ++dy)
+                        for (int dx = -r; dx <= r; ++dx) {
+                            const int j = i + dy * stride_ + dx;
+                            const Eigen::Vector3f q(x_[j] - p.x(), y_[j] - p.y(), z_[j] - p.z());
+                            const Eigen::Vector3f neighbor_normal(normal_x_[j], normal_y_[j], normal_z_[j]);
+                            if (!(q.squaredNorm() <= max_distance_squared) || !neighbor_normal.allFinite())
+                                continue;
+                            const Eigen::Vector3f projected = projection * neighbor_normal;
+                            mean += projected;
+                            second_moment += projected * projected.transpose();
+                            ++count;
+                        }
+                    if (count < 3)
+                        continue;
+                    mean /= static_cast<float>(count);
+                    const Eigen::Matrix3f covariance = second_moment / static_cast<float>(count) - mean * mean.transpose();
+                    Eigen::SelfAdjointEigenSolver<Eigen::Matrix3f> solver;
+                    solver.computeDirect(covariance);
+                    score = std::min(1.0f, 2.0f * std::sqrt(std::max(0.0f, solver.eigenvalues()(2))));
+                    direction = solver.eigenvectors().col(2);
+                }
+                const float norm = direction.norm();
+                if (!(norm > 0.0f))
+                    continue;
+                direction /= norm;
+                surface_changes.scores[index] = score;
+                surface_changes.direction_x[index] = direction.x();
+                surface_changes.direction_y[index] = direction.y();
+                surface_changes.direction_z[index] = direction.z();
+            }
+    }
+
+    const pcl::RangeImage *range_image_;
+    Parameters parameters_;
+    int width_ = 0, height_ = 0, radius_ = 0, pad_ = 0, stride_ = 0, tile_height_ = 1, tiles_x_ = 0, tiles_y_ = 0;
+    std::vector<float> x_, y_, z_, range_, surface_distance_squared_;
+    std::vector<float> normal_x_, normal_y_, normal_z_;
+    std::vector<float> scores_[4];
+    std::vector<signed char> partner_[4];
+};
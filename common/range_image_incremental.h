@@ -0,0 +1,307 @@
+/*
+ * 增量更新的深度图
+ * 旋转式激光雷达按方位角切片(packet)输出数据，IncrementalRangeImage 只重算切片覆盖到的列，
+ * 并记录“脏区域”，下游的边界提取/关键点检测只需要处理这些列。
+ * 图像始终覆盖完整的 360x180 度且不裁剪，这样列号与方位角一一对应。
+ * 每一圈开始时调用 beginSweep：一列在新的一圈中第一次被切片覆盖(直接命中或 floor/ceil 插值)时作废上一圈的数据，
+ * 同一圈内的切片在列中取最小值合并，endSweep 清空本圈没有覆盖到的列。一圈结束后的图像与用整圈点云
+ * 调用 createFromPointCloud(360x180 度，noise_level 为 0，再 integrateFarRanges / setUnseenToMaxRange)的结果逐像素一致
+ * (后者裁剪到有数据的范围，比较时按图像偏移对齐)。
+ */
+#pragma once
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <vector>
+
+#include <pcl/point_types.h>
+#include <pcl/range_image/range_image.h>
+
+#include "range_image_parallel.h"
+
+class IncrementalRangeImage : public RangeImageParallel {
+public:
+    typedef boost::shared_ptr<IncrementalRangeImage> Ptr;
+
+    //连续的脏列 [x_begin, x_end) 与其中发生变化的行 [y_begin, y_end)
+    struct DirtyRegion {
+        int x_begin, x_end;
+        int y_begin, y_end;
+    };
+
+    IncrementalRangeImage() : min_range_(0.0f), unseen_to_max_range_(false), sweep_(0) {}
+
+    //建立空的全景深度图，之后只通过 updateSlice 填充
+    void
+    reset(float angular_resolution, const Eigen::Affine3f &sensor_pose,
+          CoordinateFrame coordinate_frame = CAMERA_FRAME, float min_range = 0.0f,
+          bool unseen_to_max_range = false) {
+        setAngularResolution(angular_resolution);
+        width = static_cast<std::uint32_t>(std::lrint(std::floor(pcl::deg2rad(360.0f) * angular_resolution_x_reciprocal_)));
+        height = static_cast<std::uint32_t>(std::lrint(std::floor(pcl::deg2rad(180.0f) * angular_resolution_y_reciprocal_)));
+        image_offset_x_ = 0;
+        image_offset_y_ = 0;
+        is_dense = false;
+
+        getCoordinateFrameTransformation(coordinate_frame, to_world_system_);
+        to_world_system_ = sensor_pose * to_world_system_;
+        to_range_image_system_ = to_world_system_.inverse(Eigen::Isometry);
+
+        min_range_ = min_range;
+        unseen_to_max_range_ = unseen_to_max_range;
+        points.clear();
+        points.resize(width * height, unobserved_point);
+        //setUnseenToMaxRange：没有数据的像素距离为 +inf，三维坐标仍为 NaN
+        if (unseen_to_max_range_)
+            for (pcl::PointWithRange &point: points)
+                point.range = std::numeric_limits<float>::infinity();
+        direct_.assign(points.size(), std::numeric_limits<float>::infinity());
+        interpolated_.assign(points.size(), std::numeric_limits<float>::infinity());
+        far_mask_.assign(points.size(), 0);
+        far_rows_.assign(width, RowExtent());
+        column_rows_.assign(width, RowExtent());
+        dirty_rows_.assign(width, RowExtent());
+        update_rows_.assign(width, RowExtent());
+        touched_.assign(width, 0);
+        column_sweep_.assign(width, 0);
+        sweep_ = 0;
+    }
+
+    //开始新的一圈，之后每列第一次被切片覆盖时作废上一圈的数据
+    void
+    beginSweep() {
+        ++sweep_;
+    }
+
+    //结束一圈：清空本圈没有覆盖到的列，结果与用整圈点云一次建图相同
+    void
+    endSweep() {
+        const int w = static_cast<int>(width);
+        for (int column = 0; column < w; ++column) {
+            if (column_sweep_[column] == sweep_)
+                continue;
+            const RowExtent rows = column_rows_[column];
+            invalidateColumn(column);
+            refreshRows(column, rows);
+            dirty_rows_[column].merge(rows);
+        }
+    }
+
+    //远距离读数(与 integrateFarRanges 相同的含义)，预先投影成掩码；新旧掩码涉及的像素立即重算并标记为脏
+    void
+    setFarRanges(const pcl::PointCloud<pcl::PointWithViewpoint> &far_ranges) {
+        const std::vector<RowExtent> old_rows = far_rows_;
+        std::fill(far_mask_.begin(), far_mask_.end(), 0);
+        std::fill(far_rows_.begin(), far_rows_.end(), RowExtent());
+        float x_real, y_real, range;
+        for (const pcl::PointWithViewpoint &point: far_ranges.points) {
+            getImagePoint(Eigen::Vector3f(point.x, point.y, point.z), x_real, y_real, range);
+            const int floor_x = static_cast<int>(std::lrint(std::floor(x_real))),
+                    floor_y = static_cast<int>(std::lrint(std::floor(y_real))),
+                    ceil_x = static_cast<int>(std::lrint(std::ceil(x_real))),
+                    ceil_y = static_cast<int>(std::lrint(std::ceil(y_real)));
+            const int neighbor_x[4] = {floor_x, floor_x, ceil_x, ceil_x};
+            const int neighbor_y[4] = {floor_y, ceil_y, floor_y, ceil_y};
+            for (int n = 0; n < 4; ++n) {
+                if (!isInImage(neighbor_x[n], neighbor_y[n]))
+                    continue;
+                far_mask_[neighbor_y[n] * width + neighbor_x[n]] = 1;
+                far_rows_[neighbor_x[n]].add(neighbor_y[n]);
+            }
+        }
+        const int w = static_cast<int>(width);
+        for (int column = 0; column < w; ++column) {
+            RowExtent rows = old_rows[column];
+            rows.merge(far_rows_[column]);
+            refreshRows(column, rows);
+            dirty_rows_[column].merge(rows);
+        }
+    }
+
+    /**
+     * 用一个切片更新深度图：切片的点直接命中或插值到的列在本圈第一次被覆盖时先作废，
+     * 之后与列中已有的数据取最小值合并，floor/ceil 插值可以写入相邻的列。
+     * 切片通常只有几千个点，这里串行处理，延迟比启动线程更低。
+     */
+    template<typename PointCloudType>
+    void
+    updateSlice(const PointCloudType &packet) {
+        const int w = static_cast<int>(width);
+        projections_.clear();
+        touched_columns_.clear();
+        float x_real, y_real, range;
+        int x, y;
+        for (const auto &point: packet.points) {
+            if (!pcl::isFinite(point))
+                continue;
+            getImagePoint(Eigen::Vector3f(point.x, point.y, point.z), x_real, y_real, range);
+            real2DToInt2D(x_real, y_real, x, y);
+            if (range < min_range_ || !isInImage(x, y))
+                continue;
+            Projection p;
+            p.range = range;
+            p.x = x;
+            p.y = y;
+            p.floor_x = static_cast<int>(std::lrint(std::floor(x_real)));
+            p.floor_y = static_cast<int>(std::lrint(std::floor(y_real)));
+            p.ceil_x = static_cast<int>(std::lrint(std::ceil(x_real)));
+            p.ceil_y = static_cast<int>(std::lrint(std::ceil(y_real)));
+            projections_.push_back(p);
+            touchColumn(x);
+            if (p.floor_x >= 0 && p.floor_x < w)
+                touchColumn(p.floor_x);
+            if (p.ceil_x >= 0 && p.ceil_x < w)
+                touchColumn(p.ceil_x);
+        }
+        if (touched_columns_.empty())
+            return;
+
+        //与 RangeImageParallel::doZBufferParallel 相同：直接命中取最小值，否则取邻居插值的最小值
+        for (const Projection &p: projections_) {
+            const int neighbor_x[4] = {p.floor_x, p.floor_x, p.ceil_x, p.ceil_x};
+            const int neighbor_y[4] = {p.floor_y, p.ceil_y, p.floor_y, p.ceil_y};
+            for (int n = 0; n < 4; ++n) {
+                const int n_x = neighbor_x[n], n_y = neighbor_y[n];
+                if ((n_x == p.x && n_y == p.y) || !isInImage(n_x, n_y))
+                    continue;
+                float &value = interpolated_[n_y * w + n_x];
+                value = std::min(value, p.range);
+                column_rows_[n_x].add(n_y);
+                update_rows_[n_x].add(n_y);
+            }
+            float &value = direct_[p.y * w + p.x];
+            value = std::min(value, p.range);
+            column_rows_[p.x].add(p.y);
+            update_rows_[p.x].add(p.y);
+        }
+
+        for (int column: touched_columns_) {
+            refreshRows(column, update_rows_[column]);
+            dirty_rows_[column].merge(update_rows_[column]);
+            touched_[column] = 0;
+        }
+    }
+
+    //自上次 clearDirtyRegions 以来发生变化的区域，按列合并成连续段（跨越 0 度的切片会分成两段）
+    std::vector<DirtyRegion>
+    getDirtyRegions() const {
+        std::vector<DirtyRegion> regions;
+        const int w = static_cast<int>(width);
+        for (int x = 0; x < w; ++x) {
+            const RowExtent &rows = dirty_rows_[x];
+            if (rows.empty())
+                continue;
+            if (!regions.empty() && regions.back().x_end == x) {
+                DirtyRegion &region = regions.back();
+                region.x_end = x + 1;
+                region.y_begin = std::min(region.y_begin, rows.begin);
+                region.y_end = std::max(region.y_end, rows.end);
+            } else {
+                regions.push_back(DirtyRegion{x, x + 1, rows.begin, rows.end});
+            }
+        }
+        return regions;
+    }
+
+    bool
+    isColumnDirty(int x) const {
+        return !dirty_rows_[x].empty();
+    }
+
+    void
+    clearDirtyRegions() {
+        std::fill(dirty_rows_.begin(), dirty_rows_.end(), RowExtent());
+    }
+
+protected:
+    struct Projection {
+        float range;
+        int x, y;
+        int floor_x, floor_y, ceil_x, ceil_y;
+    };
+
+    //列中有数据(或发生变化)的行范围 [begin, end)
+    struct RowExtent {
+        int begin, end;
+
+        RowExtent() : begin(std::numeric_limits<int>::max()), end(0) {}
+
+        RowExtent(int b, int e) : begin(b), end(e) {}
+
+        bool
+        empty() const {
+            return begin >= end;
+        }
+
+        void
+        add(int row) {
+            begin = std::min(begin, row);
+            end = std::max(end, row + 1);
+        }
+
+        void
+        merge(const RowExtent &other) {
+            if (other.empty())
+                return;
+            begin = std::min(begin, other.begin);
+            end = std::max(end, other.end);
+        }
+    };
+
+    //本次切片第一次涉及某列：本圈还没有覆盖过这列时作废其中上一圈的数据
+    void
+    touchColumn(int column) {
+        if (touched_[column])
+            return;
+        touched_[column] = 1;
+        touched_columns_.push_back(column);
+        update_rows_[column] = RowExtent();
+        if (column_sweep_[column] != sweep_) {
+            update_rows_[column] = column_rows_[column];
+            invalidateColumn(column);
+        }
+    }
+
+    //清空一列的直接命中与插值缓冲，像素留给 refreshRows 重算
+    void
+    invalidateColumn(int column) {
+        const int w = static_cast<int>(width);
+        const RowExtent &rows = column_rows_[column];
+        for (int row = rows.begin; row < rows.end; ++row)
+            direct_[row * w + column] = interpolated_[row * w + column] = std::numeric_limits<float>::infinity();
+        column_rows_[column] = RowExtent();
+        column_sweep_[column] = sweep_;
+    }
+
+    //按缓冲区重算一列中 rows 范围内的像素：直接命中、插值、远距离读数 / setUnseenToMaxRange、未观测，依次优先
+    void
+    refreshRows(int column, const RowExtent &rows) {
+        const int w = static_cast<int>(width);
+        for (int row = rows.begin; row < rows.end; ++row) {
+            const int index = row * w + column;
+            pcl::PointWithRange &point = points[index];
+            const float range = direct_[index] < std::numeric_limits<float>::infinity() ? direct_[index]
+                                                                                          : interpolated_[index];
+            if (range < std::numeric_limits<float>::infinity()) {
+                point.range = range;
+                calculate3DPoint(static_cast<float>(column), static_cast<float>(row), point.range, point);
+            } else {
+                point = unobserved_point;
+                if (far_mask_[index] || unseen_to_max_range_)
+                    point.range = std::numeric_limits<float>::infinity();
+            }
+        }
+    }
+
+    std::vector<float> direct_, interpolated_;
+    std::vector<unsigned char> far_mask_;
+    std::vector<RowExtent> far_rows_, column_rows_, dirty_rows_, update_rows_;
+    std::vector<unsigned char> touched_;
+    std::vector<unsigned int> column_sweep_;//每列最后一次被覆盖时的圈号
+    std::vector<int> touched_columns_;
+    std::vector<Projection> projections_;
+    float min_range_;
+    bool unseen_to_max_range_;
+    unsigned int sweep_;
+};
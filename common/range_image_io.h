@@ -0,0 +1,463 @@
+/*
+ * 深度图的导出/导入
+ * 两种格式：
+ *   - 16 位灰度 PNG，距离量化到 1mm(1..65534)，0 表示未观测，65535 表示远距离读数(+inf)，
+ *     超过 65.534m 的距离截断为 65.534m；深度图的分辨率、偏移与位姿写在 tEXt 块中，默认压缩等级 1，编码速度优先。
+ *   - raw：128 字节文件头 + width*height 个 float 距离，无损，读取时直接 mmap，不经过中间缓冲。
+ *     raw 只按本机字节序读写；PNG 按字节拼出大端序的采样，与机器字节序无关。
+ * RangeImageArchiver 用若干后台线程编码写盘，适合每帧一张图的批量归档。
+ * 只支持球面投影的 pcl::RangeImage，RangeImagePlanar 的内参不在保存范围内。
+ */
+#pragma once
+
+#include <algorithm>
+#include <cmath>
+#include <condition_variable>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <deque>
+#include <limits>
+#include <mutex>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <png.h>
+
+#include <pcl/point_types.h>
+#include <pcl/range_image/range_image.h>
+
+#include "parallel.h"
+
+enum RangeImageFileFormat {
+    RANGE_IMAGE_PNG16 = 0, RANGE_IMAGE_RAW = 1
+};
+
+//raw 格式的文件头，距离数据从第 128 字节开始
+struct RangeImageFileHeader {
+    char magic[8];                  //"RIMGRAW"
+    std::uint32_t version;
+    std::uint32_t width, height;
+    std::int32_t image_offset_x, image_offset_y;
+    float angular_resolution_x, angular_resolution_y;
+    float to_world_system[12];      //3x4 仿射矩阵，按行存储
+    std::uint32_t reserved;
+};
+static_assert(sizeof(RangeImageFileHeader) <= 128, "range image header grew");
+
+//写盘前的快照：复制距离与元数据后原图可以立即被下一帧覆盖
+struct RangeImageSnapshot {
+    RangeImageFileHeader header;
+    std::vector<float> ranges;
+};
+
+namespace range_image_io_detail {
+    const std::size_t kRawDataOffset = 128;
+    const char kRawMagic[8] = "RIMGRAW";
+    const char kPngKey[] = "pcl_range_image";
+    const float kMillimetre = 0.001f;
+
+    inline void
+    fillHeader(const pcl::RangeImage &image, RangeImageFileHeader &header) {
+        std::memset(&header, 0, sizeof(header));
+        std::memcpy(header.magic, kRawMagic, sizeof(kRawMagic));
+        header.version = 1;
+        header.width = image.width;
+        header.height = image.height;
+        header.image_offset_x = image.getImageOffsetX();
+        header.image_offset_y = image.getImageOffsetY();
+        header.angular_resolution_x = image.getAngularResolutionX();
+        header.angular_resolution_y = image.getAngularResolutionY();
+        const Eigen::Affine3f &to_world = image.getTransformationToWorldSystem();
+        for (int r = 0; r < 3; ++r)
+            for (int c = 0; c < 4; ++c)
+                header.to_world_system[r * 4 + c] = to_world(r, c);
+    }
+
+    //按文件头恢复深度图的投影参数，再由距离重建三维点
+    inline void
+    applyHeader(const RangeImageFileHeader &header, const float *ranges, pcl::RangeImage &image, int nr_threads) {
+        Eigen::Affine3f to_world(Eigen::Affine3f::Identity());
+        for (int r = 0; r < 3; ++r)
+            for (int c = 0; c < 4; ++c)
+                to_world(r, c) = header.to_world_system[r * 4 + c];
+        image.setAngularResolution(header.angular_resolution_x, header.angular_resolution_y);
+        image.setImageOffsets(header.image_offset_x, header.image_offset_y);
+        image.setTransformationToRangeImageSystem(to_world.inverse(Eigen::Isometry));
+        image.width = header.width;
+        image.height = header.height;
+        image.is_dense = false;
+        image.points.resize(static_cast<std::size_t>(header.width) * header.height);
+        const int w = static_cast<int>(header.width);
+        const float nan = std::numeric_limits<float>::quiet_NaN();
+        parallelFor(0, static_cast<int>(header.height), [&](int y) {
+            for (int x = 0; x < w; ++x) {
+                pcl::PointWithRange &point = image.points[y * w + x];
+                point.range = ranges[y * w + x];
+                if (std::isinf(point.range))
+                    point.x = point.y = point.z = nan;
+                else
+                    image.calculate3DPoint(static_cast<float>(x), static_cast<float>(y), point.range, point);
+            }
+        }, nr_threads);
+    }
+
+    inline bool
+    writeRaw(const RangeImageSnapshot &snapshot, const std::string &filename) {
+        FILE *file = std::fopen(filename.c_str(), "wb");
+        if (file == nullptr)
+            return false;
+        char header[kRawDataOffset] = {0};
+        std::memcpy(header, &snapshot.header, sizeof(snapshot.header));
+        bool ok = std::fwrite(header, 1, sizeof(header), file) == sizeof(header) &&
+                  std::fwrite(snapshot.ranges.data(), sizeof(float), snapshot.ranges.size(), file) ==
+                  snapshot.ranges.size();
+        return std::fclose(file) == 0 && ok;
+    }
+
+    inline std::string
+    headerToText(const RangeImageFileHeader &header) {
+        std::ostringstream text;
+        text.precision(9);
+        text << header.version << ' ' << header.width << ' ' << header.height << ' '
+             << header.image_offset_x << ' ' << header.image_offset_y << ' '
+             << header.angular_resolution_x << ' ' << header.angular_resolution_y << ' ' << kMillimetre;
+        for (float value: header.to_world_system)
+            text << ' ' << value;
+        return text.str();
+    }
+
+    inline bool
+    textToHeader(const std::string &text, RangeImageFileHeader &header, float &scale) {
+        std::memset(&header, 0, sizeof(header));
+        std::istringstream in(text);
+        in >> header.version >> header.width >> header.height >> header.image_offset_x >> header.image_offset_y
+           >> header.angular_resolution_x >> header.angular_resolution_y >> scale;
+        for (float &value: header.to_world_system)
+            in >> value;
+        return !in.fail() && header.version == 1;
+    }
+
+    inline bool
+    writePng(const RangeImageSnapshot &snapshot, const std::string &filename, int compression_level) {
+        const RangeImageFileHeader &header = snapshot.header;
+        FILE *file = std::fopen(filename.c_str(), "wb");
+        if (file == nullptr)
+            return false;
+        png_structp png = png_create_write_struct(PNG_LIBPNG_VER_STRING, nullptr, nullptr, nullptr);
+        png_infop info = png ? png_create_info_struct(png) : nullptr;
+        //行缓冲放在 setjmp 之前，libpng 出错跳回时不会泄漏
+        std::vector<png_byte> row(static_cast<std::size_t>(header.width) * 2);
+        std::string text = headerToText(header);
+        if (info == nullptr || setjmp(png_jmpbuf(png))) {
+            png_destroy_write_struct(&png, &info);
+            std::fclose(file);
+            return false;
+        }
+        png_init_io(png, file);
+        png_set_IHDR(png, info, header.width, header.height, 16, PNG_COLOR_TYPE_GRAY, PNG_INTERLACE_NONE,
+                     PNG_COMPRESSION_TYPE_DEFAULT, PNG_FILTER_TYPE_DEFAULT);
+        //只用 SUB 滤波并降低压缩等级，编码时间远小于默认的自适应滤波 + 等级 6
+        png_set_filter(png, PNG_FILTER_TYPE_BASE, PNG_FILTER_SUB);
+        png_set_compression_level(png, compression_level);
+        png_text text_chunk;
+        std::memset(&text_chunk, 0, sizeof(text_chunk));
+        text_chunk.compression = PNG_TEXT_COMPRESSION_NONE;
+        text_chunk.key = const_cast<char *>(kPngKey);
+        text_chunk.text = const_cast<char *>(text.c_str());
+        text_chunk.text_length = text.size();
+        png_set_text(png, info, &text_chunk, 1);
+        png_write_info(png, info);
+
+        const float inv_scale = 1.0f / kMillimetre;
+        for (std::uint32_t y = 0; y < header.height; ++y) {
+            const float *ranges = &snapshot.ranges[static_cast<std::size_t>(y) * header.width];
+            for (std::uint32_t x = 0; x < header.width; ++x) {
+                const float range = ranges[x];
+                std::uint16_t value;
+                if (range == std::numeric_limits<float>::infinity())
+                    value = 65535;
+                else if (!std::isfinite(range) || range <= 0.0f)
+                    value = 0;
+                else
+                    value = static_cast<std::uint16_t>(std::min(65534.0f, std::max(1.0f, std::round(range * inv_scale))));
+                //PNG 的 16 位采样是大端序
+                row[2 * x] = static_cast<png_byte>(value >> 8);
+                row[2 * x + 1] = static_cast<png_byte>(value & 0xff);
+            }
+            png_write_row(png, row.data());
+        }
+        png_write_end(png, nullptr);
+        png_destroy_write_struct(&png, &info);
+        return std::fclose(file) == 0;
+    }
+
+    inline bool
+    readPng(const std::string &filename, RangeImageFileHeader &header, std::vector<float> &ranges) {
+        FILE *file = std::fopen(filename.c_str(), "rb");
+        if (file == nullptr)
+            return false;
+        png_structp png = png_create_read_struct(PNG_LIBPNG_VER_STRING, nullptr, nullptr, nullptr);
+        png_infop info = png ? png_create_info_struct(png) : nullptr;
+        std::vector<png_byte> row;
+        if (info == nullptr || setjmp(png_jmpbuf(png))) {
+            png_destroy_read_struct(&png, &info, nullptr);
+            std::fclose(file);
+            return false;
+        }
+        png_init_io(png, file);
+        png_read_info(png, info);
+
+        float scale = 0.0f;
+        bool has_header = false;
+        png_textp texts = nullptr;
+        int nr_texts = png_get_text(png, info, &texts, nullptr);
+        for (int i = 0; i < nr_texts && !has_header; ++i)
+            if (std::strcmp(texts[i].key, kPngKey) == 0)
+                has_header = textToHeader(texts[i].text, header, scale);
+        if (!has_header || png_get_bit_depth(png, info) != 16 || png_get_color_type(png, info) != PNG_COLOR_TYPE_GRAY ||
+            png_get_image_width(png, info) != header.width || png_get_image_height(png, info) != header.height) {
+            png_destroy_read_struct(&png, &info, nullptr);
+            std::fclose(file);
+            return false;
+        }
+        png_read_update_info(png, info);
+
+        row.resize(static_cast<std::size_t>(header.width) * 2);
+        ranges.resize(static_cast<std::size_t>(header.width) * header.height);
+        for (std::uint32_t y = 0; y < header.height; ++y) {
+            png_read_row(png, row.data(), nullptr);
+            float *out = &ranges[static_cast<std::size_t>(y) * header.width];
+            for (std::uint32_t x = 0; x < header.width; ++x) {
+                //PNG 的 16 位采样是大端序
+                const png_uint_16 value = static_cast<png_uint_16>((row[2 * x] << 8) | row[2 * x + 1]);
+                out[x] = value == 0 ? -std::numeric_limits<float>::infinity()
+                                    : value == 65535 ? std::numeric_limits<float>::infinity()
+                                                     : static_cast<float>(value) * scale;
+            }
+        }
+        png_read_end(png, nullptr);
+        png_destroy_read_struct(&png, &info, nullptr);
+        std::fclose(file);
+        return true;
+    }
+
+    inline bool
+    hasExtension(const std::string &filename, const std::string &extension) {
+        return filename.size() >= extension.size() &&
+               filename.compare(filename.size() - extension.size(), extension.size(), extension) == 0;
+    }
+}
+
+inline RangeImageSnapshot
+makeRangeImageSnapshot(const pcl::RangeImage &image) {
+    RangeImageSnapshot snapshot;
+    range_image_io_detail::fillHeader(image, snapshot.header);
+    snapshot.ranges.resize(image.points.size());
+    for (std::size_t i = 0; i < image.points.size(); ++i)
+        snapshot.ranges[i] = image.points[i].range;
+    return snapshot;
+}
+
+inline bool
+saveRangeImage(const RangeImageSnapshot &snapshot, const std::string &filename, RangeImageFileFormat format,
+               int compression_level = 1) {
+    if (format == RANGE_IMAGE_RAW)
+        return range_image_io_detail::writeRaw(snapshot, filename);
+    return range_image_io_detail::writePng(snapshot, filename, compression_level);
+}
+
+inline bool
+saveRangeImage(const pcl::RangeImage &image, const std::string &filename, RangeImageFileFormat format,
+               int compression_level = 1) {
+    return saveRangeImage(makeRangeImageSnapshot(image), filename, format, compression_level);
+}
+
+//raw 文件的只读映射，ranges() 直接指向文件内容
+class RangeImageFileView {
+public:
+    RangeImageFileView() : data_(nullptr), size_(0) {}
+
+    explicit RangeImageFileView(const std::string &filename) : data_(nullptr), size_(0) {
+        open(filename);
+    }
+
+    ~RangeImageFileView() {
+        close();
+    }
+
+    RangeImageFileView(const RangeImageFileView &) = delete;
+
+    RangeImageFileView &operator=(const RangeImageFileView &) = delete;
+
+    bool
+    open(const std::string &filename) {
+        close();
+        int fd = ::open(filename.c_str(), O_RDONLY);
+        if (fd < 0)
+            return false;
+        struct stat st;
+        if (fstat(fd, &st) == 0 && static_cast<std::size_t>(st.st_size) >= range_image_io_detail::kRawDataOffset) {
+            void *data = mmap(nullptr, static_cast<std::size_t>(st.st_size), PROT_READ, MAP_PRIVATE, fd, 0);
+            if (data != MAP_FAILED) {
+                data_ = data;
+                size_ = static_cast<std::size_t>(st.st_size);
+            }
+        }
+        ::close(fd);
+        if (data_ == nullptr)
+            return false;
+        const RangeImageFileHeader &h = header();
+        const std::size_t expected = range_image_io_detail::kRawDataOffset +
+                                     static_cast<std::size_t>(h.width) * h.height * sizeof(float);
+        if (std::memcmp(h.magic, range_image_io_detail::kRawMagic, sizeof(h.magic)) != 0 || h.version != 1 ||
+            size_ < expected) {
+            close();
+            return false;
+        }
+        //顺序读取整张图，提示内核预读
+        madvise(data_, size_, MADV_SEQUENTIAL);
+        return true;
+    }
+
+    void
+    close() {
+        if (data_ != nullptr)
+            munmap(data_, size_);
+        data_ = nullptr;
+        size_ = 0;
+    }
+
+    bool
+    isOpen() const {
+        return data_ != nullptr;
+    }
+
+    const RangeImageFileHeader &
+    header() const {
+        return *static_cast<const RangeImageFileHeader *>(data_);
+    }
+
+    const float *
+    ranges() const {
+        return reinterpret_cast<const float *>(static_cast<const char *>(data_) + range_image_io_detail::kRawDataOffset);
+    }
+
+private:
+    void *data_;
+    std::size_t size_;
+};
+
+//按扩展名(.png / 其他视为 raw)读取并重建深度图，三维点按行并行计算
+inline bool
+loadRangeImage(const std::string &filename, pcl::RangeImage &image, int nr_threads = 0) {
+    if (range_image_io_detail::hasExtension(filename, ".png")) {
+        RangeImageFileHeader header;
+        std::vector<float> ranges;
+        if (!range_image_io_detail::readPng(filename, header, ranges))
+            return false;
+        range_image_io_detail::applyHeader(header, ranges.data(), image, nr_threads);
+        return true;
+    }
+    RangeImageFileView view;
+    if (!view.open(filename))
+        return false;
+    range_image_io_detail::applyHeader(view.header(), view.ranges(), image, nr_threads);
+    return true;
+}
+
+/**
+ * 后台批量写盘：push 时只复制距离数组，编码和写文件在工作线程中完成，
+ * 队列满时 push 阻塞，防止内存无限增长。flush 等待全部写完并返回是否都成功。
+ */
+class RangeImageArchiver {
+public:
+    explicit RangeImageArchiver(RangeImageFileFormat format = RANGE_IMAGE_PNG16, int nr_threads = 0,
+                                std::size_t max_queue_size = 16, int compression_level = 1)
+            : format_(format), compression_level_(compression_level), max_queue_size_(std::max<std::size_t>(1, max_queue_size)),
+              pending_(0), failed_(0), stop_(false) {
+        const unsigned int threads = getNumberOfThreads(nr_threads);
+        for (unsigned int t = 0; t < threads; ++t)
+            workers_.emplace_back([this] { run(); });
+    }
+
+    ~RangeImageArchiver() {
+        flush();
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            stop_ = true;
+        }
+        queue_changed_.notify_all();
+        for (std::thread &worker: workers_)
+            worker.join();
+    }
+
+    RangeImageArchiver(const RangeImageArchiver &) = delete;
+
+    RangeImageArchiver &operator=(const RangeImageArchiver &) = delete;
+
+    void
+    push(const pcl::RangeImage &image, const std::string &filename) {
+        Job job{makeRangeImageSnapshot(image), filename};
+        std::unique_lock<std::mutex> lock(mutex_);
+        queue_changed_.wait(lock, [this] { return queue_.size() < max_queue_size_; });
+        queue_.push_back(std::move(job));
+        ++pending_;
+        lock.unlock();
+        queue_changed_.notify_all();
+    }
+
+    //等待已提交的图像全部写完，返回期间是否没有失败
+    bool
+    flush() {
+        std::unique_lock<std::mutex> lock(mutex_);
+        idle_.wait(lock, [this] { return pending_ == 0; });
+        const bool ok = failed_ == 0;
+        failed_ = 0;
+        return ok;
+    }
+
+private:
+    struct Job {
+        RangeImageSnapshot snapshot;
+        std::string filename;
+    };
+
+    void
+    run() {
+        for (;;) {
+            std::unique_lock<std::mutex> lock(mutex_);
+            queue_changed_.wait(lock, [this] { return stop_ || !queue_.empty(); });
+            if (queue_.empty())
+                return;
+            Job job = std::move(queue_.front());
+            queue_.pop_front();
+            lock.unlock();
+            queue_changed_.notify_all();
+
+            const bool ok = saveRangeImage(job.snapshot, job.filename, format_, compression_level_);
+
+            lock.lock();
+            if (!ok)
+                ++failed_;
+            if (--pending_ == 0)
+                idle_.notify_all();
+        }
+    }
+
+    RangeImageFileFormat format_;
+    int compression_level_;
+    std::size_t max_queue_size_, pending_, failed_;
+    bool stop_;
+    std::deque<Job> queue_;
+    std::mutex mutex_;
+    std::condition_variable queue_changed_, idle_;
+    std::vector<std::thread> workers_;
+};
@@ -0,0 +1,250 @@
+/*
+ * 多线程深度图生成
+ * RangeImageParallel::createFromPointCloudParallel 与 pcl::RangeImage::createFromPointCloud 参数相同，
+ * noise_level == 0 时结果逐像素一致；createPlanarFromOrganizedCloud 为有序点云(640x480等)提供直接按像素填充的快速路径。
+ */
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <limits>
+#include <vector>
+
+#include <pcl/point_types.h>
+#include <pcl/range_image/range_image.h>
+#include <pcl/range_image/range_image_planar.h>
+
+#include "parallel.h"
+
+class RangeImageParallel : public pcl::RangeImage {
+public:
+    typedef boost::shared_ptr<RangeImageParallel> Ptr;
+
+    RangeImageParallel() : nr_threads_(0) {}
+
+    //设置线程数，0 表示使用全部硬件线程
+    void
+    setNumberOfThreads(int nr_threads) {
+        nr_threads_ = nr_threads;
+    }
+
+    template<typename PointCloudType>
+    void
+    createFromPointCloudParallel(const PointCloudType &point_cloud, float angular_resolution,
+                                 float max_angle_width, float max_angle_height,
+                                 const Eigen::Affine3f &sensor_pose,
+                                 CoordinateFrame coordinate_frame = CAMERA_FRAME,
+                                 float noise_level = 0.0f, float min_range = 0.0f, int border_size = 0) {
+        //与 RangeImage::createFromPointCloud 相同的图像尺寸与坐标系设置
+        setAngularResolution(angular_resolution);
+        width = static_cast<std::uint32_t>(std::lrint(std::floor(max_angle_width * angular_resolution_x_reciprocal_)));
+        height = static_cast<std::uint32_t>(std::lrint(std::floor(max_angle_height * angular_resolution_y_reciprocal_)));
+        int full_width = static_cast<int>(std::lrint(std::floor(pcl::deg2rad(360.0f) * angular_resolution_x_reciprocal_)));
+        int full_height = static_cast<int>(std::lrint(std::floor(pcl::deg2rad(180.0f) * angular_resolution_y_reciprocal_)));
+        image_offset_x_ = (full_width - static_cast<int>(width)) / 2;
+        image_offset_y_ = (full_height - static_cast<int>(height)) / 2;
+        is_dense = false;
+
+        getCoordinateFrameTransformation(coordinate_frame, to_world_system_);
+        to_world_system_ = sensor_pose * to_world_system_;
+        to_range_image_system_ = to_world_system_.inverse(Eigen::Isometry);
+
+        points.clear();
+        points.resize(width * height, unobserved_point);
+
+        int top = height, right = -1, bottom = -1, left = width;
+        //noise_level>0 时 z-buffer 会对相近的点求平均，结果依赖点的顺序，只能走原来的串行实现
+        if (noise_level > 0.0f)
+            doZBuffer(point_cloud, noise_level, min_range, top, right, bottom, left);
+        else
+            doZBufferParallel(point_cloud, min_range, top, right, bottom, left);
+
+        cropImage(border_size, top, right, bottom, left);
+        recalculate3DPointPositionsParallel();
+    }
+
+    //按行并行的 recalculate3DPointPositions
+    void
+    recalculate3DPointPositionsParallel() {
+        const int w = static_cast<int>(width);
+        parallelFor(0, static_cast<int>(height), [this, w](int y) {
+            for (int x = 0; x < w; ++x) {
+                pcl::PointWithRange &point = points[y * w + x];
+                if (!std::isinf(point.range))
+                    calculate3DPoint(static_cast<float>(x), static_cast<float>(y), point.range, point);
+            }
+        }, nr_threads_);
+    }
+
+protected:
+    //距离非负，float 的位模式与数值同序，可以直接用 uint32 做原子取最小
+    static std::uint32_t
+    rangeToBits(float range) {
+        std::uint32_t bits;
+        std::memcpy(&bits, &range, sizeof(bits));
+        return bits;
+    }
+
+    static float
+    bitsToRange(std::uint32_t bits) {
+        float range;
+        std::memcpy(&range, &bits, sizeof(range));
+        return range;
+    }
+
+    static void
+    atomicMin(std::atomic<std::uint32_t> &target, std::uint32_t value) {
+        std::uint32_t current = target.load(std::memory_order_relaxed);
+        while (value < current && !target.compare_exchange_weak(current, value, std::memory_order_relaxed));
+    }
+
+    /**
+     * 串行 doZBuffer 在 noise_level==0 时等价于：
+     * 被点直接投影到的像素取所有直接命中距离的最小值；
+     * 没有被直接命中、但作为 floor/ceil 邻居被“插值”到的像素取所有邻居贡献的最小值。
+     * 两者都与点的处理顺序无关，所以可以用两张原子最小值缓冲区并行完成。
+     */
+    template<typename PointCloudType>
+    void
+    doZBufferParallel(const PointCloudType &point_cloud, float min_range,
+                      int &top, int &right, int &bottom, int &left) {
+        const int w = static_cast<int>(width), h = static_cast<int>(height);
+        const std::size_t size = static_cast<std::size_t>(w) * h;
+        const std::uint32_t empty = rangeToBits(std::numeric_limits<float>::infinity());
+        std::vector<std::atomic<std::uint32_t> > direct(size), interpolated(size);
+        parallelFor(0, static_cast<int>(size), [&](int i) {
+            direct[i].store(empty, std::memory_order_relaxed);
+            interpolated[i].store(empty, std::memory_order_relaxed);
+        }, nr_threads_);
+
+        //每个线程记录自己的包围框，最后合并
+        const int nr_threads = static_cast<int>(getNumberOfThreads(nr_threads_));
+        std::vector<int> tops(nr_threads, h), rights(nr_threads, -1), bottoms(nr_threads, -1), lefts(nr_threads, w);
+
+        const auto &cloud_points = point_cloud.points;
+        parallelForChunks(0, static_cast<int>(cloud_points.size()), [&](int thread_id, int begin, int end) {
+            int &t_top = tops[thread_id], &t_right = rights[thread_id],
+                    &t_bottom = bottoms[thread_id], &t_left = lefts[thread_id];
+            float x_real, y_real, range_of_current_point;
+            int x, y;
+            for (int i = begin; i < end; ++i) {
+                if (!pcl::isFinite(cloud_points[i]))
+                    continue;
+                Eigen::Vector3f current_point(cloud_points[i].x, cloud_points[i].y, cloud_points[i].z);
+                getImagePoint(current_point, x_real, y_real, range_of_current_point);
+                real2DToInt2D(x_real, y_real, x, y);
+                if (range_of_current_point < min_range || !isInImage(x, y))
+                    continue;
+
+                const std::uint32_t range_bits = rangeToBits(range_of_current_point);
+                int floor_x = static_cast<int>(std::lrint(std::floor(x_real))),
+                        floor_y = static_cast<int>(std::lrint(std::floor(y_real))),
+                        ceil_x = static_cast<int>(std::lrint(std::ceil(x_real))),
+                        ceil_y = static_cast<int>(std::lrint(std::ceil(y_real)));
+                const int neighbor_x[4] = {floor_x, floor_x, ceil_x, ceil_x};
+                const int neighbor_y[4] = {floor_y, ceil_y, floor_y, ceil_y};
+                for (int n = 0; n < 4; ++n) {
+                    int n_x = neighbor_x[n], n_y = neighbor_y[n];
+                    if ((n_x == x && n_y == y) || !isInImage(n_x, n_y))
+                        continue;
+                    atomicMin(interpolated[n_y * w + n_x], range_bits);
+                    t_top = std::min(t_top, n_y);
+                    t_right = std::max(t_right, n_x);
+                    t_bottom = std::max(t_bottom, n_y);
+                    t_left = std::min(t_left, n_x);
+                }
+
+                atomicMin(direct[y * w + x], range_bits);
+                t_top = std::min(t_top, y);
+                t_right = std::max(t_right, x);
+                t_bottom = std::max(t_bottom, y);
+                t_left = std::min(t_left, x);
+            }
+        }, nr_threads);
+
+        top = h;
+        right = -1;
+        bottom = -1;
+        left = w;
+        for (int t = 0; t < nr_threads; ++t) {
+            top = std::min(top, tops[t]);
+            right = std::max(right, rights[t]);
+            bottom = std::max(bottom, bottoms[t]);
+            left = std::min(left, lefts[t]);
+        }
+
+        parallelFor(0, static_cast<int>(size), [&](int i) {
+            std::uint32_t bits = direct[i].load(std::memory_order_relaxed);
+            if (bits == empty)
+                bits = interpolated[i].load(std::memory_order_relaxed);
+            if (bits != empty)
+                points[i].range = bitsToRange(bits);
+        }, nr_threads_);
+    }
+
+    int nr_threads_;
+};
+
+/**
+ * 有序点云快速路径：点云本身就是相机图像，每个点对应一个像素，不需要球面投影和 z-buffer。
+ * 从有效点用最小二乘恢复相机内参 u = fx*x/z + cx, v = fy*y/z + cy，然后直接把 z 当作深度图交给 RangeImagePlanar。
+ * 要求点云位于相机坐标系（RGB-D 驱动输出的点云即是如此）；内参无法恢复时返回 false，调用者应回退到球面投影。
+ */
+template<typename PointT>
+bool
+createPlanarFromOrganizedCloud(const pcl::PointCloud<PointT> &cloud, pcl::RangeImagePlanar &range_image,
+                               int nr_threads = 0, int sample_step = 4) {
+    if (!cloud.isOrganized())
+        return false;
+    const int w = static_cast<int>(cloud.width), h = static_cast<int>(cloud.height);
+
+    //按行分块累加最小二乘的法方程，每个线程一份
+    const int threads = static_cast<int>(getNumberOfThreads(nr_threads));
+    std::vector<std::array<double, 9> > sums(threads, std::array<double, 9>());
+    parallelForChunks(0, (h + sample_step - 1) / sample_step, [&](int thread_id, int begin, int end) {
+        std::array<double, 9> &s = sums[thread_id];
+        for (int row = begin; row < end; ++row) {
+            int v = row * sample_step;
+            for (int u = 0; u < w; u += sample_step) {
+                const PointT &p = cloud.points[v * w + u];
+                if (!pcl::isFinite(p) || p.z <= 0.0f)
+                    continue;
+                double a = p.x / p.z, b = p.y / p.z;
+                s[0] += a * a;
+                s[1] += a;
+                s[2] += a * u;
+                s[3] += u;
+                s[4] += b * b;
+                s[5] += b;
+                s[6] += b * v;
+                s[7] += v;
+                s[8] += 1.0;
+            }
+        }
+    }, threads);
+    std::array<double, 9> s = std::array<double, 9>();
+    for (const auto &partial: sums)
+        for (int k = 0; k < 9; ++k)
+            s[k] += partial[k];
+    const double n = s[8];
+    const double det_x = s[0] * n - s[1] * s[1], det_y = s[4] * n - s[5] * s[5];
+    if (n < 3.0 || std::abs(det_x) < 1e-12 || std::abs(det_y) < 1e-12)
+        return false;
+    const float focal_x = static_cast<float>((s[2] * n - s[1] * s[3]) / det_x);
+    const float center_x = static_cast<float>((s[0] * s[3] - s[1] * s[2]) / det_x);
+    const float focal_y = static_cast<float>((s[6] * n - s[5] * s[7]) / det_y);
+    const float center_y = static_cast<float>((s[4] * s[7] - s[5] * s[6]) / det_y);
+    if (!(focal_x > 0.0f) || !(focal_y > 0.0f))
+        return false;
+
+    std::vector<float> depth(static_cast<std::size_t>(w) * h);
+    parallelFor(0, w * h, [&](int i) {
+        const PointT &p = cloud.points[i];
+        depth[i] = (pcl::isFinite(p) && p.z > 0.0f) ? p.z : std::numeric_limits<float>::quiet_NaN();
+    }, threads);
+    range_image.setDepthImage(depth.data(), w, h, center_x, center_y, focal_x, focal_y);
+    return true;
+}
@@ -0,0 +1,280 @@
+/*
+ * 带时间预算的配准
+ *   - SampleConsensusPrerejectiveAnytime：与 pcl::SampleConsensusPrerejective 相同的位姿假设循环，每次迭代前检查预算，
+ *     到时返回目前最好的位姿；可以用 setQuantizedFeatures 直接在量化描述子上匹配(L1 距离，不建 FLANN 树)，
+ *     或用 setCorrespondenceTable 传入预先算好的对应点表(descriptor_index.h)，迭代中只查表；
+ *   - alignWithBudget：NDT / ICP 等迭代配准每次只走一步(setMaximumIterations(1))，以上一步的结果作为初值，
+ *     两步之间检查预算；收敛判断沿用各自的 transformation epsilon 判据(见 anytimeStepConverged)。
+ */
+#pragma once
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <functional>
+#include <limits>
+#include <vector>
+
+#include <Eigen/Geometry>
+
+#include <pcl/common/eigen.h>
+#include <pcl/common/transforms.h>
+#include <pcl/registration/ndt.h>
+#include <pcl/registration/sample_consensus_prerejective.h>
+
+#include "anytime.h"
+#include "compact_features.h"
+#include "descriptor_index.h"
+
+template<typename PointSource, typename PointTarget, typename FeatureT>
+class SampleConsensusPrerejectiveAnytime : public pcl::SampleConsensusPrerejective<PointSource, PointTarget, FeatureT> {
+public:
+    typedef pcl::SampleConsensusPrerejective<PointSource, PointTarget, FeatureT> Base;
+    typedef typename Base::PointCloudSource PointCloudSource;
+    typedef typename Base::Matrix4 Matrix4;
+
+    SampleConsensusPrerejectiveAnytime()
+            : status_(ANYTIME_FAILED), iterations_(0), quantized_source_size_(0), quantized_target_size_(0) {}
+
+    void setBudget(const AnytimeBudget &budget) { budget_ = budget; }
+
+    AnytimeStatus getStatus() const { return status_; }
+
+    //实际生成的位姿假设数
+    int getIterations() const { return iterations_; }
+
+    /**
+     * 用量化描述子代替 setSourceFeatures/setTargetFeatures：对应点取 L1 距离最近的 k 个(setCorrespondenceRandomness)
+     * 之一。设置后不再需要浮点描述子；传入空指针恢复使用浮点描述子。
+     */
+    template<typename QuantizedT>
+    void
+    setQuantizedFeatures(const boost::shared_ptr<const std::vector<QuantizedT> > &source,
+                         const boost::shared_ptr<const std::vector<QuantizedT> > &target) {
+        if (!source || !target) {
+            quantized_lookup_ = nullptr;
+            return;
+        }
+        typename QuantizedFeatureMatcher<QuantizedT>::Ptr matcher(new QuantizedFeatureMatcher<QuantizedT>);
+        matcher->setInputTarget(target);
+        quantized_source_size_ = source->size();
+        quantized_target_size_ = target->size();
+        quantized_lookup_ = [source, matcher](int index, int k, std::vector<int> &similar) {
+            std::vector<std::uint32_t> distances;
+            matcher->nearestKSearch((*source)[index], k, similar, distances);
+        };
+    }
+
+    /**
+     * 使用预先算好的对应点表(buildCorrespondenceTable)，对应点取表中该行前 setCorrespondenceRandomness 个之一，
+     * 表的 k 小于它时只用前 k 个。与 setQuantizedFeatures 互相替换；传入空指针取消。
+     */
+    void
+    setCorrespondenceTable(const CorrespondenceTable::ConstPtr &table) {
+        if (!table) {
+            quantized_lookup_ = nullptr;
+            return;
+        }
+        quantized_source_size_ = table->size();
+        quantized_target_size_ = table->target_size;
+        quantized_lookup_ = [table](int index, int k, std::vector<int> &similar) {
+            const int *row = table->row(index);
+            similar.assign(row, row + std::min(k, table->counts[index]));
+        };
+    }
+
+protected:
+    using Base::converged_;
+    using Base::correspondence_rejector_poly_;
+    using Base::final_transformation_;
+    using Base::inlier_fraction_;
+    using Base::inliers_;
+    using Base::input_;
+    using Base::input_features_;
+    using Base::k_correspondences_;
+    using Base::max_iterations_;
+    using Base::nr_samples_;
+    using Base::target_;
+    using Base::target_features_;
+    using Base::transformation_;
+    using Base::transformation_estimation_;
+
+    //与 SampleConsensusPrerejective::computeTransformation 相同，只是在每次迭代前检查预算
+    void
+    computeTransformation(PointCloudSource &output, const Matrix4 &guess) override {
+        status_ = ANYTIME_FAILED;
+        iterations_ = 0;
+        const bool features_valid = quantized_lookup_
+                                    ? input_->size() == quantized_source_size_ && target_->size() == quantized_target_size_
+                                    : input_features_ && target_features_ && input_->size() == input_features_->size() &&
+                                      target_->size() == target_features_->size();
+        if (!features_valid || inlier_fraction_ < 0.0f || inlier_fraction_ > 1.0f || k_correspondences_ <= 0) {
+            PCL_ERROR("[SampleConsensusPrerejectiveAnytime::computeTransformation] invalid input or parameters!\n");
+            return;
+        }
+        const float similarity_threshold = correspondence_rejector_poly_->getSimilarityThreshold();
+        if (similarity_threshold < 0.0f || similarity_threshold >= 1.0f) {
+            PCL_ERROR("[SampleConsensusPrerejectiveAnytime::computeTransformation] invalid similarity threshold!\n");
+            return;
+        }
+
+        correspondence_rejector_poly_->setInputSource(input_);
+        correspondence_rejector_poly_->setInputTarget(target_);
+        correspondence_rejector_poly_->setCardinality(nr_samples_);
+
+        final_transformation_ = guess;
+        inliers_.clear();
+        float lowest_error = std::numeric_limits<float>::max();
+        converged_ = false;
+
+        std::vector<int> inliers;
+        float inlier_fraction;
+        float error;
+
+        if (!guess.isApprox(Eigen::Matrix4f::Identity(), 0.01f)) {
+            this->getFitness(inliers, error);
+            inlier_fraction = static_cast<float>(inliers.size()) / static_cast<float>(input_->size());
+            error /= static_cast<float>(inliers.size());
+            if (inlier_fraction >= inlier_fraction_ && error < lowest_error) {
+                inliers_ = inliers;
+                lowest_error = error;
+                converged_ = true;
+            }
+        }
+
+        std::vector<std::vector<int> > similar_features(input_->size());
+        AnytimeStatus stop = ANYTIME_CONVERGED;
+        bool interrupted = false;
+        for (int i = 0; i < max_iterations_; ++i) {
+            if (budget_.stopRequested(&stop)) {
+                interrupted = true;
+                break;
+            }
+            ++iterations_;
+            std::vector<int> sample_indices;
+            std::vector<int> corresponding_indices;
+            this->selectSamples(*input_, nr_samples_, sample_indices);
+            if (quantized_lookup_) {
+                //对应点表中有空行时放弃这次采样
+                if (!findSimilarQuantized(sample_indices, similar_features, corresponding_indices))
+                    continue;
+            } else
+                this->findSimilarFeatures(sample_indices, similar_features, corresponding_indices);
+            //多边形相似性预拒绝
+            if (!correspondence_rejector_poly_->thresholdPolygon(sample_indices, corresponding_indices))
+                continue;
+
+            transformation_estimation_->estimateRigidTransformation(*input_, sample_indices, *target_,
+                                                                    corresponding_indices, transformation_);
+            const Matrix4 final_transformation_prev = final_transformation_;
+            final_transformation_ = transformation_;
+            this->getFitness(inliers, error);
+            final_transformation_ = final_transformation_prev;
+
+            inlier_fraction = static_cast<float>(inliers.size()) / static_cast<float>(input_->size());
+            if (inlier_fraction >= inlier_fraction_ && error < lowest_error) {
+                inliers_ = inliers;
+                lowest_error = error;
+                converged_ = true;
+                final_transformation_ = transformation_;
+            }
+        }
+
+        if (interrupted)
+            status_ = stop;
+        else
+            status_ = converged_ ? ANYTIME_CONVERGED : ANYTIME_FAILED;
+        if (converged_)
+            pcl::transformPointCloud(*input_, output, final_transformation_);
+    }
+
+    /**
+     * 与 SampleConsensusPrerejective::findSimilarFeatures 相同，近邻在量化描述子或对应点表中查找，结果按源点缓存。
+     * 有样本点找不到任何近邻时返回 false。
+     */
+    bool
+    findSimilarQuantized(const std::vector<int> &sample_indices, std::vector<std::vector<int> > &similar_features,
+                         std::vector<int> &corresponding_indices) {
+        corresponding_indices.resize(sample_indices.size());
+        for (std::size_t i = 0; i < sample_indices.size(); ++i) {
+            const int idx = sample_indices[i];
+            if (similar_features[idx].empty())
+                quantized_lookup_(idx, k_correspondences_, similar_features[idx]);
+            if (similar_features[idx].empty())
+                return false;
+            if (similar_features[idx].size() == 1)
+                corresponding_indices[i] = similar_features[idx][0];
+            else
+                corresponding_indices[i] =
+                        similar_features[idx][this->getRandomIndex(static_cast<int>(similar_features[idx].size()))];
+        }
+        return true;
+    }
+
+    AnytimeBudget budget_;
+    AnytimeStatus status_;
+    int iterations_;
+    std::function<void(int, int, std::vector<int> &)> quantized_lookup_;
+    std::size_t quantized_source_size_;
+    std::size_t quantized_target_size_;
+};
+
+/**
+ * 一步前后的变换是否满足配准自己的收敛判据。默认与 IterativeClosestPoint 设置的 DefaultConvergenceCriteria 的
+ * 变换部分相同：这一步的增量变换(next * previous⁻¹)平移的平方不超过 transformation epsilon，且旋转角的余弦
+ * 不小于 transformation rotation epsilon(未设置时为 1 - transformation epsilon)；
+ * 按均方误差相对变化(euclidean fitness epsilon)判断收敛的部分需要对应点，这里不检查。
+ * PCL 的 get 函数不是 const 的，所以按非 const 引用传入。
+ */
+template<typename RegistrationT>
+bool
+anytimeStepConverged(RegistrationT &registration, const Eigen::Matrix4f &previous, const Eigen::Matrix4f &next) {
+    const double epsilon = registration.getTransformationEpsilon();
+    const double rotation_epsilon = registration.getTransformationRotationEpsilon();
+    const double rotation_threshold = rotation_epsilon > 0.0 ? rotation_epsilon : 1.0 - epsilon;
+    const Eigen::Matrix4f delta = next * previous.inverse();
+    const double cosine = 0.5 * (static_cast<double>(delta.block<3, 3>(0, 0).trace()) - 1.0);
+    return cosine >= rotation_threshold && delta.block<3, 1>(0, 3).squaredNorm() <= epsilon;
+}
+
+//NDT：与 NormalDistributionsTransform::computeTransformation 相同，参数向量(平移 + 欧拉角)的步长小于 transformation epsilon
+template<typename PointSource, typename PointTarget>
+bool
+anytimeStepConverged(pcl::NormalDistributionsTransform<PointSource, PointTarget> &registration,
+                     const Eigen::Matrix4f &previous, const Eigen::Matrix4f &next) {
+    Eigen::Matrix<float, 6, 1> p, q;
+    pcl::getTranslationAndEulerAngles(Eigen::Affine3f(previous), p(0), p(1), p(2), p(3), p(4), p(5));
+    pcl::getTranslationAndEulerAngles(Eigen::Affine3f(next), q(0), q(1), q(2), q(3), q(4), q(5));
+    return (q - p).norm() < registration.getTransformationEpsilon();
+}
+
+/**
+ * 按步执行迭代配准(NDT、ICP 等)，每步之间检查预算。output 为按最终变换变换后的源点云，
+ * iterations 返回实际步数。注意 NDT 每步都重新开始 Moré-Thuente 线搜索，步长不跨步保留。
+ */
+template<typename RegistrationT, typename PointCloudT>
+AnytimeStatus
+alignWithBudget(RegistrationT &registration, PointCloudT &output, const Eigen::Matrix4f &guess,
+                int max_iterations, const AnytimeBudget &budget, int *iterations = nullptr) {
+    registration.setMaximumIterations(1);
+    Eigen::Matrix4f current = guess;
+    AnytimeStatus status = ANYTIME_MAX_ITERATIONS;
+    int step = 0;
+    while (step < max_iterations) {
+        if (step > 0 && budget.stopRequested(&status))
+            break;
+        registration.align(output, current);
+        ++step;
+        const Eigen::Matrix4f next = registration.getFinalTransformation();
+        const bool converged = anytimeStepConverged(registration, current, next);
+        current = next;
+        if (converged) {
+            status = ANYTIME_CONVERGED;
+            break;
+        }
+        status = ANYTIME_MAX_ITERATIONS;
+    }
+    if (iterations)
+        *iterations = step;
+    return status;
+}
@@ -0,0 +1,220 @@
+/*
+ * 在量化描述子上匹配的 SAC-IA
+ * SampleConsensusInitialAlignmentQuantized 继承 pcl::SampleConsensusInitialAlignment，参数设置相同。
+ * 用 setSourceQuantizedFeatures / setTargetQuantizedFeatures(compact_features.h 的 uint8/uint16 直方图)
+ * 代替浮点描述子：对应点取 L1 距离最近的 k 个之一，不建 FLANN 树，描述子不解码。
+ * 两个都设置时走这里的实现，否则交给 PCL。
+ * 也可以用 setCorrespondenceTable 传入预先算好的对应点表(descriptor_index.h)，每次迭代只查表，不再逐个比较描述子。
+ * 这两种情况下随机数取自对象自己的 std::mt19937，每次 align 都从 setSeed 的种子开始，结果可重复，
+ * 不同对象可以在不同线程中同时配准(PCL 的实现使用全局的 rand())。
+ * 每个位姿假设的误差逐点累加，累加值已不小于目前最小的误差时提前结束，这个假设不可能被采用，结果不变。
+ */
+#pragma once
+
+#include <algorithm>
+#include <cstdint>
+#include <limits>
+#include <random>
+#include <vector>
+
+#include <pcl/common/distances.h>
+#include <pcl/common/transforms.h>
+#include <pcl/registration/ia_ransac.h>
+
+#include "compact_features.h"
+#include "descriptor_index.h"
+
+template<typename PointSource, typename PointTarget, typename FeatureT, typename QuantizedT>
+class SampleConsensusInitialAlignmentQuantized
+        : public pcl::SampleConsensusInitialAlignment<PointSource, PointTarget, FeatureT> {
+public:
+    typedef pcl::SampleConsensusInitialAlignment<PointSource, PointTarget, FeatureT> Base;
+    typedef typename Base::PointCloudSource PointCloudSource;
+    typedef boost::shared_ptr<const std::vector<QuantizedT> > QuantizedFeaturesConstPtr;
+
+    SampleConsensusInitialAlignmentQuantized() : seed_(42) {}
+
+    void
+    setSourceQuantizedFeatures(const QuantizedFeaturesConstPtr &features) { source_quantized_ = features; }
+
+    void
+    setTargetQuantizedFeatures(const QuantizedFeaturesConstPtr &features) {
+        target_quantized_ = features;
+        matcher_.setInputTarget(features);
+    }
+
+    //设置后优先于量化描述子；表的行数须等于源点数，每行取前 min(k, setCorrespondenceRandomness) 个之一
+    void
+    setCorrespondenceTable(const CorrespondenceTable::ConstPtr &table) { table_ = table; }
+
+    //每次 align 开始时的随机种子
+    void
+    setSeed(unsigned int seed) { seed_ = seed; }
+
+protected:
+    using Base::converged_;
+    using Base::corr_dist_threshold_;
+    using Base::error_functor_;
+    using Base::final_transformation_;
+    using Base::input_;
+    using Base::k_correspondences_;
+    using Base::max_iterations_;
+    using Base::min_sample_distance_;
+    using Base::nr_samples_;
+    using Base::target_;
+    using Base::transformation_;
+    using Base::transformation_estimation_;
+    using Base::tree_;
+
+    //与 SampleConsensusInitialAlignment::computeTransformation 相同，只替换对应点的查找
+    void
+    computeTransformation(PointCloudSource &output, const Eigen::Matrix4f &guess) override {
+        if (!table_ && (!source_quantized_ || !target_quantized_)) {
+            Base::computeTransformation(output, guess);
+            return;
+        }
+        const bool size_valid = table_ ? input_->size() == table_->size() && target_->size() == table_->target_size
+                                       : input_->size() == source_quantized_->size() &&
+                                         target_->size() == target_quantized_->size();
+        if (!size_valid) {
+            PCL_ERROR("[SampleConsensusInitialAlignmentQuantized::computeTransformation] "
+                      "the number of quantized features does not match the number of points!\n");
+            return;
+        }
+        if (target_->empty()) {
+            PCL_ERROR("[SampleConsensusInitialAlignmentQuantized::computeTransformation] the target cloud is empty!\n");
+            return;
+        }
+        if (!error_functor_)
+            error_functor_.reset(new typename Base::TruncatedError(static_cast<float>(corr_dist_threshold_)));
+
+        rng_.seed(seed_);
+        std::vector<int> sample_indices(nr_samples_);
+        std::vector<int> corresponding_indices(nr_samples_);
+        PointCloudSource input_transformed;
+        float lowest_error = 0.0f;
+
+        final_transformation_ = guess;
+        int i_iter = 0;
+        bool has_error = false;
+        converged_ = false;
+        if (!guess.isApprox(Eigen::Matrix4f::Identity(), 0.01f)) {
+            pcl::transformPointCloud(*input_, input_transformed, final_transformation_);
+            lowest_error = this->computeErrorMetric(input_transformed, static_cast<float>(corr_dist_threshold_));
+            has_error = true;
+            i_iter = 1;
+        }
+
+        for (; i_iter < max_iterations_; ++i_iter) {
+            selectSamples(*input_, nr_samples_, min_sample_distance_, sample_indices);
+            //有样本点没有任何对应点时放弃这次采样
+            if (!findSimilarQuantized(sample_indices, corresponding_indices))
+                continue;
+            transformation_estimation_->estimateRigidTransformation(*input_, sample_indices, *target_,
+                                                                    corresponding_indices, transformation_);
+            pcl::transformPointCloud(*input_, input_transformed, transformation_);
+            const float error = computeErrorMetricBounded(
+                    input_transformed, has_error ? lowest_error : std::numeric_limits<float>::infinity());
+            if (!has_error || error < lowest_error) {
+                has_error = true;
+                lowest_error = error;
+                final_transformation_ = transformation_;
+                converged_ = true;
+            }
+        }
+        pcl::transformPointCloud(*input_, output, final_transformation_);
+    }
+
+    //对应点表中某行为空(或匹配器没有返回近邻)时返回 false
+    bool
+    findSimilarQuantized(const std::vector<int> &sample_indices, std::vector<int> &corresponding_indices) {
+        std::vector<int> nn_indices;
+        std::vector<std::uint32_t> nn_distances;
+        corresponding_indices.resize(sample_indices.size());
+        if (table_) {
+            for (std::size_t i = 0; i < sample_indices.size(); ++i) {
+                const int found = std::min(k_correspondences_, table_->counts[sample_indices[i]]);
+                if (found <= 0)
+                    return false;
+                corresponding_indices[i] = table_->row(sample_indices[i])[getRandomIndex(found)];
+            }
+            return true;
+        }
+        for (std::size_t i = 0; i < sample_indices.size(); ++i) {
+            const int found = matcher_.nearestKSearch((*source_quantized_)[sample_indices[i]], k_correspondences_,
+                                                      nn_indices, nn_distances);
+            if (found <= 0)
+                return false;
+            corresponding_indices[i] = nn_indices[getRandomIndex(found)];
+        }
+        return true;
+    }
+
+    /**
+     * 与 SampleConsensusInitialAlignment::computeErrorMetric 相同的截断误差之和，每项非负，
+     * 累加到不小于 bound 时直接返回(返回值不小于 bound，但不是完整的误差)
+     */
+    float
+    computeErrorMetricBounded(const PointCloudSource &cloud, float bound) {
+        std::vector<int> nn_index(1);
+        std::vector<float> nn_distance(1);
+        const typename Base::ErrorFunctor &compute_error = *error_functor_;
+        float error = 0.0f;
+        for (int i = 0; i < static_cast<int>(cloud.points.size()) && error < bound; ++i) {
+            tree_->nearestKSearch(cloud, i, 1, nn_index, nn_distance);
+            error += compute_error(nn_distance[0]);
+        }
+        return error;
+    }
+
+    //与 SampleConsensusInitialAlignment 相同的均匀取法，随机数来自 rng_
+    int
+    getRandomIndex(int n) {
+        return static_cast<int>(n * (static_cast<double>(rng_() - rng_.min()) /
+                                     (static_cast<double>(rng_.max() - rng_.min()) + 1.0)));
+    }
+
+    //与 SampleConsensusInitialAlignment::selectSamples 相同，只替换随机数来源
+    void
+    selectSamples(const PointCloudSource &cloud, int nr_samples, float min_sample_distance,
+                  std::vector<int> &sample_indices) {
+        if (nr_samples > static_cast<int>(cloud.points.size())) {
+            PCL_ERROR("[SampleConsensusInitialAlignmentQuantized::selectSamples] "
+                      "the number of samples (%d) must not be greater than the number of points (%zu)!\n",
+                      nr_samples, cloud.points.size());
+            return;
+        }
+        unsigned int iterations_without_a_sample = 0;
+        const unsigned int max_iterations_without_a_sample = static_cast<unsigned int>(3 * cloud.points.size());
+        sample_indices.clear();
+        while (static_cast<int>(sample_indices.size()) < nr_samples) {
+            const int sample_index = getRandomIndex(static_cast<int>(cloud.points.size()));
+            bool valid_sample = true;
+            for (std::size_t i = 0; i < sample_indices.size(); ++i) {
+                if (sample_index == sample_indices[i] ||
+                    pcl::euclideanDistance(cloud.points[sample_index], cloud.points[sample_indices[i]]) <
+                    min_sample_distance) {
+                    valid_sample = false;
+                    break;
+                }
+            }
+            if (valid_sample) {
+                sample_indices.push_back(sample_index);
+                iterations_without_a_sample = 0;
+            } else
+                ++iterations_without_a_sample;
+            //找不到足够远的样本时把最小距离减半
+            if (iterations_without_a_sample >= max_iterations_without_a_sample) {
+                min_sample_distance *= 0.5f;
+                iterations_without_a_sample = 0;
+            }
+        }
+    }
+
+    QuantizedFeaturesConstPtr source_quantized_;
+    QuantizedFeaturesConstPtr target_quantized_;
+    QuantizedFeatureMatcher<QuantizedT> matcher_;
+    CorrespondenceTable::ConstPtr table_;
+    unsigned int seed_;
+    std::mt19937 rng_;
+};
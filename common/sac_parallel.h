@@ -0,0 +1,1162 @@
+/*
+ * 多线程批量假设的 RANSAC 分割
+ * 与 pcl::SACSegmentation / SACSegmentationFromNormals 的 SAC_RANSAC 路径用法相同，支持
+ * SACMODEL_PLANE、SACMODEL_SPHERE、SACMODEL_NORMAL_PLANE、SACMODEL_CYLINDER。
+ *   - 点(与法向)先复制成 SoA，只保留有限值的点；
+ *   - 每轮生成一批假设，按点分块在所有线程上同时给整批假设计数，块内数据常驻缓存，计数用 SSE 比较 + movemask；
+ *   - 一批结束后按假设顺序取内点最多者(相同时取编号小的)，并按 PCL RANSAC 的公式更新自适应迭代上限 k。
+ *   - 提前淘汰(默认开启)：SoA 在使用前随机打乱，任意前缀都是随机子集；每个假设按顺序做序贯概率比检验(SPRT，
+ *     Matas & Chum)，同时检查"剩余点全是内点也追不上当前最优"的上界，落后的假设通常几百个点后就被丢弃。
+ *   - segmentMultiple 在同一份 SoA 上依次提取多个模型，每次把内点原地压缩掉，不复制点云。
+ *   - 随机数是计数器型的：第 h 个假设的样本只由 (seed, 模型序号, h, 尝试次数) 决定，与线程数、批内调度无关，
+ *     计数都是整数归约，同一 seed 在任意线程数下得到逐位相同的模型；setTraceEnabled 后可导出每个假设的记录。
+ *   - setBudget 设定截止时间/取消标志，每批之间检查，到时返回目前最好的模型，getStatus/getConfidence 给出结果质量。
+ *   - 先验模型(setPrior / setWarmStart，用于逐帧跟踪同一物体)：segment 先在随机前缀上给先验及其小扰动计数，
+ *     内点比例不低于阈值时直接以其中最好的为结果，否则退回完整的 RANSAC。
+ * 带法向的模型在计数时用多项式近似 acos(误差约 7e-5 rad)，最终内点用精确公式重新选择。
+ */
+#pragma once
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <fstream>
+#include <limits>
+#include <string>
+#include <vector>
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+#include <Eigen/Core>
+#include <Eigen/Eigenvalues>
+#include <Eigen/LU>
+
+#include <pcl/ModelCoefficients.h>
+#include <pcl/PointIndices.h>
+#include <pcl/point_cloud.h>
+#include <pcl/point_types.h>
+#include <pcl/sample_consensus/model_types.h>
+#include <pcl/sample_consensus/sac_model_cylinder.h>
+
+#include "anytime.h"
+#include "parallel.h"
+
+template<typename PointT, typename PointNT = pcl::Normal>
+class SACSegmentationParallel {
+public:
+    typedef typename pcl::PointCloud<PointT>::ConstPtr PointCloudConstPtr;
+    typedef typename pcl::PointCloud<PointNT>::ConstPtr PointCloudNConstPtr;
+
+    SACSegmentationParallel()
+            : model_type_(pcl::SACMODEL_PLANE), threshold_(0.0), max_iterations_(50), probability_(0.99),
+              optimize_coefficients_(true), normal_distance_weight_(0.1), radius_min_(-std::numeric_limits<double>::max()),
+              radius_max_(std::numeric_limits<double>::max()), nr_threads_(0), batch_size_(32), seed_(12345),
+              early_rejection_(true), trace_enabled_(false), iterations_(0), evaluated_points_(0), scored_points_(0),
+              status_(ANYTIME_FAILED), confidence_(0.0), has_prior_(false), prior_min_ratio_(0.0), warm_start_(false),
+              warm_start_ratio_drop_(0.8), prior_perturbations_(16), prior_translation_(-1.0), prior_angle_(0.03),
+              warm_started_(false), shuffled_(0) {}
+
+    //换模型类型时先验不再适用
+    void
+    setModelType(int model) {
+        if (model != model_type_)
+            has_prior_ = false;
+        model_type_ = model;
+    }
+
+    void setMethodType(int) {}  //只实现 SAC_RANSAC，保留该接口方便替换 SACSegmentation
+
+    void setDistanceThreshold(double threshold) { threshold_ = threshold; }
+
+    void setMaxIterations(int max_iterations) { max_iterations_ = max_iterations; }
+
+    void setProbability(double probability) { probability_ = probability; }
+
+    void setOptimizeCoefficients(bool optimize) { optimize_coefficients_ = optimize; }
+
+    void setNormalDistanceWeight(double weight) { normal_distance_weight_ = weight; }
+
+    void
+    setRadiusLimits(double min_radius, double max_radius) {
+        radius_min_ = min_radius;
+        radius_max_ = max_radius;
+    }
+
+    void setInputCloud(const PointCloudConstPtr &cloud) { input_ = cloud; }
+
+    void setInputNormals(const PointCloudNConstPtr &normals) { normals_ = normals; }
+
+    //只在这些点中分割，与 PCLBase::setIndices 相同
+    void setIndices(const pcl::IndicesConstPtr &indices) { indices_ = indices; }
+
+    void
+    setIndices(const pcl::PointIndices::ConstPtr &indices) {
+        indices_ = indices ? pcl::IndicesConstPtr(new std::vector<int>(indices->indices)) : pcl::IndicesConstPtr();
+    }
+
+    //线程数，0 表示使用全部硬件线程
+    void setNumberOfThreads(int nr_threads) { nr_threads_ = nr_threads; }
+
+    //每批生成的假设个数
+    void setBatchSize(int batch_size) { batch_size_ = std::max(1, batch_size); }
+
+    //时间预算：每批假设之后检查，至少评估一批；截止时返回目前最好的模型
+    void setBudget(const AnytimeBudget &budget) { budget_ = budget; }
+
+    //上一次分割的结束原因(segmentMultiple 为最后一轮)
+    AnytimeStatus getStatus() const { return status_; }
+
+    //上一次分割中至少抽到一个全内点样本的概率 1-(1-w^s)^N，截止时可据此判断结果是否可信
+    double getConfidence() const { return confidence_; }
+
+    /**
+     * 先验模型(如上一帧的圆柱/球)。segment 先在约 kPriorSample 个随机点上给先验及 prior_perturbations 个扰动计数，
+     * 最好者的内点比例不低于 min_inlier_ratio 时跳过 RANSAC。只对 segment 生效，segmentMultiple 不使用先验。
+     */
+    void
+    setPrior(const pcl::ModelCoefficients &model, double min_inlier_ratio) {
+        prior_ = Eigen::Map<const Eigen::VectorXf>(model.values.data(), model.values.size());
+        prior_min_ratio_ = min_inlier_ratio;
+        has_prior_ = true;
+    }
+
+    void clearPrior() { has_prior_ = false; }
+
+    /**
+     * 每次 segment 成功后自动把结果设为下一次的先验，阈值为本次内点比例的 ratio_drop 倍，
+     * 即内点比例明显下降(目标丢失、被遮挡)时才重新做完整的 RANSAC。
+     */
+    void
+    setWarmStart(bool enabled, double ratio_drop = 0.8) {
+        warm_start_ = enabled;
+        warm_start_ratio_drop_ = ratio_drop;
+    }
+
+    //扰动个数、平移幅度(米，负值表示取距离阈值)与方向的旋转幅度(弧度)
+    void
+    setPriorPerturbations(int count, double translation = -1.0, double angle = 0.03) {
+        prior_perturbations_ = std::max(0, count);
+        prior_translation_ = translation;
+        prior_angle_ = angle;
+    }
+
+    //上一次 segment 是否直接采用了先验(没有做 RANSAC)
+    bool isWarmStarted() const { return warm_started_; }
+
+    //随机种子，同一种子在任意线程数下结果相同
+    void setSeed(unsigned int seed) { seed_ = seed; }
+
+    //是否用 SPRT 提前淘汰假设
+    void setEarlyRejection(bool early_rejection) { early_rejection_ = early_rejection; }
+
+    //记录每个假设的计数、检查点数与迭代上限，供 getTrace / saveTrace 使用
+    void setTraceEnabled(bool enabled) { trace_enabled_ = enabled; }
+
+    struct TraceEntry {
+        int model;              //segmentMultiple 中的模型序号，segment 为 0
+        int hypothesis;         //假设编号，决定其随机样本
+        int inliers;            //内点数，被提前淘汰时为淘汰前的计数
+        int evaluated;          //实际检查的点数
+        bool rejected;          //是否被 SPRT/上界提前淘汰
+        int best_inliers;       //处理完该假设后的最优内点数
+        double k;               //处理完该假设后的自适应迭代上限
+    };
+
+    const std::vector<TraceEntry> &getTrace() const { return trace_; }
+
+    //把上一次分割的记录写成 CSV
+    bool
+    saveTrace(const std::string &filename) const {
+        std::ofstream out(filename.c_str());
+        if (!out)
+            return false;
+        out << "model,hypothesis,inliers,evaluated,rejected,best_inliers,k\n";
+        for (const TraceEntry &entry: trace_)
+            out << entry.model << "," << entry.hypothesis << "," << entry.inliers << "," << entry.evaluated << ","
+                << (entry.rejected ? 1 : 0) << "," << entry.best_inliers << "," << entry.k << "\n";
+        return static_cast<bool>(out);
+    }
+
+    //上一次 segment 实际评估的假设数(segmentMultiple 为各轮之和)
+    int getIterations() const { return iterations_; }
+
+    //上一次 segment 中平均每个假设实际检查的点数占全部点数的比例
+    double
+    getEvaluatedFraction() const {
+        return scored_points_ > 0 ? static_cast<double>(evaluated_points_) / static_cast<double>(scored_points_) : 0.0;
+    }
+
+    void
+    segment(pcl::PointIndices &inliers, pcl::ModelCoefficients &model_coefficients) {
+        inliers.indices.clear();
+        model_coefficients.values.clear();
+        resetStatistics();
+        if (!input_ || !buildSoA())
+            return;
+        std::vector<int> selection;
+        if (!extractModel(0, inliers, model_coefficients, selection, has_prior_))
+            return;
+        if (warm_start_) {
+            prior_ = Eigen::Map<const Eigen::VectorXf>(model_coefficients.values.data(), model_coefficients.values.size());
+            prior_min_ratio_ = warm_start_ratio_drop_ * static_cast<double>(selection.size()) / static_cast<double>(x_.size());
+            has_prior_ = true;
+        }
+    }
+
+    /**
+     * 依次提取最多 max_models 个模型（如多个平面）。每轮在剩余点上做一次 RANSAC，内点数少于 min_inliers 时停止，
+     * 剩余点数不超过初始点数的 min_remaining_ratio 时也停止。每个模型的内点从剩余点中原地压缩掉，
+     * 点云本身不被复制或修改；剩余点用 getRemainingIndices 取得。
+     */
+    void
+    segmentMultiple(int max_models, std::vector<pcl::PointIndices> &inliers,
+                    std::vector<pcl::ModelCoefficients> &model_coefficients, int min_inliers = 1,
+                    double min_remaining_ratio = 0.0) {
+        inliers.clear();
+        model_coefficients.clear();
+        resetStatistics();
+        if (!input_ || !buildSoA())
+            return;
+        const double initial = static_cast<double>(x_.size());
+        std::vector<int> selection;
+        while (static_cast<int>(inliers.size()) < max_models && static_cast<int>(x_.size()) >= sampleSize() &&
+               static_cast<double>(x_.size()) > min_remaining_ratio * initial &&
+               (inliers.empty() || !budget_.stopRequested())) {
+            pcl::PointIndices model_inliers;
+            pcl::ModelCoefficients coefficients;
+            //每轮使用不同的随机序列
+            if (!extractModel(static_cast<int>(inliers.size()), model_inliers, coefficients, selection) ||
+                static_cast<int>(model_inliers.indices.size()) < min_inliers)
+                break;
+            removeFromSoA(selection);
+            inliers.push_back(model_inliers);
+            model_coefficients.push_back(coefficients);
+        }
+    }
+
+    //segmentMultiple 之后尚未归入任何模型的点(升序，不含无效点)
+    void
+    getRemainingIndices(pcl::PointIndices &remaining) const {
+        remaining.header = input_ ? input_->header : remaining.header;
+        remaining.indices = cloud_index_;
+        std::sort(remaining.indices.begin(), remaining.indices.end());
+    }
+
+protected:
+    static const int kBlockSize = 2048;    //每块点数，x/y/z(/法向)约 24~56KB
+    static const int kSprtStep = 64;       //SPRT 第一阶段每检查这么多点做一次判断
+    static const int kSprtRound = 8 * kBlockSize;  //第二阶段每轮的点数，与线程数无关，保证结果确定
+
+    static const int kMaxSampleAttempts = 100;    //每个假设最多重新采样的次数(样本退化时)
+    static const int kPriorSample = 2 * kBlockSize;   //检验先验用的随机点数，内点比例的标准差不到 1%
+
+    void
+    resetStatistics() {
+        iterations_ = 0;
+        evaluated_points_ = 0;
+        scored_points_ = 0;
+        trace_.clear();
+        status_ = ANYTIME_FAILED;
+        confidence_ = 0.0;
+        warm_started_ = false;
+    }
+
+    //splitmix64 的混合函数
+    static std::uint64_t
+    mix(std::uint64_t x) {
+        x += 0x9e3779b97f4a7c15ULL;
+        x = (x ^ (x >> 30)) * 0xbf58476d1ce4e5b9ULL;
+        x = (x ^ (x >> 27)) * 0x94d049bb133111ebULL;
+        return x ^ (x >> 31);
+    }
+
+    //计数器型随机数：结果只取决于 (seed, stream, counter)，不依赖任何调用顺序
+    std::uint64_t
+    counterRandom(std::uint64_t stream, std::uint64_t counter) const {
+        return mix(mix(mix(static_cast<std::uint64_t>(seed_)) ^ stream) ^ counter);
+    }
+
+    //[0, n) 内的整数，用乘法取高位，各平台结果一致
+    static int
+    uniformIndex(std::uint64_t random, int n) {
+        return static_cast<int>(((random >> 32) * static_cast<std::uint64_t>(n)) >> 32);
+    }
+
+    //第 model 个模型的第 hypothesis 个假设：依次尝试采样，返回第一个非退化样本得到的模型，attempts 为尝试次数
+    bool
+    generateHypothesis(int model, int hypothesis, Eigen::VectorXf &coefficients, int &attempts) const {
+        const int n = static_cast<int>(x_.size()), s = sampleSize();
+        const std::uint64_t stream = (static_cast<std::uint64_t>(model + 1) << 32) | static_cast<std::uint32_t>(hypothesis);
+        std::vector<int> sample(s);
+        std::uint64_t counter = 0;
+        for (attempts = 1; attempts <= kMaxSampleAttempts; ++attempts) {
+            for (int j = 0; j < s; ++j) {
+                int index;
+                do {
+                    index = uniformIndex(counterRandom(stream, counter++), n);
+                } while (std::find(sample.begin(), sample.begin() + j, index) != sample.begin() + j);
+                sample[j] = index;
+            }
+            if (computeModelCoefficients(sample, coefficients))
+                return true;
+        }
+        attempts = kMaxSampleAttempts;
+        return false;
+    }
+
+    //在当前 SoA 上做一次 RANSAC(use_prior 时先检验先验)，selection 为内点在 SoA 中的下标(升序)
+    bool
+    extractModel(int model_index, pcl::PointIndices &inliers, pcl::ModelCoefficients &model_coefficients,
+                 std::vector<int> &selection, bool use_prior = false) {
+        Eigen::VectorXf best_model;
+        warm_started_ = use_prior && scorePrior(best_model);
+        if (!warm_started_ && !computeModel(best_model, model_index))
+            return false;
+
+        selectWithinDistance(best_model, selection);
+        if (optimize_coefficients_ && refitModel(selection, best_model))
+            selectWithinDistance(best_model, selection);
+
+        inliers.header = input_->header;
+        model_coefficients.header = input_->header;
+        inliers.indices.reserve(selection.size());
+        for (int i: selection)
+            inliers.indices.push_back(cloud_index_[i]);
+        //SoA 是打乱过的，恢复输入点云的顺序
+        std::sort(inliers.indices.begin(), inliers.indices.end());
+        model_coefficients.values.assign(best_model.data(), best_model.data() + best_model.size());
+        return true;
+    }
+
+    //按升序的 SoA 下标删除点，其余点保持原有(随机)顺序
+    void
+    removeFromSoA(const std::vector<int> &selection) {
+        const bool with_normals = usesNormals();
+        const int n = static_cast<int>(x_.size());
+        int write = 0, shuffled = 0;
+        std::size_t next = 0;
+        for (int read = 0; read < n; ++read) {
+            if (next < selection.size() && selection[next] == read) {
+                ++next;
+                continue;
+            }
+            shuffled += read < shuffled_;
+            x_[write] = x_[read];
+            y_[write] = y_[read];
+            z_[write] = z_[read];
+            cloud_index_[write] = cloud_index_[read];
+            if (with_normals) {
+                nx_[write] = nx_[read];
+                ny_[write] = ny_[read];
+                nz_[write] = nz_[read];
+                weight_[write] = weight_[read];
+            }
+            ++write;
+        }
+        shuffled_ = shuffled;
+        x_.resize(write);
+        y_.resize(write);
+        z_.resize(write);
+        cloud_index_.resize(write);
+        if (with_normals) {
+            nx_.resize(write);
+            ny_.resize(write);
+            nz_.resize(write);
+            weight_.resize(write);
+        }
+    }
+
+    bool
+    usesNormals() const {
+        return model_type_ == pcl::SACMODEL_NORMAL_PLANE || model_type_ == pcl::SACMODEL_CYLINDER;
+    }
+
+    int
+    sampleSize() const {
+        switch (model_type_) {
+            case pcl::SACMODEL_SPHERE:
+                return 4;
+            case pcl::SACMODEL_CYLINDER:
+                return 2;
+            default:
+                return 3;
+        }
+    }
+
+    bool
+    buildSoA() {
+        if (model_type_ != pcl::SACMODEL_PLANE && model_type_ != pcl::SACMODEL_SPHERE &&
+            model_type_ != pcl::SACMODEL_NORMAL_PLANE && model_type_ != pcl::SACMODEL_CYLINDER)
+            return false;
+        const bool with_normals = usesNormals();
+        if (with_normals && (!normals_ || normals_->points.size() != input_->points.size()))
+            return false;
+        x_.clear();
+        y_.clear();
+        z_.clear();
+        nx_.clear();
+        ny_.clear();
+        nz_.clear();
+        weight_.clear();
+        cloud_index_.clear();
+        const std::size_t nr_candidates = indices_ ? indices_->size() : input_->points.size();
+        for (std::size_t k = 0; k < nr_candidates; ++k) {
+            const std::size_t i = indices_ ? static_cast<std::size_t>((*indices_)[k]) : k;
+            const PointT &p = input_->points[i];
+            if (!std::isfinite(p.x) || !std::isfinite(p.y) || !std::isfinite(p.z))
+                continue;
+            if (with_normals) {
+                const PointNT &n = normals_->points[i];
+                const float norm = std::sqrt(n.normal_x * n.normal_x + n.normal_y * n.normal_y + n.normal_z * n.normal_z);
+                //只有 NORMAL_PLANE 用到曲率；积分图法线(AVERAGE_3D_GRADIENT)的曲率为 NaN，圆柱不应因此丢点
+                if (!(norm > 0.0f) || (model_type_ == pcl::SACMODEL_NORMAL_PLANE && !std::isfinite(n.curvature)))
+                    continue;
+                nx_.push_back(n.normal_x / norm);
+                ny_.push_back(n.normal_y / norm);
+                nz_.push_back(n.normal_z / norm);
+                //NORMAL_PLANE 的法向权重随曲率减小，圆柱不考虑曲率（与 PCL 相同）
+                weight_.push_back(static_cast<float>(model_type_ == pcl::SACMODEL_NORMAL_PLANE
+                                                     ? normal_distance_weight_ * (1.0 - n.curvature)
+                                                     : normal_distance_weight_));
+            }
+            x_.push_back(p.x);
+            y_.push_back(p.y);
+            z_.push_back(p.z);
+            cloud_index_.push_back(static_cast<int>(i));
+        }
+        shuffled_ = 0;
+        return static_cast<int>(x_.size()) >= sampleSize();
+    }
+
+    //[-1, 1) 内的均匀随机数
+    static float
+    uniformSigned(std::uint64_t random) {
+        return static_cast<float>(random >> 40) * (2.0f / 16777216.0f) - 1.0f;
+    }
+
+    //把先验整理成与 computeModelCoefficients 相同的形式(单位法向/轴向)，不合法时返回 false
+    bool
+    normalizeModel(Eigen::VectorXf &model) const {
+        switch (model_type_) {
+            case pcl::SACMODEL_PLANE:
+            case pcl::SACMODEL_NORMAL_PLANE: {
+                if (model.size() != 4)
+                    return false;
+                const float norm = model.head<3>().norm();
+                if (!(norm > 0.0f))
+                    return false;
+                model /= norm;
+                return model.allFinite();
+            }
+            case pcl::SACMODEL_SPHERE:
+                return model.size() == 4 && model.allFinite() && radiusValid(model[3]);
+            case pcl::SACMODEL_CYLINDER: {
+                if (model.size() != 7)
+                    return false;
+                const float norm = model.segment<3>(3).norm();
+                if (!(norm > 0.0f))
+                    return false;
+                model.segment<3>(3) /= norm;
+                return model.allFinite() && radiusValid(model[6]);
+            }
+            default:
+                return false;
+        }
+    }
+
+    //第 j 个扰动：位置平移 ±translation，方向旋转约 ±angle，半径 ±translation(stream ~0 专用于扰动)
+    bool
+    perturbModel(const Eigen::VectorXf &prior, int j, Eigen::VectorXf &model) const {
+        const std::uint64_t stream = ~static_cast<std::uint64_t>(0);
+        const std::uint64_t base = static_cast<std::uint64_t>(j) * 8;
+        Eigen::Vector3f shift, turn;
+        for (int c = 0; c < 3; ++c) {
+            shift[c] = uniformSigned(counterRandom(stream, base + c));
+            turn[c] = uniformSigned(counterRandom(stream, base + 3 + c));
+        }
+        const float dr = uniformSigned(counterRandom(stream, base + 6));
+        const float t = static_cast<float>(prior_translation_ >= 0.0 ? prior_translation_ : threshold_);
+        const float a = static_cast<float>(prior_angle_);
+        model = prior;
+        switch (model_type_) {
+            case pcl::SACMODEL_PLANE:
+            case pcl::SACMODEL_NORMAL_PLANE: {
+                //绕平面上离原点最近的点旋转法向，再沿法向平移
+                const Eigen::Vector3f origin = -prior[3] * prior.head<3>();
+                const Eigen::Vector3f normal = (prior.head<3>() + a * turn).normalized();
+                model << normal, -normal.dot(origin) + t * dr;
+                break;
+            }
+            case pcl::SACMODEL_SPHERE:
+                model.head<3>() += t * shift;
+                model[3] += t * dr;
+                break;
+            case pcl::SACMODEL_CYLINDER:
+                model.head<3>() += t * shift;
+                model.segment<3>(3) = (prior.segment<3>(3) + a * turn).normalized();
+                model[6] += t * dr;
+                break;
+            default:
+                return false;
+        }
+        return normalizeModel(model);
+    }
+
+    /**
+     * 在 SoA 的随机前缀上给先验与其扰动计数，最好者的内点比例达到 prior_min_ratio_ 时作为结果。
+     * 先验与扰动按编号顺序比较，相同时取编号小的(先验本身为 0)，结果与线程数无关。
+     */
+    bool
+    scorePrior(Eigen::VectorXf &best_model) {
+        Eigen::VectorXf prior = prior_;
+        if (!normalizeModel(prior))
+            return false;
+        std::vector<Eigen::VectorXf> batch(1, prior);
+        for (int j = 0; j < prior_perturbations_; ++j) {
+            Eigen::VectorXf model;
+            if (perturbModel(prior, j, model))
+                batch.push_back(model);
+        }
+        const int m = std::min(static_cast<int>(x_.size()), kPriorSample);
+        shufflePrefix(m);
+        std::vector<int> counts;
+        countWithinDistance(batch, 0, m, counts);
+        iterations_ += static_cast<int>(batch.size());
+        evaluated_points_ += static_cast<long long>(m) * static_cast<long long>(batch.size());
+        scored_points_ += static_cast<long long>(x_.size()) * static_cast<long long>(batch.size());
+        const int best = static_cast<int>(std::max_element(counts.begin(), counts.end()) - counts.begin());
+        if (counts[best] == 0 || static_cast<double>(counts[best]) < prior_min_ratio_ * m)
+            return false;
+        best_model = batch[best];
+        status_ = ANYTIME_CONVERGED;
+        //没有随机采样，置信度取检验通过
+        confidence_ = 1.0;
+        return true;
+    }
+
+    /**
+     * 打乱 SoA 的前 limit 个位置，SPRT 按顺序检查的前缀即为随机子集(stream 0 留给打乱)。
+     * 用正向 Fisher–Yates，第 i 步只依赖 i，所以先打乱前缀再打乱全部与一次打乱全部的结果相同；
+     * 先验检验只需要前 kPriorSample 个点，不必打乱整个点云。
+     */
+    void
+    shufflePrefix(int limit) {
+        const bool with_normals = usesNormals();
+        const int n = static_cast<int>(x_.size());
+        limit = std::min(limit, n - 1);
+        for (int i = shuffled_; i < limit; ++i) {
+            const int j = i + uniformIndex(counterRandom(0, static_cast<std::uint64_t>(i)), n - i);
+            std::swap(x_[i], x_[j]);
+            std::swap(y_[i], y_[j]);
+            std::swap(z_[i], z_[j]);
+            std::swap(cloud_index_[i], cloud_index_[j]);
+            if (with_normals) {
+                std::swap(nx_[i], nx_[j]);
+                std::swap(ny_[i], ny_[j]);
+                std::swap(nz_[i], nz_[j]);
+                std::swap(weight_[i], weight_[j]);
+            }
+        }
+        shuffled_ = std::max(shuffled_, limit);
+    }
+
+    /**
+     * 批量 RANSAC 主循环。k 与 PCL RandomSampleConsensus::computeModel 相同：
+     * k = log(1-p) / log(1 - w^s)，w 为当前最优内点比例，s 为最小样本数。
+     * 开启 SPRT 时好模型也有 1/A 的概率被误删，因此成功概率取 w^s·(1-1/A)。
+     */
+    bool
+    computeModel(Eigen::VectorXf &best_model, int model_index) {
+        const int n = static_cast<int>(x_.size()), s = sampleSize();
+        const int max_skip = max_iterations_ * 10;
+        int iterations = 0, next_hypothesis = 0;
+        double k = std::numeric_limits<double>::max(), best_p_no_outliers = 1.0;
+        int best_count = 0, skipped = 0;
+        AnytimeStatus stop = ANYTIME_CONVERGED;
+        bool interrupted = false;
+        std::vector<Eigen::VectorXf> batch, candidates;
+        std::vector<int> counts, checked, ids, attempts;
+        std::vector<char> alive, valid;
+        shufflePrefix(n);
+        sprt_delta_ = 0.01;
+        sprt_a_ = std::numeric_limits<double>::infinity();
+        rejected_consistent_ = rejected_evaluated_ = 0;
+
+        while (iterations < k && iterations < max_iterations_ && skipped < max_skip) {
+            if (iterations > 0 && budget_.stopRequested(&stop)) {
+                interrupted = true;
+                break;
+            }
+            //本批的假设数不超过剩余的迭代次数
+            double remaining = std::min(k, static_cast<double>(max_iterations_)) - iterations;
+            const int batch_size = static_cast<int>(std::min<double>(batch_size_, std::ceil(remaining)));
+            //各假设的样本相互独立，可并行生成
+            candidates.assign(batch_size, Eigen::VectorXf());
+            valid.assign(batch_size, 0);
+            attempts.assign(batch_size, 0);
+            parallelFor(0, batch_size, [&](int j) {
+                valid[j] = generateHypothesis(model_index, next_hypothesis + j, candidates[j], attempts[j]);
+            }, nr_threads_);
+            batch.clear();
+            ids.clear();
+            for (int j = 0; j < batch_size; ++j) {
+                skipped += valid[j] ? attempts[j] - 1 : attempts[j];
+                if (valid[j]) {
+                    batch.push_back(candidates[j]);
+                    ids.push_back(next_hypothesis + j);
+                }
+            }
+            next_hypothesis += batch_size;
+            if (batch.empty())
+                break;
+
+            scoreBatch(batch, best_count, counts, alive, checked);
+            scored_points_ += static_cast<long long>(n) * static_cast<long long>(batch.size());
+            for (std::size_t h = 0; h < batch.size(); ++h) {
+                ++iterations;
+                if (alive[h] && counts[h] > best_count) {
+                    best_count = counts[h];
+                    best_model = batch[h];
+                    const double w = static_cast<double>(best_count) / n;
+                    const double accept = std::isfinite(sprt_a_) ? 1.0 - 1.0 / sprt_a_ : 1.0;
+                    double p_no_outliers = 1.0 - std::pow(w, static_cast<double>(s)) * accept;
+                    p_no_outliers = std::max(std::numeric_limits<double>::epsilon(), p_no_outliers);
+                    p_no_outliers = std::min(1.0 - std::numeric_limits<double>::epsilon(), p_no_outliers);
+                    k = std::log(1.0 - probability_) / std::log(p_no_outliers);
+                    best_p_no_outliers = p_no_outliers;
+                }
+                if (trace_enabled_) {
+                    TraceEntry entry = {model_index, ids[h], counts[h], checked[h], !alive[h], best_count, k};
+                    trace_.push_back(entry);
+                }
+            }
+        }
+        iterations_ += iterations;
+        if (best_count == 0)
+            status_ = ANYTIME_FAILED;
+        else if (interrupted)
+            status_ = stop;
+        else
+            status_ = iterations >= k ? ANYTIME_CONVERGED : ANYTIME_MAX_ITERATIONS;
+        confidence_ = best_count > 0 ? 1.0 - std::pow(best_p_no_outliers, static_cast<double>(iterations)) : 0.0;
+        return best_count > 0;
+    }
+
+    bool
+    radiusValid(float radius) const {
+        return radius >= radius_min_ && radius <= radius_max_;
+    }
+
+    bool
+    computeModelCoefficients(const std::vector<int> &sample, Eigen::VectorXf &model) const {
+        auto point = [this](int i) { return Eigen::Vector3f(x_[i], y_[i], z_[i]); };
+        switch (model_type_) {
+            case pcl::SACMODEL_PLANE:
+            case pcl::SACMODEL_NORMAL_PLANE: {
+                const Eigen::Vector3f p0 = point(sample[0]);
+                Eigen::Vector3f normal = (point(sample[1]) - p0).cross(point(sample[2]) - p0);
+                const float norm = normal.norm();
+                //三点共线
+                if (!(norm > 1e-12f))
+                    return false;
+                normal /= norm;
+                model.resize(4);
+                model << normal, -normal.dot(p0);
+                return true;
+            }
+            case pcl::SACMODEL_SPHERE: {
+                //|p_i - c|^2 = r^2 两两相减得到关于球心的线性方程组
+                const Eigen::Vector3f p0 = point(sample[0]);
+                Eigen::Matrix3f a;
+                Eigen::Vector3f b;
+                for (int j = 1; j < 4; ++j) {
+                    const Eigen::Vector3f pj = point(sample[j]);
+                    a.row(j - 1) = 2.0f * (pj - p0).transpose();
+                    b(j - 1) = pj.squaredNorm() - p0.squaredNorm();
+                }
+                //四点共面
+                if (std::abs(a.determinant()) < 1e-12f)
+                    return false;
+                const Eigen::Vector3f center = a.partialPivLu().solve(b);
+                const float radius = (p0 - center).norm();
+                if (!center.allFinite() || !radiusValid(radius))
+                    return false;
+                model.resize(4);
+                model << center, radius;
+                return true;
+            }
+            case pcl::SACMODEL_CYLINDER: {
+                //与 SampleConsensusModelCylinder::computeModelCoefficients 相同：两条法线的公垂线
+                const Eigen::Vector3f p1 = point(sample[0]), p2 = point(sample[1]);
+                const Eigen::Vector3f n1(nx_[sample[0]], ny_[sample[0]], nz_[sample[0]]),
+                        n2(nx_[sample[1]], ny_[sample[1]], nz_[sample[1]]);
+                if ((p1 - p2).squaredNorm() < 1e-12f)
+                    return false;
+                const Eigen::Vector3f w = n1 + p1 - p2;
+                const float a = n1.dot(n1), b = n1.dot(n2), c = n2.dot(n2), d = n1.dot(w), e = n2.dot(w);
+                const float denominator = a * c - b * b;
+                float sc, tc;
+                if (denominator < 1e-8f) {
+                    sc = 0.0f;
+                    tc = (b > c ? d / b : e / c);
+                } else {
+                    sc = (b * e - c * d) / denominator;
+                    tc = (a * e - b * d) / denominator;
+                }
+                const Eigen::Vector3f line_pt = p1 + n1 + sc * n1;
+                Eigen::Vector3f line_dir = p2 + tc * n2 - line_pt;
+                const float dir_norm = line_dir.norm();
+                if (!(dir_norm > 0.0f))
+                    return false;
+                line_dir /= dir_norm;
+                const float radius = (p1 - line_pt).cross(line_dir).norm();
+                if (!line_pt.allFinite() || !radiusValid(radius))
+                    return false;
+                model.resize(7);
+                model << line_pt, line_dir, radius;
+                return true;
+            }
+            default:
+                return false;
+        }
+    }
+
+    //acos(x)，x∈[0,1]，Abramowitz & Stegun 4.4.45
+    static float
+    acosPositive(float x) {
+        return std::sqrt(std::max(0.0f, 1.0f - x)) * (1.5707288f + x * (-0.2121144f + x * (0.0742610f - 0.0187293f * x)));
+    }
+
+#if defined(__SSE2__)
+    static __m128
+    acosPositive(__m128 x) {
+        __m128 poly = _mm_add_ps(_mm_set1_ps(0.0742610f), _mm_mul_ps(x, _mm_set1_ps(-0.0187293f)));
+        poly = _mm_add_ps(_mm_set1_ps(-0.2121144f), _mm_mul_ps(x, poly));
+        poly = _mm_add_ps(_mm_set1_ps(1.5707288f), _mm_mul_ps(x, poly));
+        return _mm_mul_ps(_mm_sqrt_ps(_mm_max_ps(_mm_setzero_ps(), _mm_sub_ps(_mm_set1_ps(1.0f), x))), poly);
+    }
+
+    static __m128
+    absolute(__m128 v) {
+        return _mm_andnot_ps(_mm_set1_ps(-0.0f), v);
+    }
+#endif
+
+    //点 [begin, end) 中到模型距离不超过阈值的个数
+    int
+    countBlock(const Eigen::VectorXf &m, int begin, int end) const {
+        const float t = static_cast<float>(threshold_);
+        const float *px = x_.data(), *py = y_.data(), *pz = z_.data();
+        int count = 0, i = begin;
+        switch (model_type_) {
+            case pcl::SACMODEL_PLANE: {
+#if defined(__SSE2__)
+                const __m128 a = _mm_set1_ps(m[0]), b = _mm_set1_ps(m[1]), c = _mm_set1_ps(m[2]), d = _mm_set1_ps(m[3]);
+                const __m128 thr = _mm_set1_ps(t);
+                for (; i + 4 <= end; i += 4) {
+                    __m128 dist = _mm_add_ps(_mm_add_ps(_mm_mul_ps(a, _mm_loadu_ps(px + i)), _mm_mul_ps(b, _mm_loadu_ps(py + i))),
+                                             _mm_add_ps(_mm_mul_ps(c, _mm_loadu_ps(pz + i)), d));
+                    count += __builtin_popcount(_mm_movemask_ps(_mm_cmple_ps(absolute(dist), thr)));
+                }
+#endif
+                for (; i < end; ++i)
+                    count += std::abs(m[0] * px[i] + m[1] * py[i] + m[2] * pz[i] + m[3]) <= t;
+                return count;
+            }
+            case pcl::SACMODEL_SPHERE: {
+                //|d - r| <= t 等价于 max(r-t,0)^2 <= d^2 <= (r+t)^2，不需要开方
+                const float low = std::max(0.0f, m[3] - t), high = m[3] + t;
+                const float low2 = low * low, high2 = high * high;
+#if defined(__SSE2__)
+                const __m128 cx = _mm_set1_ps(m[0]), cy = _mm_set1_ps(m[1]), cz = _mm_set1_ps(m[2]);
+                const __m128 lo = _mm_set1_ps(low2), hi = _mm_set1_ps(high2);
+                for (; i + 4 <= end; i += 4) {
+                    __m128 dx = _mm_sub_ps(_mm_loadu_ps(px + i), cx), dy = _mm_sub_ps(_mm_loadu_ps(py + i), cy),
+                            dz = _mm_sub_ps(_mm_loadu_ps(pz + i), cz);
+                    __m128 d2 = _mm_add_ps(_mm_add_ps(_mm_mul_ps(dx, dx), _mm_mul_ps(dy, dy)), _mm_mul_ps(dz, dz));
+                    count += __builtin_popcount(_mm_movemask_ps(_mm_and_ps(_mm_cmpge_ps(d2, lo), _mm_cmple_ps(d2, hi))));
+                }
+#endif
+                for (; i < end; ++i) {
+                    const float dx = px[i] - m[0], dy = py[i] - m[1], dz = pz[i] - m[2];
+                    const float d2 = dx * dx + dy * dy + dz * dz;
+                    count += d2 >= low2 && d2 <= high2;
+                }
+                return count;
+            }
+            case pcl::SACMODEL_NORMAL_PLANE: {
+                //距离 = w*法向夹角 + (1-w)*点到平面距离，w = weight*(1-curvature)
+                const float *qx = nx_.data(), *qy = ny_.data(), *qz = nz_.data(), *pw = weight_.data();
+#if defined(__SSE2__)
+                const __m128 a = _mm_set1_ps(m[0]), b = _mm_set1_ps(m[1]), c = _mm_set1_ps(m[2]), d = _mm_set1_ps(m[3]);
+                const __m128 thr = _mm_set1_ps(t), one = _mm_set1_ps(1.0f);
+                for (; i + 4 <= end; i += 4) {
+                    __m128 euclid = absolute(_mm_add_ps(_mm_add_ps(_mm_mul_ps(a, _mm_loadu_ps(px + i)), _mm_mul_ps(b, _mm_loadu_ps(py + i))),
+                                                        _mm_add_ps(_mm_mul_ps(c, _mm_loadu_ps(pz + i)), d)));
+                    __m128 cosine = absolute(_mm_add_ps(_mm_add_ps(_mm_mul_ps(a, _mm_loadu_ps(qx + i)), _mm_mul_ps(b, _mm_loadu_ps(qy + i))),
+                                                        _mm_mul_ps(c, _mm_loadu_ps(qz + i))));
+                    __m128 angle = acosPositive(_mm_min_ps(cosine, one));
+                    __m128 w = _mm_loadu_ps(pw + i);
+                    __m128 dist = _mm_add_ps(_mm_mul_ps(w, angle), _mm_mul_ps(_mm_sub_ps(one, w), euclid));
+                    count += __builtin_popcount(_mm_movemask_ps(_mm_cmple_ps(absolute(dist), thr)));
+                }
+#endif
+                for (; i < end; ++i) {
+                    const float euclid = std::abs(m[0] * px[i] + m[1] * py[i] + m[2] * pz[i] + m[3]);
+                    const float angle = acosPositive(std::min(1.0f, std::abs(m[0] * qx[i] + m[1] * qy[i] + m[2] * qz[i])));
+                    count += std::abs(pw[i] * angle + (1.0f - pw[i]) * euclid) <= t;
+                }
+                return count;
+            }
+            case pcl::SACMODEL_CYLINDER: {
+                const float *qx = nx_.data(), *qy = ny_.data(), *qz = nz_.data();
+                const float w = static_cast<float>(normal_distance_weight_);
+#if defined(__SSE2__)
+                const __m128 ox = _mm_set1_ps(m[0]), oy = _mm_set1_ps(m[1]), oz = _mm_set1_ps(m[2]);
+                const __m128 ax = _mm_set1_ps(m[3]), ay = _mm_set1_ps(m[4]), az = _mm_set1_ps(m[5]);
+                const __m128 radius = _mm_set1_ps(m[6]), thr = _mm_set1_ps(t), one = _mm_set1_ps(1.0f);
+                const __m128 wv = _mm_set1_ps(w), wv1 = _mm_set1_ps(1.0f - w);
+                for (; i + 4 <= end; i += 4) {
+                    __m128 vx = _mm_sub_ps(_mm_loadu_ps(px + i), ox), vy = _mm_sub_ps(_mm_loadu_ps(py + i), oy),
+                            vz = _mm_sub_ps(_mm_loadu_ps(pz + i), oz);
+                    __m128 along = _mm_add_ps(_mm_add_ps(_mm_mul_ps(vx, ax), _mm_mul_ps(vy, ay)), _mm_mul_ps(vz, az));
+                    __m128 ux = _mm_sub_ps(vx, _mm_mul_ps(along, ax)), uy = _mm_sub_ps(vy, _mm_mul_ps(along, ay)),
+                            uz = _mm_sub_ps(vz, _mm_mul_ps(along, az));
+                    __m128 axis_distance = _mm_sqrt_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(ux, ux), _mm_mul_ps(uy, uy)),
+                                                                  _mm_mul_ps(uz, uz)));
+                    __m128 euclid = absolute(_mm_sub_ps(axis_distance, radius));
+                    __m128 dot = absolute(_mm_add_ps(_mm_add_ps(_mm_mul_ps(ux, _mm_loadu_ps(qx + i)), _mm_mul_ps(uy, _mm_loadu_ps(qy + i))),
+                                                     _mm_mul_ps(uz, _mm_loadu_ps(qz + i))));
+                    //点在轴线上时除法得到 NaN，min 取第二个操作数，再由掩码置 0，与标量分支一致
+                    __m128 cosine = _mm_and_ps(_mm_cmpgt_ps(axis_distance, _mm_setzero_ps()),
+                                               _mm_min_ps(_mm_div_ps(dot, axis_distance), one));
+                    __m128 dist = _mm_add_ps(_mm_mul_ps(wv, acosPositive(cosine)), _mm_mul_ps(wv1, euclid));
+                    count += __builtin_popcount(_mm_movemask_ps(_mm_cmple_ps(absolute(dist), thr)));
+                }
+#endif
+                for (; i < end; ++i) {
+                    //点到轴线的垂直向量
+                    const float vx = px[i] - m[0], vy = py[i] - m[1], vz = pz[i] - m[2];
+                    const float along = vx * m[3] + vy * m[4] + vz * m[5];
+                    const float ux = vx - along * m[3], uy = vy - along * m[4], uz = vz - along * m[5];
+                    const float axis_distance = std::sqrt(ux * ux + uy * uy + uz * uz);
+                    const float euclid = std::abs(axis_distance - m[6]);
+                    const float cosine = axis_distance > 0.0f
+                                         ? std::min(1.0f, std::abs(ux * qx[i] + uy * qy[i] + uz * qz[i]) / axis_distance)
+                                         : 0.0f;
+                    count += std::abs(w * acosPositive(cosine) + (1.0f - w) * euclid) <= t;
+                }
+                return count;
+            }
+            default:
+                return 0;
+        }
+    }
+
+    /**
+     * SPRT 的判决阈值 A：A = t_M·C/m_S + 1 + ln(A) 的不动点，
+     * C = (1-δ)ln((1-δ)/(1-ε)) + δ·ln(δ/ε)，t_M 取 200 个点的计算量，每次采样得到 m_S = 1 个模型
+     */
+    static double
+    sprtThreshold(double epsilon, double delta) {
+        const double c = (1.0 - delta) * std::log((1.0 - delta) / (1.0 - epsilon)) + delta * std::log(delta / epsilon);
+        const double a0 = 200.0 * c + 1.0;
+        double a = a0;
+        for (int i = 0; i < 10; ++i)
+            a = a0 + std::log(a);
+        return a;
+    }
+
+    /**
+     * 给一批假设计数。关闭提前淘汰时全部点都计数；否则以当前最优内点比例为 ε、被淘汰假设的平均一致比例为 δ 做 SPRT。
+     * 还没有模型时先在前 kBlockSize 个点上给整批计数，把前缀得分最高的假设完整计数后作为参照(preemptive)。
+     *   第一阶段每个线程负责若干个假设，在前 kBlockSize 个点上每 kSprtStep 个点判断一次；
+     *   第二阶段对幸存者按 kSprtRound 个点一轮做分块并行计数，每轮后再判断。
+     * alive[h] 为 0 表示该假设已被淘汰，counts[h] 只是它被淘汰前的计数。
+     */
+    void
+    scoreBatch(const std::vector<Eigen::VectorXf> &batch, int best_count, std::vector<int> &counts,
+               std::vector<char> &alive, std::vector<int> &checked) {
+        const int n = static_cast<int>(x_.size()), nr_hypotheses = static_cast<int>(batch.size());
+        alive.assign(nr_hypotheses, 1);
+        const int prefix = std::min(n, kBlockSize);
+        checked.assign(nr_hypotheses, 0);
+        int reference = best_count, seeded = -1;
+        if (early_rejection_ && best_count == 0) {
+            countWithinDistance(batch, 0, prefix, counts);
+            seeded = static_cast<int>(std::max_element(counts.begin(), counts.end()) - counts.begin());
+            std::vector<int> rest;
+            countWithinDistance(std::vector<Eigen::VectorXf>(1, batch[seeded]), prefix, n, rest);
+            counts[seeded] += rest[0];
+            reference = counts[seeded];
+            std::fill(checked.begin(), checked.end(), prefix);
+            checked[seeded] = n;
+        }
+        const double epsilon = static_cast<double>(reference) / n;
+        if (!early_rejection_ || reference == 0 || sprt_delta_ >= epsilon) {
+            sprt_a_ = std::numeric_limits<double>::infinity();
+            std::vector<Eigen::VectorXf> models;
+            std::vector<int> remaining;
+            for (int h = 0; h < nr_hypotheses; ++h)
+                if (h != seeded)
+                    models.push_back(batch[h]);
+            countWithinDistance(models, seeded >= 0 ? prefix : 0, n, remaining);
+            if (seeded < 0)
+                counts.assign(nr_hypotheses, 0);
+            for (int h = 0, j = 0; h < nr_hypotheses; ++h)
+                if (h != seeded)
+                    counts[h] += remaining[j++];
+            checked.assign(nr_hypotheses, n);
+            evaluated_points_ += static_cast<long long>(n) * nr_hypotheses;
+            return;
+        }
+        sprt_a_ = sprtThreshold(epsilon, sprt_delta_);
+        const double log_a = std::log(sprt_a_);
+        const double log_consistent = std::log(sprt_delta_ / epsilon);
+        const double log_inconsistent = std::log((1.0 - sprt_delta_) / (1.0 - epsilon));
+        //似然比超过 A，或剩余的点全部是内点也不能超过参照时淘汰(编号在参照之前的假设打平时仍应保留)
+        auto rejected = [&](int h, int count, int checked) {
+            return log_consistent * count + log_inconsistent * (checked - count) > log_a ||
+                   count + (n - checked) < reference + (h > seeded ? 1 : 0);
+        };
+
+        if (seeded < 0)
+            counts.assign(nr_hypotheses, 0);
+        parallelFor(0, nr_hypotheses, [&](int h) {
+            if (h == seeded)
+                return;
+            if (seeded >= 0) {
+                alive[h] = !rejected(h, counts[h], prefix);
+                return;
+            }
+            int count = 0, i = 0;
+            while (i < prefix) {
+                const int end = std::min(prefix, i + kSprtStep);
+                count += countBlock(batch[h], i, end);
+                i = end;
+                if (rejected(h, count, i)) {
+                    alive[h] = 0;
+                    break;
+                }
+            }
+            counts[h] = count;
+            checked[h] = i;
+        }, nr_threads_);
+
+        std::vector<int> active;
+        for (int h = 0; h < nr_hypotheses; ++h)
+            if (alive[h] && h != seeded)
+                active.push_back(h);
+        std::vector<Eigen::VectorXf> models;
+        std::vector<int> round_counts;
+        for (int begin = prefix; begin < n && !active.empty(); begin += kSprtRound) {
+            const int end = std::min(n, begin + kSprtRound);
+            models.clear();
+            for (int h: active)
+                models.push_back(batch[h]);
+            countWithinDistance(models, begin, end, round_counts);
+            std::vector<int> still_active;
+            for (std::size_t j = 0; j < active.size(); ++j) {
+                const int h = active[j];
+                counts[h] += round_counts[j];
+                checked[h] = end;
+                if (end < n && rejected(h, counts[h], end))
+                    alive[h] = 0;
+                else
+                    still_active.push_back(h);
+            }
+            active.swap(still_active);
+        }
+
+        //用本批被淘汰假设的一致比例更新 δ
+        for (int h = 0; h < nr_hypotheses; ++h) {
+            evaluated_points_ += checked[h];
+            if (!alive[h]) {
+                rejected_consistent_ += counts[h];
+                rejected_evaluated_ += checked[h];
+            }
+        }
+        if (rejected_evaluated_ > 0)
+            sprt_delta_ = std::max(1e-4, static_cast<double>(rejected_consistent_) / static_cast<double>(rejected_evaluated_));
+    }
+
+    //按点分块：每个线程处理一段连续的块，块内依次给整批假设计数，最后按线程求和
+    void
+    countWithinDistance(const std::vector<Eigen::VectorXf> &batch, int first, int last, std::vector<int> &counts) const {
+        const int nr_hypotheses = static_cast<int>(batch.size());
+        const int nr_blocks = (last - first + kBlockSize - 1) / kBlockSize;
+        const int nr_threads = static_cast<int>(std::min<unsigned int>(getNumberOfThreads(nr_threads_),
+                                                                       static_cast<unsigned int>(nr_blocks)));
+        std::vector<std::vector<int> > partial(nr_threads, std::vector<int>(nr_hypotheses, 0));
+        parallelForChunks(0, nr_blocks, [&](int thread_id, int block_begin, int block_end) {
+            std::vector<int> &local = partial[thread_id];
+            for (int block = block_begin; block < block_end; ++block) {
+                const int begin = first + block * kBlockSize, end = std::min(last, begin + kBlockSize);
+                for (int h = 0; h < nr_hypotheses; ++h)
+                    local[h] += countBlock(batch[h], begin, end);
+            }
+        }, nr_threads);
+        counts.assign(nr_hypotheses, 0);
+        for (const std::vector<int> &local: partial)
+            for (int h = 0; h < nr_hypotheses; ++h)
+                counts[h] += local[h];
+    }
+
+    //精确的点到模型距离（与 PCL getDistancesToModel 相同）
+    float
+    distanceToModel(const Eigen::VectorXf &m, int i) const {
+        const Eigen::Vector3f p(x_[i], y_[i], z_[i]);
+        switch (model_type_) {
+            case pcl::SACMODEL_PLANE:
+                return std::abs(m.head<3>().dot(p) + m[3]);
+            case pcl::SACMODEL_SPHERE:
+                return std::abs((p - m.head<3>()).norm() - m[3]);
+            case pcl::SACMODEL_NORMAL_PLANE: {
+                const Eigen::Vector3f normal(nx_[i], ny_[i], nz_[i]);
+                const float euclid = std::abs(m.head<3>().dot(p) + m[3]);
+                float angle = std::acos(std::max(-1.0f, std::min(1.0f, normal.dot(m.head<3>()))));
+                angle = std::min(angle, static_cast<float>(M_PI) - angle);
+                return std::abs(weight_[i] * angle + (1.0f - weight_[i]) * euclid);
+            }
+            case pcl::SACMODEL_CYLINDER: {
+                const Eigen::Vector3f line_pt = m.head<3>(), line_dir = m.segment<3>(3);
+                const Eigen::Vector3f v = p - line_pt, u = v - v.dot(line_dir) * line_dir;
+                const float euclid = std::abs(u.norm() - m[6]);
+                const Eigen::Vector3f normal(nx_[i], ny_[i], nz_[i]);
+                float angle = 0.0f;
+                if (u.norm() > 0.0f) {
+                    angle = std::acos(std::max(-1.0f, std::min(1.0f, normal.dot(u) / u.norm())));
+                    angle = std::min(angle, static_cast<float>(M_PI) - angle);
+                }
+                const float w = static_cast<float>(normal_distance_weight_);
+                return std::abs(w * angle + (1.0f - w) * euclid);
+            }
+            default:
+                return std::numeric_limits<float>::max();
+        }
+    }
+
+    //按 SoA 下标返回内点，按线程分段后顺序拼接，保持升序
+    void
+    selectWithinDistance(const Eigen::VectorXf &model, std::vector<int> &selection) const {
+        const int n = static_cast<int>(x_.size());
+        const int nr_threads = static_cast<int>(getNumberOfThreads(nr_threads_));
+        const float t = static_cast<float>(threshold_);
+        std::vector<std::vector<int> > partial(nr_threads);
+        parallelForChunks(0, n, [&](int thread_id, int begin, int end) {
+            for (int i = begin; i < end; ++i)
+                if (distanceToModel(model, i) <= t)
+                    partial[thread_id].push_back(i);
+        }, nr_threads);
+        selection.clear();
+        for (const std::vector<int> &local: partial)
+            selection.insert(selection.end(), local.begin(), local.end());
+    }
+
+    /**
+     * 用内点重新拟合：平面取协方差最小特征值方向(与 SampleConsensusModelPlane::optimizeModelCoefficients 相同)，
+     * 球用代数最小二乘 x^2+y^2+z^2 + Dx + Ey + Fz + G = 0。
+     * 圆柱直接调用 SampleConsensusModelCylinder::optimizeModelCoefficients(LM 最小化到轴线距离平方与 r^2 之差)，与 PCL 结果相同。
+     */
+    bool
+    refitModel(const std::vector<int> &selection, Eigen::VectorXf &model) const {
+        if (model_type_ == pcl::SACMODEL_PLANE || model_type_ == pcl::SACMODEL_NORMAL_PLANE) {
+            if (selection.size() < 3)
+                return false;
+            Eigen::Vector3d mean(Eigen::Vector3d::Zero());
+            Eigen::Matrix3d second_moment(Eigen::Matrix3d::Zero());
+            for (int i: selection) {
+                const Eigen::Vector3d p(x_[i], y_[i], z_[i]);
+                mean += p;
+                second_moment += p * p.transpose();
+            }
+            mean /= static_cast<double>(selection.size());
+            const Eigen::Matrix3d covariance = second_moment / static_cast<double>(selection.size()) - mean * mean.transpose();
+            Eigen::SelfAdjointEigenSolver<Eigen::Matrix3d> solver(covariance);
+            Eigen::Vector3d normal = solver.eigenvectors().col(0);
+            //保持与原模型相同的朝向
+            if (normal.dot(model.head<3>().cast<double>()) < 0.0)
+                normal = -normal;
+            model << normal.cast<float>(), static_cast<float>(-normal.dot(mean));
+            return true;
+        }
+        if (model_type_ == pcl::SACMODEL_SPHERE) {
+            if (selection.size() < 4)
+                return false;
+            Eigen::Matrix4d ata(Eigen::Matrix4d::Zero());
+            Eigen::Vector4d atb(Eigen::Vector4d::Zero());
+            for (int i: selection) {
+                const Eigen::Vector4d row(x_[i], y_[i], z_[i], 1.0);
+                const double rhs = -(static_cast<double>(x_[i]) * x_[i] + static_cast<double>(y_[i]) * y_[i] +
+                                     static_cast<double>(z_[i]) * z_[i]);
+                ata += row * row.transpose();
+                atb += row * rhs;
+            }
+            const Eigen::Vector4d solution = ata.ldlt().solve(atb);
+            const Eigen::Vector3d center = -0.5 * solution.head<3>();
+            const double radius_squared = center.squaredNorm() - solution[3];
+            if (!solution.allFinite() || !(radius_squared > 0.0) || !radiusValid(static_cast<float>(std::sqrt(radius_squared))))
+                return false;
+            model << center.cast<float>(), static_cast<float>(std::sqrt(radius_squared));
+            return true;
+        }
+        if (model_type_ == pcl::SACMODEL_CYLINDER) {
+            if (selection.size() <= 2)
+                return false;
+            std::vector<int> inliers;
+            inliers.reserve(selection.size());
+            for (int i: selection)
+                inliers.push_back(cloud_index_[i]);
+            pcl::SampleConsensusModelCylinder<PointT, PointNT> cylinder(input_);
+            cylinder.setInputNormals(normals_);
+            Eigen::VectorXf optimized;
+            cylinder.optimizeModelCoefficients(inliers, model, optimized);
+            if (optimized.size() != 7 || !optimized.allFinite() || !radiusValid(optimized[6]))
+                return false;
+            model = optimized;
+            return true;
+        }
+        return false;
+    }
+
+    PointCloudConstPtr input_;
+    PointCloudNConstPtr normals_;
+    pcl::IndicesConstPtr indices_;
+    int model_type_;
+    double threshold_;
+    int max_iterations_;
+    double probability_;
+    bool optimize_coefficients_;
+    double normal_distance_weight_;
+    double radius_min_, radius_max_;
+    int nr_threads_, batch_size_;
+    unsigned int seed_;
+    bool early_rejection_, trace_enabled_;
+    int iterations_;
+    long long evaluated_points_, scored_points_;
+    std::vector<TraceEntry> trace_;
+    AnytimeBudget budget_;
+    AnytimeStatus status_;
+    double confidence_;
+
+    //先验模型与扰动设置
+    Eigen::VectorXf prior_;
+    bool has_prior_;
+    double prior_min_ratio_;
+    bool warm_start_;
+    double warm_start_ratio_drop_;
+    int prior_perturbations_;
+    double prior_translation_, prior_angle_;
+    bool warm_started_;
+
+    //SPRT 状态：δ 为坏模型上一个点一致的概率，A 为判决阈值
+    double sprt_delta_, sprt_a_;
+    long long rejected_consistent_, rejected_evaluated_;
+
+    //SoA 数据，cloud_index_ 为对应的输入点下标
+    std::vector<float> x_, y_, z_, nx_, ny_, nz_, weight_;
+    std::vector<int> cloud_index_;
+    int shuffled_;    //前 shuffled_ 个位置已经打乱
+};
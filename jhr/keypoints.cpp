@@ -6,11 +6,12 @@
 #include <pcl/io/pcd_io.h>
 #include <pcl/visualization/range_image_visualizer.h>
 #include <pcl/visualization/pcl_visualizer.h>
-#include <pcl/features/range_image_border_extractor.h>
-#include <pcl/keypoints/narf_keypoint.h>
 #include <pcl/console/parse.h>
 #include <pcl/common/file_io.h> // for getFilenameWithoutExtension
 
+#include "../common/range_image_parallel.h"
+#include "../common/narf_keypoint_parallel.h"
+
 typedef pcl::PointXYZ PointType;
 
 // --------------------
@@ -18,6 +19,7 @@ typedef pcl::PointXYZ PointType;
 // --------------------
 float angular_resolution = 0.5f;
 float support_size = 0.2f;
+std::vector<float> support_sizes;
 pcl::RangeImage::CoordinateFrame coordinate_frame = pcl::RangeImage::CAMERA_FRAME;
 bool setUnseenToMaxRange = false;
 
@@ -34,6 +36,7 @@ printUsage(const char *progName) {
               << "-m           Treat all unseen points as maximum range readings\n"
               << "-s <float>   support size for the interest points (diameter of the used sphere - "
               << "default " << support_size << ")\n"
+              << "-S <float,float,...> detect keypoints at several support sizes in one pass\n"
               << "-h           this help\n"
               << "\n\n";
 }
@@ -72,6 +75,8 @@ main(int argc, char **argv) {
     }
     if (pcl::console::parse(argc, argv, "-s", support_size) >= 0)
         std::cout << "Setting support size to " << support_size << ".\n";
+    if (pcl::console::parse_x_arguments(argc, argv, "-S", support_sizes) >= 0)
+        std::cout << "Using " << support_sizes.size() << " support sizes.\n";
     if (pcl::console::parse(argc, argv, "-r", angular_resolution) >= 0)
         std::cout << "Setting angular resolution to " << angular_resolution << "deg.\n";
     angular_resolution = pcl::deg2rad(angular_resolution);
@@ -120,10 +125,11 @@ main(int argc, char **argv) {
     float noise_level = 0.0;
     float min_range = 0.0f;
     int border_size = 1;
-    pcl::RangeImage::Ptr range_image_ptr(new pcl::RangeImage);
+    RangeImageParallel::Ptr range_image_ptr(new RangeImageParallel);
     pcl::RangeImage &range_image = *range_image_ptr;
-    range_image.createFromPointCloud(point_cloud, angular_resolution, pcl::deg2rad(360.0f), pcl::deg2rad(180.0f),
-                                     scene_sensor_pose, coordinate_frame, noise_level, min_range, border_size);
+    range_image_ptr->createFromPointCloudParallel(point_cloud, angular_resolution, pcl::deg2rad(360.0f),
+                                                  pcl::deg2rad(180.0f), scene_sensor_pose, coordinate_frame,
+                                                  noise_level, min_range, border_size);
     range_image.integrateFarRanges(far_ranges);
     if (setUnseenToMaxRange)
         range_image.setUnseenToMaxRange();
@@ -152,15 +158,34 @@ main(int argc, char **argv) {
     // --------------------------------
     // -----Extract NARF keypoints-----
     // --------------------------------
-    pcl::RangeImageBorderExtractor range_image_border_extractor;
-    pcl::NarfKeypoint narf_keypoint_detector(&range_image_border_extractor);
+    //边界与表面变化只算一次，同时用于深度图上的边界显示和 NARF 关键点
+    RangeImageBorderExtractorParallel border_extractor(&range_image);
+    RangeImageBorders borders;
+    RangeImageSurfaceChanges surface_changes;
+    border_extractor.compute(borders, surface_changes);
+    std::vector<int> border_indices = borders.obstacle.toIndices();
+    for (int index: border_indices)
+        range_image_widget.markPoint(index % range_image.width, index / range_image.width,
+                                     pcl::visualization::Vector3ub(0, 255, 0));
+
+    NarfKeypointParallel narf_keypoint_detector;
     narf_keypoint_detector.setRangeImage(&range_image);
+    narf_keypoint_detector.setBorders(&borders, &surface_changes);
     narf_keypoint_detector.getParameters().support_size = support_size;
-    //narf_keypoint_detector.getParameters ().add_points_on_straight_edges = true;
-    //narf_keypoint_detector.getParameters ().distance_for_additional_points = 0.5;
 
     pcl::PointCloud<int> keypoint_indices;
-    narf_keypoint_detector.compute(keypoint_indices);
+    if (support_sizes.empty()) {
+        narf_keypoint_detector.compute(keypoint_indices);
+    } else {
+        //所有尺度共用一次邻域遍历，每个关键点带有检测到它的尺度
+        std::vector<NarfKeypointParallel::ScaledKeypoint> scaled_keypoints;
+        narf_keypoint_detector.computeMultiScale(support_sizes, scaled_keypoints);
+        for (const NarfKeypointParallel::ScaledKeypoint &keypoint: scaled_keypoints) {
+            keypoint_indices.push_back(keypoint.index);
+            std::cout << "  support size " << keypoint.support_size << ": point " << keypoint.index
+                      << ", interest " << keypoint.interest << "\n";
+        }
+    }
     std::cout << "Found " << keypoint_indices.size() << " key points.\n";
 
     // ----------------------------------------------
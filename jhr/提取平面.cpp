@@ -6,15 +6,14 @@
 #include <pcl/sample_consensus/model_types.h>
 #include <pcl/segmentation/sac_segmentation.h>
 #include <pcl/filters/voxel_grid.h>
-#include <pcl/filters/extract_indices.h>
+
+#include "../common/sac_parallel.h"
 
 int
 main (int argc, char** argv)
 {
     pcl::PCLPointCloud2::Ptr cloud_blob (new pcl::PCLPointCloud2), cloud_filtered_blob (new pcl::PCLPointCloud2);
-    pcl::PointCloud<pcl::PointXYZ>::Ptr cloud_filtered (new pcl::PointCloud<pcl::PointXYZ>),
-            cloud_p (new pcl::PointCloud<pcl::PointXYZ>),
-            cloud_f (new pcl::PointCloud<pcl::PointXYZ>);
+    pcl::PointCloud<pcl::PointXYZ>::Ptr cloud_filtered (new pcl::PointCloud<pcl::PointXYZ>);
 
     // Fill in the cloud data
     pcl::PCDReader reader;
@@ -39,8 +38,8 @@ main (int argc, char** argv)
 
     pcl::ModelCoefficients::Ptr coefficients (new pcl::ModelCoefficients ());
     pcl::PointIndices::Ptr inliers (new pcl::PointIndices ());//点云索引
-    // Create the segmentation object 创建分割器对象
-    pcl::SACSegmentation<pcl::PointXYZ> seg;
+    // Create the segmentation object 创建分割器对象（批量假设，多线程计数）
+    SACSegmentationParallel<pcl::PointXYZ> seg;
     // Optional
     seg.setOptimizeCoefficients (true);
     // Mandatory
@@ -49,17 +48,20 @@ main (int argc, char** argv)
     seg.setMaxIterations (1000);
     seg.setDistanceThreshold (0.002);
 
-    // Create the filtering object
-    //通过ExtractIndices滤波器提取点云中的子集
-    pcl::ExtractIndices<pcl::PointXYZ> extract;
+    // 当前参与分割的点的索引，每轮缩小为上一轮的平面内点；不再用 ExtractIndices 复制点云
+    pcl::IndicesPtr active(new std::vector<int>(cloud_filtered->points.size()));
+    for (std::size_t k = 0; k < active->size(); ++k)
+        (*active)[k] = static_cast<int>(k);
+    std::vector<char> is_inlier(cloud_filtered->points.size(), 0);
+    seg.setInputCloud (cloud_filtered);
 
     int i = 0, nr_points = (int) cloud_filtered->points.size ();
     // While 30% of the original cloud is still there
-    while (cloud_filtered->points.size () > 0.8 * nr_points)
+    while (active->size () > 0.8 * nr_points)
     {
         // Segment the largest planar component from the remaining cloud
         //从剩余的云中分割出最大的平面组件
-        seg.setInputCloud (cloud_filtered);
+        seg.setIndices (pcl::IndicesConstPtr (active));
         seg.segment (*inliers, *coefficients);
         if (inliers->indices.size () == 0)
         {
@@ -68,21 +70,24 @@ main (int argc, char** argv)
         }
 
         // Extract the inliers
-        extract.setInputCloud (cloud_filtered);
-        extract.setIndices (inliers);
-        extract.setNegative (true);
-        extract.filter (*cloud_p);
-        std::cerr << "PointCloud representing the planar component: " << cloud_p->width * cloud_p->height << " data points." << std::endl;
+        // 平面以外的点，按索引直接写出
+        std::vector<int> outliers;
+        for (int index : inliers->indices)
+            is_inlier[index] = 1;
+        for (int index : *active)
+            if (!is_inlier[index])
+                outliers.push_back (index);
+        for (int index : inliers->indices)
+            is_inlier[index] = 0;
+        std::cerr << "PointCloud representing the planar component: " << outliers.size () << " data points." << std::endl;
 
         std::stringstream ss;//字符串与整形转换
         ss << "../plate_temp_" << i << ".pcd";
-        writer.write<pcl::PointXYZ> (ss.str (), *cloud_p, false);
+        writer.write<pcl::PointXYZ> (ss.str (), *cloud_filtered, outliers, false);
 
-        // Create the filtering object
-        extract.setNegative (false);
-        extract.filter (*cloud_f);
-        writer.write<pcl::PointXYZ>("../plate_temp_p.pcd",*cloud_f,false);
-        cloud_filtered.swap (cloud_f);
+        // 平面内点
+        writer.write<pcl::PointXYZ>("../plate_temp_p.pcd", *cloud_filtered, inliers->indices, false);
+        active.reset (new std::vector<int> (inliers->indices));
 
         i++;
     }